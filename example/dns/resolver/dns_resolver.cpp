@@ -0,0 +1,215 @@
+#include <asio3/core/fmt.hpp>
+#include <asio3/tcp/accept.hpp>
+#include <asio3/tcp/read.hpp>
+#include <asio3/tcp/write.hpp>
+#include <asio3/dns/resolver.hpp>
+
+namespace net = ::asio;
+
+// a stand-in name server on the loopback, it exercises the paths of the resolver which a real
+// name server rarely takes:
+// 1. each udp query is answered by a spoofed response first, it has the right id but the
+//    question of another name, the resolver must ignore it and keep waiting.
+// 2. then by a truncated response, the resolver must retry the query with tcp.
+// 3. the tcp query is answered by the address of the name.
+
+// the answer of the A query.
+const net::ip::address_v4 answer_address = net::ip::make_address_v4("10.0.0.1");
+
+void put16(std::string& msg, std::uint16_t v)
+{
+	msg += char(v >> 8);
+	msg += char(v & 0xFF);
+}
+
+void put32(std::string& msg, std::uint32_t v)
+{
+	put16(msg, std::uint16_t(v >> 16));
+	put16(msg, std::uint16_t(v & 0xFFFF));
+}
+
+// the question section of the query, the name is not compressed.
+std::string_view question_of(std::string_view query)
+{
+	std::size_t end = 12;
+	while (end < query.size() && query[end] != 0)
+		end += 1 + std::uint8_t(query[end]);
+	end += 1 + 4;
+
+	if (end > query.size())
+		return {};
+
+	return query.substr(12, end - 12);
+}
+
+std::string make_response(std::string_view query, std::string_view question, std::uint16_t flags, bool with_answer)
+{
+	std::uint16_t qtype = std::uint16_t(std::uint8_t(question[question.size() - 4]) << 8 |
+		std::uint8_t(question[question.size() - 3]));
+
+	bool answered = with_answer && qtype == std::uint16_t(net::dns::record_type::a);
+
+	std::string msg;
+
+	msg += query.substr(0, 2); // id
+	put16(msg, flags);
+	put16(msg, 1); // QDCOUNT
+	put16(msg, answered ? 1 : 0); // ANCOUNT
+	put16(msg, 0); // NSCOUNT
+	put16(msg, 0); // ARCOUNT
+
+	msg += question;
+
+	if (answered)
+	{
+		put16(msg, 0xC00C); // the name is a pointer to the question
+		put16(msg, std::uint16_t(net::dns::record_type::a));
+		put16(msg, 1); // IN
+		put32(msg, 300); // TTL
+		put16(msg, 4);
+		for (unsigned char byte : answer_address.to_bytes())
+			msg += char(byte);
+	}
+
+	return msg;
+}
+
+net::awaitable<void> udp_responder(net::udp_socket& sock)
+{
+	std::array<char, 512> buf;
+
+	for (;;)
+	{
+		net::ip::udp::endpoint sender;
+
+		auto [e1, n1] = co_await sock.async_receive_from(net::buffer(buf), sender);
+		if (e1)
+			co_return;
+
+		std::string_view query(buf.data(), n1);
+		std::string_view question = question_of(query);
+		if (question.empty())
+			continue;
+
+		// the question of another name, with the id of the query.
+		std::string spoofed_question;
+		spoofed_question += "\x04" "evil" "\x04" "test";
+		spoofed_question += '\0';
+		spoofed_question += question.substr(question.size() - 4);
+
+		std::string spoofed = make_response(query, spoofed_question, 0x8180, true);
+
+		co_await sock.async_send_to(net::buffer(spoofed), sender);
+
+		// QR, RD, RA and TC.
+		std::string truncated = make_response(query, question, 0x8380, false);
+
+		co_await sock.async_send_to(net::buffer(truncated), sender);
+	}
+}
+
+net::awaitable<void> tcp_responder(net::tcp_socket sock)
+{
+	for (;;)
+	{
+		std::array<char, 2> head;
+
+		auto [e1, n1] = co_await net::async_read(sock, net::buffer(head));
+		if (e1)
+			co_return;
+
+		std::string query;
+		query.resize(std::size_t(std::uint8_t(head[0]) << 8 | std::uint8_t(head[1])));
+
+		auto [e2, n2] = co_await net::async_read(sock, net::buffer(query));
+		if (e2)
+			co_return;
+
+		std::string_view question = question_of(query);
+		if (question.empty())
+			co_return;
+
+		fmt::print("tcp query received, the udp response was truncated\n");
+
+		std::string response = make_response(query, question, 0x8180, true);
+
+		head[0] = char(response.size() >> 8);
+		head[1] = char(response.size() & 0xFF);
+
+		std::array<net::const_buffer, 2> buffers{ net::buffer(head), net::buffer(response) };
+
+		auto [e3, n3] = co_await net::async_write(sock, buffers);
+		if (e3)
+			co_return;
+	}
+}
+
+net::awaitable<void> tcp_accept(net::tcp_acceptor& acceptor)
+{
+	for (;;)
+	{
+		auto [e1, sock] = co_await acceptor.async_accept();
+		if (e1)
+			co_return;
+
+		net::co_spawn(acceptor.get_executor(), tcp_responder(std::move(sock)), net::detached);
+	}
+}
+
+net::awaitable<void> resolve(net::dns::resolver& resolver, int& result)
+{
+	auto [e1, results, ttl] = co_await resolver.async_resolve("www.example.test", "80", net::use_nothrow_awaitable);
+	if (e1)
+	{
+		fmt::print("resolve failure: {}\n", e1.message());
+		co_return;
+	}
+
+	bool found = false;
+
+	for (auto& r : results)
+	{
+		fmt::print("resolved: {} ttl: {}\n", r.endpoint().address().to_string(), ttl);
+
+		found |= (r.endpoint().address() == answer_address);
+	}
+
+	result = found ? 0 : 1;
+}
+
+int main()
+{
+	net::io_context ctx(1);
+
+	net::udp_socket udp_sock(ctx, net::ip::udp::endpoint(net::ip::address_v4::loopback(), 0));
+
+	std::uint16_t port = udp_sock.local_endpoint().port();
+
+	net::tcp_acceptor acceptor(ctx, net::ip::tcp::endpoint(net::ip::address_v4::loopback(), port));
+
+	net::dns::option opt{};
+	opt.nameservers = { net::ip::udp::endpoint(net::ip::address_v4::loopback(), port) };
+	opt.timeout = std::chrono::seconds(2);
+	opt.attempts = 1;
+	opt.hosts_file.clear();
+
+	net::dns::resolver resolver(ctx.get_executor(), std::move(opt));
+
+	int result = 1;
+
+	net::co_spawn(ctx, udp_responder(udp_sock), net::detached);
+	net::co_spawn(ctx, tcp_accept(acceptor), net::detached);
+	net::co_spawn(ctx, resolve(resolver, result), [&](std::exception_ptr)
+	{
+		net::error_code ec{};
+		udp_sock.close(ec);
+		acceptor.close(ec);
+		resolver.close();
+	});
+
+	ctx.run();
+
+	fmt::print("{}\n", result == 0 ? "ok" : "failed");
+
+	return result;
+}
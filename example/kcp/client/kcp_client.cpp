@@ -0,0 +1,48 @@
+#include <asio3/core/fmt.hpp>
+#include <asio3/kcp/stream.hpp>
+
+namespace net = ::asio;
+
+net::awaitable<void> do_connect(net::kcp_stream& stream)
+{
+	auto [e1, ep] = co_await stream.async_connect("127.0.0.1", 20803);
+	if (e1)
+	{
+		fmt::print("connect failure: {}\n", e1.message());
+		co_return;
+	}
+
+	std::array<char, 1024> buf;
+
+	std::string msg = "<0123456789>";
+
+	for (;;)
+	{
+		auto [e2, n2] = co_await net::async_write(stream, net::buffer(msg));
+		if (e2)
+			break;
+
+		auto [e3, n3] = co_await stream.async_read_some(net::buffer(buf));
+		if (e3)
+			break;
+
+		fmt::print("{}\n", std::string_view(buf.data(), n3));
+	}
+}
+
+int main()
+{
+	net::io_context ctx(1);
+
+	net::kcp_stream stream(ctx);
+
+	net::signal_set signals(ctx, SIGINT, SIGTERM);
+	signals.async_wait([&](auto, auto)
+	{
+		stream.close();
+	});
+
+	net::co_spawn(ctx, do_connect(stream), net::detached);
+
+	ctx.run();
+}
@@ -0,0 +1,55 @@
+#include <asio3/core/fmt.hpp>
+#include <asio3/kcp/acceptor.hpp>
+
+namespace net = ::asio;
+
+net::awaitable<void> echo(net::kcp_stream stream)
+{
+	std::array<char, 1024> buf;
+
+	for (;;)
+	{
+		auto [e1, n1] = co_await stream.async_read_some(net::buffer(buf));
+		if (e1)
+			break;
+
+		auto [e2, n2] = co_await net::async_write(stream, net::buffer(buf.data(), n1));
+		if (e2)
+			break;
+	}
+
+	stream.close();
+}
+
+net::awaitable<void> do_accept(net::kcp_acceptor& acceptor)
+{
+	for (;;)
+	{
+		auto [e1, stream] = co_await acceptor.async_accept();
+		if (e1)
+			co_return;
+
+		fmt::print("new conversation {}: {}:{}\n", stream.conv(),
+			stream.remote_endpoint().address().to_string(), stream.remote_endpoint().port());
+
+		net::co_spawn(acceptor.get_executor(), echo(std::move(stream)), net::detached);
+	}
+}
+
+int main()
+{
+	net::io_context ctx(1);
+
+	net::kcp_acceptor acceptor(
+		net::udp_socket(ctx, net::ip::udp::endpoint(net::ip::udp::v4(), 20803)));
+
+	net::signal_set signals(ctx, SIGINT, SIGTERM);
+	signals.async_wait([&](auto, auto)
+	{
+		acceptor.close();
+	});
+
+	net::co_spawn(ctx, do_accept(acceptor), net::detached);
+
+	ctx.run();
+}
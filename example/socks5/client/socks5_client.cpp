@@ -1,6 +1,7 @@
 #include <asio3/core/fmt.hpp>
 #include <asio3/socks5/handshake.hpp>
 #include <asio3/core/timer.hpp>
+#include <asio3/core/with_deadline.hpp>
 #include <asio3/tcp/connect.hpp>
 #include <asio3/udp/read.hpp>
 #include <asio3/udp/write.hpp>
@@ -80,14 +81,10 @@ net::awaitable<void> udp_connect(socks5::option sock5_opt)
 			client.local_endpoint().port());
 	}
 
-	auto result2 = co_await(
-		socks5::async_handshake(client, sock5_opt, net::use_nothrow_awaitable) ||
-		net::timeout(std::chrono::seconds(5)));
-	if (result2.index() == 1)
-		co_return; // timed out
-	auto [e2] = std::get<0>(std::move(result2));
+	auto [e2] = co_await socks5::async_handshake(client, sock5_opt,
+		net::with_deadline(net::use_nothrow_awaitable, std::chrono::seconds(5)));
 	if (e2)
-		co_return;
+		co_return; // failed or timed out
 
 	net::ip::udp::endpoint remote_endp{ ep1.address(), sock5_opt.bound_port };
 	net::ip::udp::endpoint sender_endp;
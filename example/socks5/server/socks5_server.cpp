@@ -1,7 +1,11 @@
 #include <asio3/core/fmt.hpp>
 #include <asio3/socks5/accept.hpp>
 #include <asio3/core/timer.hpp>
+#include <asio3/core/with_deadline.hpp>
+#include <asio3/core/io_context_pool.hpp>
 #include <asio3/tcp/accept.hpp>
+#include <asio3/tcp/relay.hpp>
+#include <asio3/core/rate_limit.hpp>
 #include <asio3/udp/read.hpp>
 #include <asio3/udp/write.hpp>
 #include <asio3/socks5/parser.hpp>
@@ -9,32 +13,34 @@
 #include <asio3/socks5/udp_header.hpp>
 
 namespace net = ::asio;
-using time_point = std::chrono::steady_clock::time_point;
 
-net::awaitable<void> tcp_transfer(
-	net::tcp_socket& from, net::tcp_socket& to, socks5::handshake_info& info, time_point& deadline)
+// the bandwidth limit of each direction of all the proxied tcp connections, 0 means unlimited.
+std::shared_ptr<net::token_bucket> global_limit = std::make_shared<net::token_bucket>(0);
+
+net::awaitable<void> tcp_transfer(net::tcp_socket& front_client, net::tcp_socket& back_client)
 {
-	std::array<char, 1024> data;
+	net::relay_option opt{ .idle_timeout = std::chrono::minutes(10) };
 
-	for (;;)
+	// the limited connections are relayed by copying, the others by splice.
+	if (global_limit->rate() != 0)
 	{
-		deadline = std::chrono::steady_clock::now() + std::chrono::minutes(10);
+		net::rate_limited_stream<net::tcp_socket&> front_stream(front_client);
 
-		auto [e1, n1] = co_await net::async_read_some(from, net::buffer(data));
-		if (e1)
-			co_return;
+		front_stream.read_limit().add(global_limit);
+		front_stream.write_limit().add(global_limit);
 
-		auto [e2, n2] = co_await net::async_write(to, net::buffer(data, n1));
-		if (e2)
-			co_return;
+		co_await net::async_relay(front_stream, back_client, opt);
+	}
+	else
+	{
+		co_await net::async_relay(front_client, back_client, opt);
 	}
 }
 
 // recvd data from udp
 net::awaitable<net::error_code> forward_udp_data(
 	net::tcp_socket& from, net::udp_socket& bound, socks5::handshake_info& info,
-	std::vector<std::uint8_t> reply_buffer,
-	const net::ip::udp::endpoint& sender_endpoint, std::string_view data)
+	const net::ip::udp::endpoint& sender_endpoint, net::datagram_buffer& data)
 {
 	net::error_code ec{};
 
@@ -52,7 +58,8 @@ net::awaitable<net::error_code> forward_udp_data(
 	// recvd data from the front client. forward it to the target endpoint.
 	if (is_from_front)
 	{
-		auto [err, ep, domain, real_data] = socks5::parse_udp_packet(data, false);
+		auto [err, ep, domain, real_data] = socks5::parse_udp_packet(
+			std::string_view{ data.data(), data.size() }, false);
 		if (err == 0)
 		{
 			if (domain.empty())
@@ -75,132 +82,133 @@ net::awaitable<net::error_code> forward_udp_data(
 	// recvd data from the back client. forward it to the front client.
 	else
 	{
-		reply_buffer.clear();
-
+		// the header is written into the headroom of the datagram, so the data is not copied,
+		// and it is consumed after the send, so the view of the caller is unchanged.
 		if /**/ (info.last_read_channel == net::protocol::tcp)
 		{
 			auto head = socks5::make_udp_header(sender_endpoint.address(), sender_endpoint.port(), data.size());
 
-			reply_buffer.insert(reply_buffer.cend(), head.begin(), head.end());
-			reply_buffer.insert(reply_buffer.cend(), data.begin(), data.end());
+			std::copy(head.begin(), head.end(), data.prepend(head.size()));
 
-			auto [e1, n1] = co_await net::async_write(from, net::buffer(reply_buffer));
+			auto [e1, n1] = co_await net::async_write(from, net::buffer(data));
+			data.consume(head.size());
 			co_return e1;
 		}
 		else if (info.last_read_channel == net::protocol::udp)
 		{
 			auto head = socks5::make_udp_header(sender_endpoint.address(), sender_endpoint.port(), 0);
 
-			reply_buffer.insert(reply_buffer.cend(), head.begin(), head.end());
-			reply_buffer.insert(reply_buffer.cend(), data.begin(), data.end());
+			std::copy(head.begin(), head.end(), data.prepend(head.size()));
 
 			auto [e1, n1] = co_await net::async_send_to(
-				bound, net::buffer(reply_buffer), net::ip::udp::endpoint(front_addr, info.dest_port));
+				bound, net::buffer(data), net::ip::udp::endpoint(front_addr, info.dest_port));
+			data.consume(head.size());
 			co_return e1;
 		}
 	}
+
+	co_return net::error_code{};
 }
 
 net::awaitable<void> udp_transfer(
-	net::tcp_socket& from, net::udp_socket& bound, socks5::handshake_info& info, time_point& deadline)
+	net::tcp_socket& from, net::udp_socket& bound, socks5::handshake_info& info, net::deadline& deadline)
 {
-	// ############## should has a choice to set the udp recv buffer size.
-	std::string data(1024, '\0');
+	// receive up to this many datagrams per readiness event.
+	constexpr std::size_t batch = 16;
 
-	net::ip::udp::endpoint sender_endpoint{};
+	// the datagrams are received into the pooled mtu sized blocks, a truncated datagram grows
+	// its slot to a jumbo block.
+	std::array<net::datagram_buffer, batch> datas;
 
-	// Define a buffer in advance to reduce memory allocation
-	std::vector<std::uint8_t> reply_buffer;
+	std::array<net::const_buffer, batch> echoes;
+	std::array<net::ip::udp::endpoint, batch> sender_endpoints;
 
 	for (;;)
 	{
-		deadline = std::chrono::steady_clock::now() + std::chrono::minutes(10);
+		deadline.expires_after(std::chrono::minutes(10));
 
-		auto [e1, n1] = co_await net::async_receive_from(bound, net::buffer(data), sender_endpoint);
+		auto [e1, count] = co_await net::async_receive_batch(bound, datas, sender_endpoints);
 		if (e1)
 			co_return;
 
 		info.last_read_channel = net::protocol::udp;
 
-		net::error_code tp = co_await forward_udp_data(
-			from, bound, info, reply_buffer, sender_endpoint, std::string_view{ data.data(), n1 });
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			// the datagram is passed by reference, the bytes are not copied.
+			net::error_code tp = co_await forward_udp_data(
+				from, bound, info, sender_endpoints[i], datas[i]);
+
+			echoes[i] = net::buffer(std::as_const(datas[i]));
+		}
 
-		auto [e2, n2] = co_await net::async_send_to(bound, net::buffer(data, n1), sender_endpoint);
+		auto [e2, n2] = co_await net::async_send_batch(bound,
+			std::span(echoes.data(), count), std::span(sender_endpoints.data(), count));
 		if (e2)
 			co_return;
 
-		if (n1 == data.size())
-			data.resize(data.size() * 3 / 2);
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			if (datas[i].size() == datas[i].capacity() && datas[i].size() < net::datagram_pool::jumbo_size)
+				datas[i] = net::datagram_pool::acquire(net::datagram_pool::jumbo_size);
+		}
 	}
 }
 
 net::awaitable<void> ext_transfer(
-	net::tcp_socket& from, net::udp_socket& bound, socks5::handshake_info& info, time_point& deadline)
+	net::tcp_socket& from, net::udp_socket& bound, socks5::handshake_info& info, net::deadline& deadline)
 {
-	net::streambuf buf{ 1024 * 1024 };
+	net::linear_buffer buf{ 1024 * 1024 };
 
 	for (;;)
 	{
-		deadline = std::chrono::steady_clock::now() + std::chrono::minutes(10);
+		deadline.expires_after(std::chrono::minutes(10));
 
 		// recvd data from the front client by tcp, forward the data to back client.
-		auto [e1, n1] = co_await net::async_read_until(from, buf, socks5::udp_match_condition);
+		auto [e1, frames] = co_await net::async_read_frame(from, buf, socks5::udp_framing{});
 		if (e1)
 			co_return;
 
 		info.last_read_channel = net::protocol::tcp;
 
-		std::string_view data{ (std::string_view::value_type*)(buf.data().data()), buf.data().size() };
-
-		// this packet is a extension protocol base of below:
-		// +----+------+------+----------+----------+----------+
-		// |RSV | FRAG | ATYP | DST.ADDR | DST.PORT |   DATA   |
-		// +----+------+------+----------+----------+----------+
-		// | 2  |  1   |  1   | Variable |    2     | Variable |
-		// +----+------+------+----------+----------+----------+
-		// the RSV field is the real data length of the field DATA.
-		// so we need unpacket this data, and send the real data to the back client.
-		auto [err, ep, domain, real_data] = socks5::parse_udp_packet(data, true);
-		if (err == 0)
+		for (std::string_view data : frames)
 		{
-			if (domain.empty())
-			{
-				co_await net::async_send_to(bound, net::buffer(real_data), ep);
-			}
-			else
+			// this packet is a extension protocol base of below:
+			// +----+------+------+----------+----------+----------+
+			// |RSV | FRAG | ATYP | DST.ADDR | DST.PORT |   DATA   |
+			// +----+------+------+----------+----------+----------+
+			// | 2  |  1   |  1   | Variable |    2     | Variable |
+			// +----+------+------+----------+----------+----------+
+			// the RSV field is the real data length of the field DATA.
+			// so we need unpacket this data, and send the real data to the back client.
+			auto [err, ep, domain, real_data] = socks5::parse_udp_packet(data, true);
+			if (err == 0)
 			{
-				co_await net::async_send_to(bound, net::buffer(real_data), std::move(domain), ep.port());
+				if (domain.empty())
+				{
+					co_await net::async_send_to(bound, net::buffer(real_data), ep);
+				}
+				else
+				{
+					co_await net::async_send_to(bound, net::buffer(real_data), std::move(domain), ep.port());
+				}
 			}
 		}
-
-		buf.consume(n1);
 	}
 }
 
-net::awaitable<void> watchdog(time_point& deadline)
+net::awaitable<void> watchdog(net::deadline& deadline)
 {
-	net::timer timer(co_await net::this_coro::executor);
-	auto now = std::chrono::steady_clock::now();
-	while (deadline > now)
-	{
-		timer.expires_at(deadline);
-		co_await timer.async_wait();
-		now = std::chrono::steady_clock::now();
-	}
+	// the transfers keep pushing the deadline forward, the wait completes when it finally expires.
+	co_await deadline.async_wait();
 }
 
 net::awaitable<void> proxy(net::tcp_socket front_client, socks5::auth_config& auth_cfg)
 {
-	auto result1 = co_await(
-		socks5::async_accept(front_client, auth_cfg, net::use_nothrow_awaitable) ||
-		net::timeout(std::chrono::seconds(5)));
-	if (net::is_timeout(result1))
-		co_return; // timed out
-	auto [e1, info] = std::get<0>(std::move(result1));
+	auto [e1, info] = co_await socks5::async_accept(front_client, auth_cfg,
+		net::with_deadline(net::use_nothrow_awaitable, std::chrono::seconds(5)));
 	if (e1)
-		co_return;
-
-	time_point deadline{};
+		co_return; // failed or timed out
 
 	if (info.cmd == socks5::command::connect)
 	{
@@ -209,10 +217,7 @@ net::awaitable<void> proxy(net::tcp_socket front_client, socks5::auth_config& au
 		{
 			net::tcp_socket back_client = std::move(*ptr);
 
-			co_await(
-				tcp_transfer(front_client, back_client, info, deadline) ||
-				tcp_transfer(back_client, front_client, info, deadline) ||
-				watchdog(deadline));
+			co_await tcp_transfer(front_client, back_client);
 		}
 	}
 	else if(info.cmd == socks5::command::udp_associate)
@@ -222,6 +227,8 @@ net::awaitable<void> proxy(net::tcp_socket front_client, socks5::auth_config& au
 		{
 			net::udp_socket back_client = std::move(*ptr);
 
+			net::deadline deadline(front_client.get_executor());
+
 			co_await(
 				udp_transfer(front_client, back_client, info, deadline) ||
 				ext_transfer(front_client, back_client, info, deadline) ||
@@ -232,7 +239,8 @@ net::awaitable<void> proxy(net::tcp_socket front_client, socks5::auth_config& au
 	co_return;
 }
 
-net::awaitable<void> listen(std::string listen_address, std::uint16_t listen_port, socks5::auth_config auth_cfg)
+net::awaitable<void> listen(
+	net::io_context_pool& pool, std::string listen_address, std::uint16_t listen_port, socks5::auth_config auth_cfg)
 {
 	auto executor = co_await net::this_coro::executor;
 	auto [e1, acceptor] = co_await net::async_create_acceptor(executor, listen_address, listen_port);
@@ -249,11 +257,15 @@ net::awaitable<void> listen(std::string listen_address, std::uint16_t listen_por
 	}
 	for (;;)
 	{
-		auto [e2, client] = co_await acceptor.async_accept();
+		auto [e2, clients] = co_await net::async_accept_batch(acceptor, 64, [&pool]() { return pool.get_executor(); });
 		if (e2)
 			co_await net::delay(std::chrono::milliseconds(100));
-		else
-			net::co_spawn(executor, proxy(std::move(client), auth_cfg), net::detached);
+
+		for (auto& client : clients)
+		{
+			auto client_executor = client.get_executor();
+			net::co_spawn(client_executor, proxy(std::move(client), auth_cfg), net::detached);
+		}
 	}
 }
 
@@ -269,7 +281,7 @@ int main()
 	_CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
 #endif
 
-	net::io_context ctx(1);
+	net::io_context_pool pool;
 
 	socks5::auth_config auth_cfg
 	{
@@ -277,15 +289,16 @@ int main()
 		.auth_function = std::bind_front(do_auth),
 	};
 
-	net::signal_set signals(ctx, SIGINT, SIGTERM);
+	net::signal_set signals(pool.get_context(0), SIGINT, SIGTERM);
 	signals.async_wait([&](auto, auto)
 	{
-		ctx.stop();
+		pool.stop();
 	});
 
-	net::co_spawn(ctx, listen("127.0.0.1", 20808, std::move(auth_cfg)), net::detached);
+	net::co_spawn(pool.get_context(0), listen(pool, "127.0.0.1", 20808, std::move(auth_cfg)), net::detached);
 
-	ctx.run();
+	pool.start();
+	pool.wait();
 
 	return 0;
 }
@@ -0,0 +1,178 @@
+// route the allocations of asio itself through the global operator new, so they are counted too.
+#define ASIO_DISABLE_STD_ALIGNED_ALLOC
+
+#include <asio3/core/fmt.hpp>
+#include <asio3/core/timer.hpp>
+#include <asio3/tcp/accept.hpp>
+#include <asio3/tcp/connect.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+
+namespace net = ::asio;
+
+// usage: alloc_bench [concurrency] [connections]
+
+// counts the calls of the global operator new which are made by the associated allocator of the
+// handlers, i.e. for the coroutine frames and the operations started by them. The other allocations
+// of the process, e.g. the resolve results or the sockets, are not counted.
+static std::atomic<std::uint64_t> g_allocations{ 0 };
+
+static thread_local bool g_in_frame_allocation = false;
+
+// the replacements are not inlined, otherwise gcc sees the pointer of the operator new be passed
+// to std::free and warns with -Wmismatched-new-delete.
+[[gnu::noinline]] void* operator new(std::size_t size)
+{
+	if (g_in_frame_allocation)
+		g_allocations.fetch_add(1, std::memory_order_relaxed);
+
+	if (void* p = std::malloc(size ? size : 1))
+		return p;
+
+	throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+[[gnu::noinline]] void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+// wraps the associated allocator, a call of the global operator new inside it is counted.
+template<typename Allocator>
+class counting_allocator : public Allocator
+{
+public:
+	using value_type = typename Allocator::value_type;
+
+	template<typename U>
+	struct rebind
+	{
+		using other = counting_allocator<typename std::allocator_traits<Allocator>::template rebind_alloc<U>>;
+	};
+
+	counting_allocator() = default;
+
+	template<typename OtherAllocator>
+	counting_allocator(const counting_allocator<OtherAllocator>& other) noexcept
+		: Allocator(static_cast<const OtherAllocator&>(other))
+	{
+	}
+
+	value_type* allocate(std::size_t n)
+	{
+		g_in_frame_allocation = true;
+		value_type* p = Allocator::allocate(n);
+		g_in_frame_allocation = false;
+		return p;
+	}
+};
+
+net::awaitable<void> do_accept(net::tcp_acceptor& acceptor)
+{
+	for (;;)
+	{
+		auto [e1, client] = co_await acceptor.async_accept();
+		if (e1)
+			co_return;
+	}
+}
+
+// each connection runs an async_connect and an async_sleep, which are both co_composed operations.
+template<typename Token>
+net::awaitable<void> do_connect(net::ip::tcp::endpoint endpoint, std::size_t connections, Token token)
+{
+	auto executor = co_await net::this_coro::executor;
+
+	std::string host = endpoint.address().to_string();
+
+	for (std::size_t i = 0; i < connections; ++i)
+	{
+		net::tcp_socket sock(executor);
+
+		auto [e1, ep] = co_await net::async_connect(sock, host, endpoint.port(),
+			net::detail::default_set_option_callback{}, token);
+		if (e1)
+		{
+			fmt::print("connect failure: {}\n", e1.message());
+			co_return;
+		}
+
+		co_await net::async_sleep(executor, std::chrono::steady_clock::duration::zero(), token);
+
+		sock.close();
+	}
+}
+
+template<typename Token>
+std::uint64_t run_round(net::io_context& ctx, net::ip::tcp::endpoint endpoint,
+	std::size_t concurrency, std::size_t connections, Token token)
+{
+	std::uint64_t allocations = g_allocations.load(std::memory_order_relaxed);
+
+	std::size_t finished = 0;
+
+	for (std::size_t i = 0; i < concurrency; ++i)
+	{
+		net::co_spawn(ctx, do_connect(endpoint, connections / concurrency, token),
+		[&](std::exception_ptr)
+		{
+			if (++finished == concurrency)
+				ctx.stop();
+		});
+	}
+
+	ctx.restart();
+	ctx.run();
+
+	return g_allocations.load(std::memory_order_relaxed) - allocations;
+}
+
+template<typename Token>
+void run(const char* name, std::size_t concurrency, std::size_t connections, Token token)
+{
+	net::io_context ctx(1);
+
+	net::tcp_acceptor acceptor(ctx, net::ip::tcp::endpoint(net::ip::address_v4::loopback(), 0));
+
+	net::co_spawn(ctx, do_accept(acceptor), net::detached);
+
+	// the first round warms up the resolve cache and the frame cache.
+	run_round(ctx, acceptor.local_endpoint(), concurrency, concurrency, token);
+
+	std::uint64_t allocations = run_round(ctx, acceptor.local_endpoint(), concurrency, connections, token);
+
+	std::size_t total = connections / concurrency * concurrency;
+
+	fmt::print("{:<20} {:>10} frame allocations {:>8.2f} per connection\n",
+		name, allocations, double(allocations) / double(total));
+}
+
+int main(int argc, char* argv[])
+{
+	std::size_t concurrency = 64;
+	std::size_t connections = 10000;
+
+	if (argc > 1) concurrency = std::max<std::size_t>(std::strtoull(argv[1], nullptr, 10), 1);
+	if (argc > 2) connections = std::max<std::size_t>(std::strtoull(argv[2], nullptr, 10), concurrency);
+
+	fmt::print("concurrency: {} connections: {}\n", concurrency, connections);
+
+	// the frames are allocated by the asio::recycling_allocator, which is what co_composed uses
+	// when the handler has no associated allocator.
+	run("recycling_allocator", concurrency, connections,
+		net::bind_allocator(counting_allocator<net::recycling_allocator<void>>(), net::use_nothrow_awaitable));
+
+	// the frames are allocated by the asio::frame_allocator, which is the default of asio3.
+	run("frame_allocator", concurrency, connections,
+		net::bind_allocator(counting_allocator<net::frame_allocator<void>>(), net::use_nothrow_awaitable));
+
+	return 0;
+}
@@ -0,0 +1,174 @@
+#include <asio3/core/fmt.hpp>
+#include <asio3/core/registered_buffer_pool.hpp>
+#include <asio3/tcp/accept.hpp>
+#include <asio3/tcp/read.hpp>
+#include <asio3/tcp/write.hpp>
+
+namespace net = ::asio;
+
+// usage: echo_bench [connections] [message_size] [seconds]
+
+struct bench_option
+{
+	std::size_t connections  = 64;
+	std::size_t message_size = 4096;
+	std::size_t seconds      = 5;
+};
+
+net::awaitable<void> echo_plain(net::tcp_socket sock, std::size_t size)
+{
+	std::vector<char> data(size);
+
+	for (;;)
+	{
+		auto [e1, n1] = co_await sock.async_read_some(net::buffer(data));
+		if (e1)
+			co_return;
+
+		auto [e2, n2] = co_await net::async_write(sock, net::buffer(data.data(), n1));
+		if (e2)
+			co_return;
+	}
+}
+
+net::awaitable<void> echo_registered(net::tcp_socket sock, std::size_t size)
+{
+	net::registered_block block = net::acquire_registered_buffer(sock.get_executor());
+	if (!block)
+	{
+		co_await echo_plain(std::move(sock), size);
+		co_return;
+	}
+
+	for (;;)
+	{
+		auto [e1, n1] = co_await sock.async_read_some(block.buffer());
+		if (e1)
+			co_return;
+
+		auto [e2, n2] = co_await net::async_write(sock, block.buffer(n1));
+		if (e2)
+			co_return;
+	}
+}
+
+net::awaitable<void> do_accept(net::tcp_acceptor& acceptor, bool registered, std::size_t size)
+{
+	auto executor = co_await net::this_coro::executor;
+
+	for (;;)
+	{
+		auto [e1, client] = co_await acceptor.async_accept();
+		if (e1)
+			co_return;
+
+		client.set_option(net::ip::tcp::no_delay(true));
+
+		if (registered)
+			net::co_spawn(executor, echo_registered(std::move(client), size), net::detached);
+		else
+			net::co_spawn(executor, echo_plain(std::move(client), size), net::detached);
+	}
+}
+
+net::awaitable<void> do_client(
+	net::ip::tcp::endpoint endpoint, std::size_t size, std::chrono::steady_clock::time_point end,
+	std::uint64_t& messages)
+{
+	auto executor = co_await net::this_coro::executor;
+
+	net::tcp_socket sock(executor);
+
+	auto [e1] = co_await sock.async_connect(endpoint);
+	if (e1)
+	{
+		fmt::print("connect failure: {}\n", e1.message());
+		co_return;
+	}
+
+	sock.set_option(net::ip::tcp::no_delay(true));
+
+	std::vector<char> msg(size, 'x'), reply(size);
+
+	while (std::chrono::steady_clock::now() < end)
+	{
+		auto [e2, n2] = co_await net::async_write(sock, net::buffer(msg));
+		if (e2)
+			break;
+
+		auto [e3, n3] = co_await net::async_read(sock, net::buffer(reply));
+		if (e3)
+			break;
+
+		++messages;
+	}
+
+	sock.close();
+}
+
+void run(const bench_option& opt, bool registered)
+{
+	net::io_context ctx(1);
+
+	if (registered)
+	{
+		net::use_service<net::registered_buffer_pool_service>(ctx).set_option({
+			.block_size = opt.message_size, .block_count = opt.connections });
+	}
+
+	net::tcp_acceptor acceptor(ctx, net::ip::tcp::endpoint(net::ip::address_v4::loopback(), 0));
+
+	net::co_spawn(ctx, do_accept(acceptor, registered, opt.message_size), net::detached);
+
+	auto beg = std::chrono::steady_clock::now();
+	auto end = beg + std::chrono::seconds(opt.seconds);
+
+	std::uint64_t messages = 0;
+	std::size_t   finished = 0;
+
+	for (std::size_t i = 0; i < opt.connections; ++i)
+	{
+		net::co_spawn(ctx, do_client(acceptor.local_endpoint(), opt.message_size, end, messages),
+		[&](std::exception_ptr)
+		{
+			if (++finished == opt.connections)
+				ctx.stop();
+		});
+	}
+
+	ctx.run();
+
+	double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - beg).count();
+
+	auto& pool = net::use_service<net::registered_buffer_pool_service>(ctx);
+
+	fmt::print("{:<12} {:>12.0f} msgs/s {:>10.1f} MB/s{}\n",
+		registered ? "registered" : "plain",
+		double(messages) / secs,
+		double(messages * opt.message_size) / secs / 1024.0 / 1024.0,
+		registered && !pool.is_registered() ?
+			fmt::format("  (registration failed: {})", pool.registration_error().message()) : "");
+}
+
+int main(int argc, char* argv[])
+{
+	bench_option opt{};
+
+	if (argc > 1) opt.connections  = std::max<std::size_t>(std::strtoull(argv[1], nullptr, 10), 1);
+	if (argc > 2) opt.message_size = std::max<std::size_t>(std::strtoull(argv[2], nullptr, 10), 1);
+	if (argc > 3) opt.seconds      = std::max<std::size_t>(std::strtoull(argv[3], nullptr, 10), 1);
+
+#if defined(ASIO_HAS_IO_URING)
+	fmt::print("backend: io_uring\n");
+#else
+	fmt::print("backend: reactor, the registered blocks are plain pooled buffers\n");
+#endif
+
+	fmt::print("connections: {} message size: {} seconds: {}\n",
+		opt.connections, opt.message_size, opt.seconds);
+
+	run(opt, false);
+	run(opt, true);
+
+	return 0;
+}
@@ -1,25 +1,26 @@
+#include <asio3/core/io_context_pool.hpp>
 #include <asio3/tcp/accept.hpp>
 #include <asio3/tcp/read.hpp>
 
 namespace net = ::asio;
 
-net::awaitable<void> echo(net::tcp_socket sock)
+net::awaitable<void> echo(net::tcp_socket sock, [[maybe_unused]] net::io_context_pool::load_guard guard)
 {
-	std::array<char, 1024> data;
+	net::adaptive_read_buffer buf;
 
 	for (;;)
 	{
-		auto [e1, n1] = co_await net::async_read_some(sock, net::buffer(data));
+		auto [e1, n1] = co_await net::async_read_some_adaptive(sock, buf);
 		if (e1)
 			co_return;
 
-		auto [e2, n2] = co_await net::async_write(sock, net::buffer(data, n1));
+		auto [e2, n2] = co_await net::async_write(sock, net::buffer(buf.data()));
 		if (e2)
 			co_return;
 	}
 }
 
-net::awaitable<void> do_accept()
+net::awaitable<void> do_accept(net::io_context_pool& pool)
 {
 	auto executor = co_await net::this_coro::executor;
 
@@ -27,19 +28,30 @@ net::awaitable<void> do_accept()
 
 	for (;;)
 	{
-		auto [e2, client] = co_await acceptor.async_accept();
+		auto [e2, clients] = co_await net::async_accept_batch(acceptor, 64, [&pool]() { return pool.get_executor(); });
 		if (e2)
 			co_await net::delay(std::chrono::milliseconds(100));
-		else
-			net::co_spawn(executor, echo(std::move(client)), net::detached);
+
+		for (auto& client : clients)
+		{
+			auto client_executor = client.get_executor();
+			net::co_spawn(client_executor, echo(std::move(client), pool.track(client_executor)), net::detached);
+		}
 	}
 }
 
 int main()
 {
-	net::io_context ctx(1);
+	net::io_context_pool pool({ .pin_threads = true, .select = net::io_context_select::least_loaded });
+
+	net::signal_set signals(pool.get_context(0), SIGINT, SIGTERM);
+	signals.async_wait([&](auto, auto)
+	{
+		pool.stop();
+	});
 
-	net::co_spawn(ctx, do_accept(), net::detached);
+	net::co_spawn(pool.get_context(0), do_accept(pool), net::detached);
 
-	ctx.run();
+	pool.start();
+	pool.wait();
 }
@@ -0,0 +1,54 @@
+#include <asio3/core/fmt.hpp>
+#include <asio3/udp/server_sessions.hpp>
+
+namespace net = ::asio;
+
+net::awaitable<void> echo(std::shared_ptr<net::udp_session> session)
+{
+	std::array<char, 1500> buf;
+
+	for (;;)
+	{
+		auto [e1, n1] = co_await session->async_receive(net::buffer(buf));
+		if (e1)
+			co_return;
+
+		auto [e2, n2] = co_await session->async_send(net::buffer(buf.data(), n1));
+		if (e2)
+			co_return;
+	}
+}
+
+net::awaitable<void> do_accept(net::udp_server_sessions& server)
+{
+	for (;;)
+	{
+		auto [e1, session] = co_await server.async_accept();
+		if (e1)
+			co_return;
+
+		fmt::print("new session: {}:{}\n",
+			session->remote_endpoint().address().to_string(), session->remote_endpoint().port());
+
+		net::co_spawn(session->get_executor(), echo(std::move(session)), net::detached);
+	}
+}
+
+int main()
+{
+	net::io_context ctx(1);
+
+	net::udp_server_sessions server(
+		net::udp_socket(ctx, net::ip::udp::endpoint(net::ip::udp::v4(), 20802)),
+		{ .idle_timeout = std::chrono::seconds(30) });
+
+	net::signal_set signals(ctx, SIGINT, SIGTERM);
+	signals.async_wait([&](auto, auto)
+	{
+		server.close();
+	});
+
+	net::co_spawn(ctx, do_accept(server), net::detached);
+
+	ctx.run();
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2017-2023 zhllxt
+ *
+ * author   : zhllxt
+ * email    : 37792738@qq.com
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <string_view>
+
+#include <asio3/core/asio.hpp>
+#include <asio3/core/buffer_pool.hpp>
+
+namespace asio
+{
+	/**
+	 * @brief A read buffer whose size adapts to the recent read sizes, like the netty
+	 * AdaptiveRecvByteBufAllocator. The size is quadrupled when a read fills the buffer, and
+	 * halved when two reads in a row use no more than half of it. The storage is borrowed from
+	 * a buffer pool, and can be returned to the pool while the connection is idle.
+	 * @eg:
+	 * asio::adaptive_read_buffer buf;
+	 * auto [ec, n] = co_await asio::async_read_some_adaptive(sock, buf);
+	 * std::string_view data = buf.data();
+	 */
+	class adaptive_read_buffer
+	{
+	public:
+		static constexpr std::size_t default_min_size     = 64;
+		static constexpr std::size_t default_initial_size = 1024;
+		static constexpr std::size_t default_max_size     = 64 * 1024;
+
+		/**
+		 * @param min_size - The minimum buffer size.
+		 * @param initial_size - The buffer size of the first read.
+		 * @param max_size - The maximum buffer size.
+		 * @param pool - The pool which the storage is borrowed from, it must outlive the buffer.
+		 */
+		explicit adaptive_read_buffer(
+			std::size_t min_size     = default_min_size,
+			std::size_t initial_size = default_initial_size,
+			std::size_t max_size     = default_max_size,
+			buffer_pool& pool        = buffer_pool::shared()) noexcept
+			: pool_(std::addressof(pool))
+			, min_(buffer_pool::block_size(min_size))
+			, max_((std::max)(min_, buffer_pool::block_size(max_size)))
+			, guess_((std::clamp)(buffer_pool::block_size(initial_size), min_, max_))
+		{
+		}
+
+		adaptive_read_buffer(adaptive_read_buffer&&) noexcept = default;
+		adaptive_read_buffer& operator=(adaptive_read_buffer&&) noexcept = default;
+
+		/**
+		 * @brief Get the buffer of the next read, the storage is borrowed from the pool if needed.
+		 * @param hint - The bytes which are known to be readable, 0 means unknown.
+		 * @note The data of the previous read is invalidated.
+		 */
+		asio::mutable_buffer prepare(std::size_t hint = 0)
+		{
+			std::size_t size = (std::clamp)(buffer_pool::block_size((std::max)(guess_, hint)), min_, max_);
+
+			if (storage_.size() != size)
+			{
+				storage_.reset();
+				storage_ = pool_->acquire(size);
+			}
+
+			size_ = 0;
+
+			return asio::mutable_buffer(storage_.data(), storage_.size());
+		}
+
+		/**
+		 * @brief Record the bytes of the read into the buffer which is returned by prepare.
+		 */
+		void commit(std::size_t n) noexcept
+		{
+			size_ = (std::min)(n, storage_.size());
+
+			if (size_ == 0)
+				return;
+
+			if (size_ >= storage_.size())
+			{
+				guess_ = (std::min)(guess_ * 4, max_);
+				decrease_now_ = false;
+			}
+			else if (size_ <= guess_ / 2)
+			{
+				if (decrease_now_)
+				{
+					guess_ = (std::max)(guess_ / 2, min_);
+					decrease_now_ = false;
+				}
+				else
+				{
+					decrease_now_ = true;
+				}
+			}
+			else
+			{
+				decrease_now_ = false;
+			}
+		}
+
+		/**
+		 * @brief Return the storage to the pool, the data is cleared.
+		 */
+		inline void release() noexcept
+		{
+			storage_.reset();
+			size_ = 0;
+		}
+
+		/**
+		 * @brief The data of the last read.
+		 */
+		inline std::string_view data() const noexcept
+		{
+			return std::string_view(storage_.data(), size_);
+		}
+
+		/// The bytes of the last read.
+		inline std::size_t size() const noexcept { return size_; }
+
+		/// The buffer size of the next read.
+		inline std::size_t guess() const noexcept { return guess_; }
+
+		/// Whether the storage is borrowed from the pool.
+		inline bool has_storage() const noexcept { return !storage_.empty(); }
+
+	protected:
+		buffer_pool*  pool_;
+
+		std::size_t   min_;
+		std::size_t   max_;
+		std::size_t   guess_;
+
+		bool          decrease_now_ = false;
+
+		pooled_buffer storage_{};
+		std::size_t   size_ = 0;
+	};
+}
@@ -0,0 +1,296 @@
+/*
+ * Copyright (c) 2017-2023 zhllxt
+ *
+ * author   : zhllxt
+ * email    : 37792738@qq.com
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <asio3/core/asio.hpp>
+#include <asio3/core/detail/thread_cache.hpp>
+#include <asio3/core/spin_lock.hpp>
+
+namespace asio
+{
+	class buffer_pool;
+
+	/**
+	 * @brief A memory block borrowed from the buffer pool, it is returned to the pool when destroyed.
+	 */
+	class pooled_buffer
+	{
+	public:
+		pooled_buffer() noexcept = default;
+
+		pooled_buffer(buffer_pool* pool, char* data, std::size_t size) noexcept
+			: pool_(pool), data_(data), size_(size)
+		{
+		}
+
+		~pooled_buffer()
+		{
+			reset();
+		}
+
+		pooled_buffer(pooled_buffer&& other) noexcept
+			: pool_(std::exchange(other.pool_, nullptr))
+			, data_(std::exchange(other.data_, nullptr))
+			, size_(std::exchange(other.size_, 0))
+		{
+		}
+
+		pooled_buffer& operator=(pooled_buffer&& other) noexcept
+		{
+			if (this != std::addressof(other))
+			{
+				reset();
+
+				pool_ = std::exchange(other.pool_, nullptr);
+				data_ = std::exchange(other.data_, nullptr);
+				size_ = std::exchange(other.size_, 0);
+			}
+			return *this;
+		}
+
+		pooled_buffer(const pooled_buffer&) = delete;
+		pooled_buffer& operator=(const pooled_buffer&) = delete;
+
+		inline char* data() noexcept { return data_; }
+		inline const char* data() const noexcept { return data_; }
+
+		inline std::size_t size() const noexcept { return size_; }
+
+		inline bool empty() const noexcept { return data_ == nullptr; }
+
+		inline explicit operator bool() const noexcept { return data_ != nullptr; }
+
+		/**
+		 * @brief Return the memory block to the pool.
+		 */
+		inline void reset() noexcept;
+
+	protected:
+		buffer_pool* pool_ = nullptr;
+		char*        data_ = nullptr;
+		std::size_t  size_ = 0;
+	};
+
+	/**
+	 * @brief A thread safety pool of memory blocks, the block sizes are powers of two.
+	 * The released blocks are cached per size class until the cached bytes reach the limit,
+	 * the blocks which are larger than max_block_size are not cached.
+	 * The small blocks are cached per thread in front of the pool first, like asio::datagram_pool,
+	 * so the acquire and the release of them in the same thread don't take the lock of the pool.
+	 * @eg: asio::pooled_buffer buf = asio::buffer_pool::shared().acquire(4096);
+	 */
+	class buffer_pool
+	{
+	public:
+		static constexpr std::size_t min_block_size = 64;
+		static constexpr std::size_t max_block_size = 1024 * 1024;
+
+		/// The blocks up to this size are cached per thread, at most thread_cached_blocks per size.
+		static constexpr std::size_t max_thread_cached_block_size = 64 * 1024;
+		static constexpr std::size_t thread_cached_blocks         = 8;
+
+		/**
+		 * @param max_cached_bytes - The maximum bytes of the cached free blocks.
+		 */
+		explicit buffer_pool(std::size_t max_cached_bytes = 64 * 1024 * 1024) noexcept
+			: max_cached_bytes_(max_cached_bytes)
+		{
+		}
+
+		~buffer_pool()
+		{
+			for (auto& blocks : free_)
+			{
+				for (char* p : blocks)
+					delete[] p;
+			}
+		}
+
+		buffer_pool(const buffer_pool&) = delete;
+		buffer_pool& operator=(const buffer_pool&) = delete;
+
+		/**
+		 * @brief The process wide pool.
+		 */
+		static buffer_pool& shared()
+		{
+			static buffer_pool pool{};
+			return pool;
+		}
+
+		/**
+		 * @brief Borrow a block whose size is at least n, the size is rounded up to the power of two.
+		 */
+		pooled_buffer acquire(std::size_t n)
+		{
+			std::size_t size = block_size(n);
+
+			if (size <= max_thread_cached_block_size)
+			{
+				if (thread_cache* cache = thread_cache::current())
+				{
+					if (block_node* p = cache->pop(class_index(size)))
+						return pooled_buffer(this, reinterpret_cast<char*>(p), size);
+				}
+			}
+
+			if (size <= max_block_size)
+			{
+				std::lock_guard guard(lock_);
+
+				auto& blocks = free_[class_index(size)];
+				if (!blocks.empty())
+				{
+					char* p = blocks.back();
+					blocks.pop_back();
+					cached_bytes_ -= size;
+					return pooled_buffer(this, p, size);
+				}
+			}
+
+			return pooled_buffer(this, new char[size], size);
+		}
+
+		/**
+		 * @brief Free all the cached blocks of the pool and the cached blocks of the current thread.
+		 */
+		void shrink()
+		{
+			if (thread_cache* cache = thread_cache::current())
+				cache->clear();
+
+			std::array<std::vector<char*>, class_count> free{};
+
+			{
+				std::lock_guard guard(lock_);
+				free.swap(free_);
+				cached_bytes_ = 0;
+			}
+
+			for (auto& blocks : free)
+			{
+				for (char* p : blocks)
+					delete[] p;
+			}
+		}
+
+		/**
+		 * @brief The bytes of the cached free blocks, the blocks of the thread caches are excluded.
+		 */
+		inline std::size_t cached_bytes() const noexcept
+		{
+			std::lock_guard guard(lock_);
+			return cached_bytes_;
+		}
+
+		/**
+		 * @brief The block size which a request of n bytes is rounded up to.
+		 */
+		static inline std::size_t block_size(std::size_t n) noexcept
+		{
+			return n <= min_block_size ? min_block_size : std::bit_ceil(n);
+		}
+
+	protected:
+		friend class pooled_buffer;
+
+		static constexpr std::size_t class_count =
+			std::size_t(std::countr_zero(max_block_size) - std::countr_zero(min_block_size) + 1);
+
+		static inline std::size_t class_index(std::size_t size) noexcept
+		{
+			return std::size_t(std::countr_zero(size) - std::countr_zero(min_block_size));
+		}
+
+		struct block_node
+		{
+			block_node* next;
+		};
+
+		struct block_disposer
+		{
+			inline void operator()(block_node* p) const noexcept
+			{
+				delete[] reinterpret_cast<char*>(p);
+			}
+		};
+
+		/**
+		 * The per thread cache of the small blocks, it is shared by all the pools, a block of a size
+		 * class can be used by any pool since all of them are allocated by new char[size].
+		 */
+		using thread_cache = detail::thread_cache<block_node, std::size_t(
+			std::countr_zero(max_thread_cached_block_size) - std::countr_zero(min_block_size) + 1), block_disposer>;
+
+		void release(char* p, std::size_t size) noexcept
+		{
+			if (size <= max_thread_cached_block_size)
+			{
+				if (thread_cache* cache = thread_cache::current();
+					cache && cache->push(class_index(size), ::new (p) block_node{}, thread_cached_blocks))
+					return;
+			}
+
+			if (size <= max_block_size)
+			{
+				std::lock_guard guard(lock_);
+
+				if (cached_bytes_ + size <= max_cached_bytes_)
+				{
+					auto& blocks = free_[class_index(size)];
+
+					try
+					{
+						blocks.emplace_back(p);
+						cached_bytes_ += size;
+						return;
+					}
+					catch (const std::bad_alloc&)
+					{
+					}
+				}
+			}
+
+			delete[] p;
+		}
+
+	protected:
+		mutable asio::spin_lock                    lock_;
+
+		std::size_t                                max_cached_bytes_;
+		std::size_t                                cached_bytes_ = 0;
+
+		std::array<std::vector<char*>, class_count> free_{};
+	};
+
+	inline void pooled_buffer::reset() noexcept
+	{
+		if (data_)
+		{
+			if (pool_)
+				pool_->release(data_, size_);
+			else
+				delete[] data_;
+		}
+
+		pool_ = nullptr;
+		data_ = nullptr;
+		size_ = 0;
+	}
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2017-2023 zhllxt
+ *
+ * author   : zhllxt
+ * email    : 37792738@qq.com
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <chrono>
+
+namespace asio::detail
+{
+	/**
+	 * @brief Detect an idle timeout by the ticks of a timer, a transfer only marks the counter
+	 * as active, so no clock is read per transfer. The timer ticks every interval(timeout), the
+	 * counter expires after idle_counter::ticks ticks without any transfer, so the timeout is
+	 * detected within a quarter of it.
+	 */
+	class idle_counter
+	{
+	public:
+		static constexpr int ticks = 4;
+
+		static inline std::chrono::steady_clock::duration interval(std::chrono::steady_clock::duration timeout) noexcept
+		{
+			return timeout / ticks;
+		}
+
+		/**
+		 * @brief Mark a transfer.
+		 */
+		inline void touch() noexcept
+		{
+			active_ = true;
+		}
+
+		/**
+		 * @brief Count a tick of the timer, returns true if the timeout is reached.
+		 */
+		inline bool tick() noexcept
+		{
+			if (active_)
+			{
+				active_ = false;
+				idle_ = 0;
+				return false;
+			}
+
+			return ++idle_ >= ticks;
+		}
+
+	protected:
+		int  idle_   = 0;
+		bool active_ = false;
+	};
+}
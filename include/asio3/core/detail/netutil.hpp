@@ -32,6 +32,9 @@ namespace asio::detail
 	static long constexpr  udp_connect_timeout   = 30 * 1000;
 	static long constexpr http_connect_timeout   = 30 * 1000;
 
+	// RFC 8305 (Happy Eyeballs) : the recommended delay between starting two connection attempts.
+	static long constexpr  tcp_connection_attempt_delay = 250;
+
 	static long constexpr  tcp_silence_timeout   = 60 * 60 * 1000;
 	static long constexpr  udp_silence_timeout   = 60 * 1000;
 	static long constexpr http_silence_timeout   = 85 * 1000;
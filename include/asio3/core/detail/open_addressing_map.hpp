@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2017-2023 zhllxt
+ *
+ * author   : zhllxt
+ * email    : 37792738@qq.com
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace asio::detail
+{
+	/**
+	 * @brief A hash map with open addressing, linear probing and backward shift deletion.
+	 * The slots are one contiguous array, so find and erase never allocate, and insert only
+	 * allocates when the table grows. The hash of std::hash is mixed again, because the hash
+	 * of the integers and the ip addresses is usually the identity, which would cluster in
+	 * the low bits that are used as the index. The mix is keyed by a random seed of the process,
+	 * so the remote peers can't choose the keys which collide.
+	 */
+	template<typename Key, typename Value, typename Hash = std::hash<Key>>
+	class open_addressing_map
+	{
+	public:
+		open_addressing_map() = default;
+
+		open_addressing_map(open_addressing_map&&) noexcept = default;
+		open_addressing_map& operator=(open_addressing_map&&) noexcept = default;
+
+		inline std::size_t size() const noexcept { return size_; }
+
+		inline bool empty() const noexcept { return size_ == 0; }
+
+		/**
+		 * @brief Find the value of the key, returns nullptr if the key does not exist.
+		 */
+		Value* find(const Key& key) noexcept
+		{
+			if (size_ == 0)
+				return nullptr;
+
+			std::size_t h = hash_of(key);
+
+			for (std::size_t i = h & mask_;; i = (i + 1) & mask_)
+			{
+				slot& s = slots_[i];
+
+				if (!s.used)
+					return nullptr;
+
+				if (s.hash == h && s.key == key)
+					return std::addressof(s.value);
+			}
+		}
+
+		/**
+		 * @brief Insert the value of the key, the key must not exist.
+		 */
+		Value& insert(const Key& key, Value value)
+		{
+			// keep the load factor under 1/2, the probe sequences stay short.
+			if ((size_ + 1) * 2 > slots_.size())
+				rehash(slots_.empty() ? 16 : slots_.size() * 2);
+
+			std::size_t h = hash_of(key);
+
+			std::size_t i = h & mask_;
+			while (slots_[i].used)
+				i = (i + 1) & mask_;
+
+			slot& s = slots_[i];
+			s.key   = key;
+			s.value = std::move(value);
+			s.hash  = h;
+			s.used  = true;
+
+			++size_;
+
+			return s.value;
+		}
+
+		/**
+		 * @brief Erase the key, returns false if the key does not exist.
+		 */
+		bool erase(const Key& key)
+		{
+			if (size_ == 0)
+				return false;
+
+			std::size_t h = hash_of(key);
+
+			std::size_t i = h & mask_;
+			for (;; i = (i + 1) & mask_)
+			{
+				if (!slots_[i].used)
+					return false;
+
+				if (slots_[i].hash == h && slots_[i].key == key)
+					break;
+			}
+
+			// shift the following entries back, so no tombstone is needed.
+			for (std::size_t j = i;;)
+			{
+				j = (j + 1) & mask_;
+
+				if (!slots_[j].used)
+					break;
+
+				std::size_t home = slots_[j].hash & mask_;
+
+				// the entry j can be moved to i only if i is between its home slot and j.
+				if (((j - home) & mask_) >= ((j - i) & mask_))
+				{
+					slots_[i] = std::move(slots_[j]);
+					i = j;
+				}
+			}
+
+			slots_[i].used  = false;
+			slots_[i].value = Value{};
+
+			--size_;
+
+			return true;
+		}
+
+		/**
+		 * @brief Call f(key, value) for each entry, the map must not be modified in f.
+		 */
+		template<typename Function>
+		void for_each(Function&& f)
+		{
+			for (slot& s : slots_)
+			{
+				if (s.used)
+					f(std::as_const(s.key), s.value);
+			}
+		}
+
+		void clear()
+		{
+			slots_.clear();
+			mask_ = 0;
+			size_ = 0;
+		}
+
+	protected:
+		struct slot
+		{
+			Key         key{};
+			Value       value{};
+			std::size_t hash = 0;
+			bool        used = false;
+		};
+
+		/// a random number of the process, the keys are usually chosen by the remote peers, so the
+		/// slots they land on must not be predictable, otherwise the probe sequences can be made long.
+		static inline std::uint64_t hash_seed() noexcept
+		{
+			static const std::uint64_t seed = []() noexcept
+			{
+				try
+				{
+					std::random_device rd;
+					return (std::uint64_t(rd()) << 32) ^ std::uint64_t(rd());
+				}
+				catch (...)
+				{
+					// the address of the seed varies by the aslr at least.
+					return std::uint64_t(reinterpret_cast<std::uintptr_t>(std::addressof(seed)));
+				}
+			}();
+			return seed;
+		}
+
+		static inline std::size_t hash_of(const Key& key) noexcept
+		{
+			// the finalizer of splitmix64, keyed by the seed of the process
+			std::uint64_t x = static_cast<std::uint64_t>(Hash{}(key)) ^ hash_seed();
+			x ^= x >> 30;
+			x *= 0xbf58476d1ce4e5b9ull;
+			x ^= x >> 27;
+			x *= 0x94d049bb133111ebull;
+			x ^= x >> 31;
+			return static_cast<std::size_t>(x);
+		}
+
+		void rehash(std::size_t capacity)
+		{
+			std::vector<slot> old = std::exchange(slots_, std::vector<slot>(capacity));
+
+			mask_ = capacity - 1;
+
+			for (slot& s : old)
+			{
+				if (!s.used)
+					continue;
+
+				std::size_t i = s.hash & mask_;
+				while (slots_[i].used)
+					i = (i + 1) & mask_;
+
+				slots_[i] = std::move(s);
+			}
+		}
+
+	protected:
+		std::vector<slot> slots_;
+
+		std::size_t       mask_ = 0;
+
+		std::size_t       size_ = 0;
+	};
+}
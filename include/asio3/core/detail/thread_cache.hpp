@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2017-2023 zhllxt
+ *
+ * author   : zhllxt
+ * email    : 37792738@qq.com
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace asio::detail
+{
+	/**
+	 * @brief A per thread cache of free memory blocks, the blocks are grouped by size classes,
+	 * each class is an intrusive list which is linked by the "Block* next" member of the blocks.
+	 * The Disposer frees a block, it is used when the cache is full, cleared or destroyed.
+	 * The cache of a thread is destroyed with its thread locals, the blocks which are released
+	 * after that are freed directly, so current() returns nullptr then.
+	 */
+	template<typename Block, std::size_t ClassCount, typename Disposer>
+	class thread_cache
+	{
+	public:
+		thread_cache() noexcept = default;
+
+		~thread_cache()
+		{
+			destroyed() = true;
+
+			clear();
+		}
+
+		thread_cache(const thread_cache&) = delete;
+		thread_cache& operator=(const thread_cache&) = delete;
+
+		/**
+		 * @brief Get the cache of the current thread, returns nullptr when the thread is exiting.
+		 */
+		static inline thread_cache* current() noexcept
+		{
+			if (destroyed())
+				return nullptr;
+
+			thread_local thread_cache cache;
+			return std::addressof(cache);
+		}
+
+		/**
+		 * @brief Take a cached block of the size class, returns nullptr if there is none.
+		 */
+		inline Block* pop(std::size_t index) noexcept
+		{
+			Block* p = free_[index];
+			if (p)
+			{
+				free_[index] = p->next;
+				--count_[index];
+			}
+			return p;
+		}
+
+		/**
+		 * @brief Cache the block, returns false if the size class has limit blocks already.
+		 */
+		inline bool push(std::size_t index, Block* p, std::size_t limit) noexcept
+		{
+			if (count_[index] >= limit)
+				return false;
+
+			p->next = free_[index];
+			free_[index] = p;
+			++count_[index];
+			return true;
+		}
+
+		inline std::size_t count(std::size_t index) const noexcept
+		{
+			return count_[index];
+		}
+
+		/**
+		 * @brief Free all the cached blocks.
+		 */
+		inline void clear() noexcept
+		{
+			for (std::size_t i = 0; i < ClassCount; ++i)
+			{
+				while (free_[i])
+				{
+					Disposer{}(std::exchange(free_[i], free_[i]->next));
+				}
+
+				count_[i] = 0;
+			}
+		}
+
+	protected:
+		// trivially destructible, so it is still valid while the thread locals are destroyed.
+		static inline bool& destroyed() noexcept
+		{
+			thread_local bool flag = false;
+			return flag;
+		}
+
+	protected:
+		std::array<Block*, ClassCount>      free_{};
+		std::array<std::size_t, ClassCount> count_{};
+	};
+}
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2017-2023 zhllxt
+ *
+ * author   : zhllxt
+ * email    : 37792738@qq.com
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <asio3/core/asio.hpp>
+#include <asio3/core/detail/thread_cache.hpp>
+
+namespace asio::detail
+{
+	/**
+	 * @brief A per thread cache of memory blocks for the coroutine frames of the composed
+	 * operations, the block sizes are powers of two.
+	 * The asio::recycling_allocator only caches two blocks which are not larger than 1020
+	 * bytes, but the co_composed frames are usually larger than that, so every operation
+	 * would hit the global operator new without this cache.
+	 */
+	class frame_cache
+	{
+	public:
+		static constexpr std::size_t min_block_size = 64;
+		static constexpr std::size_t max_block_size = 64 * 1024;
+
+		/// the maximum count of the cached free blocks per size class.
+		static constexpr std::size_t max_cached_blocks = 64;
+
+		static inline void* allocate(std::size_t size)
+		{
+			if (size > max_block_size)
+				return ::operator new(size);
+
+			std::size_t index = size_class(size);
+
+			if (cache_type* c = cache_type::current())
+			{
+				if (node* p = c->pop(index))
+					return p;
+			}
+
+			return ::operator new(min_block_size << index);
+		}
+
+		static inline void deallocate(void* p, std::size_t size) noexcept
+		{
+			if (size > max_block_size)
+			{
+				::operator delete(p);
+				return;
+			}
+
+			if (cache_type* c = cache_type::current(); c && c->push(size_class(size), ::new (p) node{}, max_cached_blocks))
+				return;
+
+			::operator delete(p);
+		}
+
+	protected:
+		struct node
+		{
+			node* next;
+		};
+
+		struct node_disposer
+		{
+			inline void operator()(node* p) const noexcept
+			{
+				::operator delete(p);
+			}
+		};
+
+		static constexpr std::size_t class_count =
+			std::bit_width(max_block_size) - std::bit_width(min_block_size) + 1;
+
+		using cache_type = thread_cache<node, class_count, node_disposer>;
+
+		static inline std::size_t size_class(std::size_t size) noexcept
+		{
+			return size <= min_block_size ? 0 :
+				std::bit_width(size - 1) - std::bit_width(min_block_size - 1);
+		}
+	};
+}
+
+namespace asio
+{
+	/**
+	 * @brief The allocator of the coroutine frames of the composed operations, the memory is
+	 * recycled by a per thread cache, see asio::detail::frame_cache.
+	 */
+	template<typename T>
+	class frame_allocator
+	{
+	public:
+		using value_type = T;
+
+		template<typename U>
+		struct rebind
+		{
+			using other = frame_allocator<U>;
+		};
+
+		constexpr frame_allocator() noexcept = default;
+
+		template<typename U>
+		constexpr frame_allocator(const frame_allocator<U>&) noexcept
+		{
+		}
+
+		inline T* allocate(std::size_t n)
+		{
+			static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+
+			return static_cast<T*>(detail::frame_cache::allocate(sizeof(T) * n));
+		}
+
+		inline void deallocate(T* p, std::size_t n) noexcept
+		{
+			detail::frame_cache::deallocate(p, sizeof(T) * n);
+		}
+
+		template<typename U>
+		constexpr bool operator==(const frame_allocator<U>&) const noexcept
+		{
+			return true;
+		}
+	};
+}
+
+namespace asio::detail
+{
+	/**
+	 * @brief Wrap the initiation of a composed operation, the handler is bound to the
+	 * asio::frame_allocator if the user does not supply an associated allocator, so the
+	 * coroutine frame of the operation is allocated by the per thread frame cache.
+	 */
+	template<typename Initiation>
+	class frame_allocated_initiation
+	{
+	public:
+		using executor_type = typename Initiation::executor_type;
+
+		template<typename I>
+		explicit frame_allocated_initiation(I&& init) : initiation_(std::forward<I>(init))
+		{
+		}
+
+		inline executor_type get_executor() const noexcept
+		{
+			return initiation_.get_executor();
+		}
+
+		template<typename Handler, typename... Args>
+		void operator()(Handler&& handler, Args&&... args) const &
+		{
+			invoke(initiation_, std::forward<Handler>(handler), std::forward<Args>(args)...);
+		}
+
+		template<typename Handler, typename... Args>
+		void operator()(Handler&& handler, Args&&... args) &&
+		{
+			invoke(std::move(initiation_), std::forward<Handler>(handler), std::forward<Args>(args)...);
+		}
+
+	protected:
+		template<typename I, typename Handler, typename... Args>
+		static void invoke(I&& init, Handler&& handler, Args&&... args)
+		{
+			if constexpr (std::is_same_v<
+				asio::associated_allocator_t<std::decay_t<Handler>>, std::allocator<void>>)
+			{
+				std::forward<I>(init)(
+					asio::bind_allocator(asio::frame_allocator<void>(), std::forward<Handler>(handler)),
+					std::forward<Args>(args)...);
+			}
+			else
+			{
+				std::forward<I>(init)(std::forward<Handler>(handler), std::forward<Args>(args)...);
+			}
+		}
+
+	protected:
+		Initiation initiation_;
+	};
+
+	/**
+	 * @brief Same as asio::experimental::co_composed, but the coroutine frame is allocated by
+	 * the asio::frame_allocator unless the handler has an associated allocator.
+	 */
+	template<completion_signature... Signatures, typename Implementation, typename... IoObjectsOrExecutors>
+	inline auto recycled_co_composed(Implementation&& implementation, IoObjectsOrExecutors&&... io_objects_or_executors)
+	{
+		auto initiation = asio::experimental::co_composed<Signatures...>(
+			std::forward<Implementation>(implementation),
+			std::forward<IoObjectsOrExecutors>(io_objects_or_executors)...);
+
+		return frame_allocated_initiation<decltype(initiation)>(std::move(initiation));
+	}
+
+	/**
+	 * @brief Resume the composed operation by a post to its io executor. A co_composed operation
+	 * which returns before its first suspension invokes the handler inside the initiating function,
+	 * which is forbidden by the requirements of the asynchronous operations, and a loop of such
+	 * operations grows the stack without bound, so the operations which may complete without
+	 * waiting await this first.
+	 * @eg: if (!suspended) co_await asio::detail::async_yield(state);
+	 */
+	template<typename State>
+	inline auto async_yield(State& state)
+	{
+		return asio::post(state.get_io_executor(), asio::as_tuple(asio::deferred));
+	}
+}
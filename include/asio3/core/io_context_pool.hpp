@@ -0,0 +1,383 @@
+/*
+ * Copyright (c) 2017-2023 zhllxt
+ *
+ * author   : zhllxt
+ * email    : 37792738@qq.com
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <asio3/core/asio.hpp>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(_WIN64) || \
+	defined(WINAPI_FAMILY) || defined(__CYGWIN__) || defined(__CYGWIN32__)
+#include <windows.h>
+#endif
+
+namespace asio
+{
+	/**
+	 * @brief How the io_context_pool selects a context for a new connection.
+	 */
+	enum class io_context_select
+	{
+		/// the contexts are selected in turn.
+		round_robin,
+
+		/// the context with the fewest live load guards is selected.
+		least_loaded,
+	};
+
+	struct io_context_pool_option
+	{
+		/// the number of the io_contexts, each one is running in its own thread.
+		std::size_t       concurrency = std::thread::hardware_concurrency();
+
+		/// pin the worker thread i to the cpu (cpu_offset + i) % hardware_concurrency.
+		bool              pin_threads = false;
+
+		std::size_t       cpu_offset  = 0;
+
+		io_context_select select      = io_context_select::round_robin;
+	};
+
+	/**
+	 * @brief A pool of io_contexts, one io_context per worker thread, the handlers of a
+	 * connection which is assigned to a context never run concurrently, so the connection
+	 * doesn't need a strand. It is thread safety.
+	 * @eg:
+	 * asio::io_context_pool pool({ .pin_threads = true });
+	 * asio::co_spawn(pool.get_context(0), listen(pool), asio::detached);
+	 * pool.start();
+	 * pool.wait();
+	 */
+	class io_context_pool
+	{
+	protected:
+		struct worker
+		{
+			asio::io_context         context{ 1 };
+
+			std::optional<asio::executor_work_guard<asio::io_context::executor_type>> guard{};
+
+			std::thread              thread{};
+
+			std::atomic<std::size_t> load{ 0 };
+		};
+
+	public:
+		using executor_type = asio::io_context::executor_type;
+
+		/**
+		 * @brief Counts a connection as the load of a context until it is destroyed.
+		 */
+		class load_guard
+		{
+		public:
+			load_guard() noexcept = default;
+
+			explicit load_guard(std::atomic<std::size_t>* load) noexcept : load_(load)
+			{
+				if (load_)
+					load_->fetch_add(1, std::memory_order_relaxed);
+			}
+
+			~load_guard()
+			{
+				reset();
+			}
+
+			load_guard(load_guard&& other) noexcept : load_(std::exchange(other.load_, nullptr))
+			{
+			}
+
+			load_guard& operator=(load_guard&& other) noexcept
+			{
+				if (this != std::addressof(other))
+				{
+					reset();
+					load_ = std::exchange(other.load_, nullptr);
+				}
+				return *this;
+			}
+
+			load_guard(const load_guard&) = delete;
+			load_guard& operator=(const load_guard&) = delete;
+
+			inline void reset() noexcept
+			{
+				if (load_)
+					load_->fetch_sub(1, std::memory_order_relaxed);
+				load_ = nullptr;
+			}
+
+		protected:
+			std::atomic<std::size_t>* load_ = nullptr;
+		};
+
+		explicit io_context_pool(io_context_pool_option opt = {}) : option_(std::move(opt))
+		{
+			if (this->option_.concurrency < std::size_t(1))
+				this->option_.concurrency = std::size_t(1);
+
+			this->workers_.reserve(this->option_.concurrency);
+
+			for (std::size_t i = 0; i < this->option_.concurrency; ++i)
+			{
+				this->workers_.emplace_back(std::make_unique<worker>());
+			}
+		}
+
+		/**
+		 * @brief Stop the contexts and join the worker threads. The pool must not be destroyed
+		 * in a handler of its own, the running context of that thread would be destroyed too.
+		 */
+		~io_context_pool()
+		{
+			this->stop();
+			this->wait();
+
+			for ([[maybe_unused]] auto& w : this->workers_)
+			{
+				assert(!w->thread.joinable() && "the pool is destroyed in a handler of its own");
+			}
+		}
+
+		io_context_pool(const io_context_pool&) = delete;
+		io_context_pool& operator=(const io_context_pool&) = delete;
+
+		/**
+		 * @brief Start the worker threads, the contexts keep running until stop is called.
+		 * @return false if the pool is started already.
+		 */
+		bool start()
+		{
+			std::lock_guard guard(this->mtx_);
+
+			if (this->started_)
+				return false;
+
+			this->started_ = true;
+
+			for (std::size_t i = 0; i < this->workers_.size(); ++i)
+			{
+				worker& w = *this->workers_[i];
+
+				w.guard.emplace(w.context.get_executor());
+
+				w.thread = std::thread([this, i, &w]() mutable
+				{
+					if (this->option_.pin_threads)
+						pin_current_thread(this->option_.cpu_offset + i);
+
+					w.context.run();
+				});
+			}
+
+			return true;
+		}
+
+		/**
+		 * @brief Stop all the contexts, the pending handlers are abandoned. It can be called in
+		 * a handler of the pool, e.g. the signal handler, then the threads exit asynchronously.
+		 */
+		void stop()
+		{
+			std::lock_guard guard(this->mtx_);
+
+			for (auto& w : this->workers_)
+			{
+				w->guard.reset();
+				w->context.stop();
+			}
+		}
+
+		/**
+		 * @brief Block until all the worker threads exit. Don't call it in a handler of the pool.
+		 */
+		void wait()
+		{
+			std::vector<std::thread> threads;
+
+			{
+				std::lock_guard guard(this->mtx_);
+
+				for (auto& w : this->workers_)
+				{
+					if (w->thread.joinable() && w->thread.get_id() != std::this_thread::get_id())
+						threads.emplace_back(std::move(w->thread));
+				}
+			}
+
+			for (std::thread& t : threads)
+			{
+				t.join();
+			}
+		}
+
+		/**
+		 * @brief Select a context by the selection option.
+		 */
+		inline asio::io_context& get_context() noexcept
+		{
+			return this->workers_[this->select()]->context;
+		}
+
+		inline asio::io_context& get_context(std::size_t index) noexcept
+		{
+			return this->workers_[index % this->workers_.size()]->context;
+		}
+
+		/**
+		 * @brief Select a context by the selection option, and return its executor.
+		 * @eg: auto [ec, socks] = co_await asio::async_accept_batch(acceptor, 64, [&pool] { return pool.get_executor(); });
+		 */
+		inline executor_type get_executor() noexcept
+		{
+			return this->get_context().get_executor();
+		}
+
+		inline executor_type get_executor(std::size_t index) noexcept
+		{
+			return this->get_context(index).get_executor();
+		}
+
+		/**
+		 * @brief The executors of all the contexts, e.g. for asio::async_create_sharded_acceptor.
+		 */
+		std::vector<executor_type> executors() const
+		{
+			std::vector<executor_type> exs;
+			exs.reserve(this->workers_.size());
+			for (auto& w : this->workers_)
+			{
+				exs.emplace_back(w->context.get_executor());
+			}
+			return exs;
+		}
+
+		/**
+		 * @brief Count a connection as the load of the context which the executor belongs to,
+		 * the least_loaded selection depends on it.
+		 * @eg: auto guard = pool.track(sock.get_executor());
+		 * @return An empty guard if the executor doesn't belong to the pool.
+		 */
+		template<typename Executor>
+		load_guard track(const Executor& ex) noexcept
+		{
+			asio::execution_context* ctx = std::addressof(asio::query(ex, asio::execution::context));
+
+			for (auto& w : this->workers_)
+			{
+				if (static_cast<asio::execution_context*>(std::addressof(w->context)) == ctx)
+					return load_guard(std::addressof(w->load));
+			}
+
+			return load_guard{};
+		}
+
+		/**
+		 * @brief The number of the live load guards of the context.
+		 */
+		inline std::size_t load(std::size_t index) const noexcept
+		{
+			return this->workers_[index % this->workers_.size()]->load.load(std::memory_order_relaxed);
+		}
+
+		inline std::size_t size() const noexcept
+		{
+			return this->workers_.size();
+		}
+
+		/**
+		 * @brief Determine whether current code is running in the pool's threads.
+		 */
+		inline bool running_in_threads() const noexcept
+		{
+			for (auto& w : this->workers_)
+			{
+				if (w->context.get_executor().running_in_this_thread())
+					return true;
+			}
+			return false;
+		}
+
+		/**
+		 * @brief Pin the current thread to the cpu, the cpu is wrapped by hardware_concurrency.
+		 * @return false if it is not supported or failed.
+		 */
+		static bool pin_current_thread(std::size_t cpu) noexcept
+		{
+			std::size_t cpus = (std::max)(std::thread::hardware_concurrency(), 1u);
+
+			cpu %= cpus;
+
+		#if defined(__linux__)
+			::cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(cpu, &set);
+			return ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+		#elif defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(_WIN64) || \
+			defined(WINAPI_FAMILY) || defined(__CYGWIN__) || defined(__CYGWIN32__)
+			if (cpu >= sizeof(DWORD_PTR) * 8)
+				return false;
+			return ::SetThreadAffinityMask(::GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+		#else
+			return false;
+		#endif
+		}
+
+	protected:
+		std::size_t select() noexcept
+		{
+			std::size_t n = this->workers_.size();
+			std::size_t start = this->next_.fetch_add(1, std::memory_order_relaxed) % n;
+
+			if (this->option_.select == io_context_select::round_robin)
+				return start;
+
+			// scan from the round robin position, so the contexts of the same load are used in turn.
+			std::size_t best = start;
+			std::size_t best_load = this->workers_[start]->load.load(std::memory_order_relaxed);
+
+			for (std::size_t i = 1; i < n && best_load > 0; ++i)
+			{
+				std::size_t k = (start + i) % n;
+				std::size_t l = this->workers_[k]->load.load(std::memory_order_relaxed);
+				if (l < best_load)
+				{
+					best = k;
+					best_load = l;
+				}
+			}
+
+			return best;
+		}
+
+	protected:
+		io_context_pool_option               option_;
+
+		std::vector<std::unique_ptr<worker>> workers_;
+
+		std::atomic<std::size_t>             next_{ 0 };
+
+		std::mutex                           mtx_;
+
+		bool                                 started_ = false;
+	};
+}
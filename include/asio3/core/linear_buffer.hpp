@@ -129,8 +129,9 @@ namespace asio
 			If `n` is greater than the number of bytes in the input
 			sequence, all bytes in the input sequence are removed.
 
-			@note All previous buffers sequences obtained from
-			calls to @ref data or @ref prepare are invalidated.
+			@note The memory is not touched, so the bytes of the previous
+			buffers sequences obtained from calls to @ref data are still
+			readable until the next call to @ref prepare.
 		*/
 		inline void consume(size_type n) noexcept
 		{
@@ -138,7 +139,6 @@ namespace asio
 			{
 				wpos_ = 0;
 				rpos_ = 0;
-				Container::resize(0);
 				return;
 			}
 			rpos_ += n;
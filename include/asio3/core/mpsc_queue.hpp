@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2017-2023 zhllxt
+ *
+ * author   : zhllxt
+ * email    : 37792738@qq.com
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ * referenced from Dmitry Vyukov's intrusive MPSC node-based queue:
+ * https://www.1024cores.net/home/lock-free-algorithms/queues/intrusive-mpsc-node-based-queue
+ */
+
+#pragma once
+
+#include <atomic>
+#include <new>
+#include <optional>
+
+namespace asio
+{
+	/**
+	 * @brief A lock-free multi-producer single-consumer queue.
+	 * The push function can be called by any thread at the same time, the pop and empty
+	 * function must be called by one consumer thread (or strand) only.
+	 */
+	template<class T>
+	class mpsc_queue
+	{
+	protected:
+		struct node
+		{
+			std::atomic<node*> next{ nullptr };
+			std::optional<T>   value{};
+		};
+
+	public:
+		mpsc_queue() noexcept : head_(std::addressof(stub_)), tail_(std::addressof(stub_))
+		{
+		}
+
+		~mpsc_queue()
+		{
+			while (pop().has_value());
+
+			if (tail_ != std::addressof(stub_))
+				delete tail_;
+		}
+
+		mpsc_queue(const mpsc_queue&) = delete;
+		mpsc_queue& operator=(const mpsc_queue&) = delete;
+
+		/**
+		 * @brief Push a value into the queue, it is wait-free and thread safety.
+		 */
+		template<class... Args>
+		void push(Args&&... args)
+		{
+			node* n = new node{};
+
+			n->value.emplace(std::forward<Args>(args)...);
+
+			node* prev = head_.exchange(n, std::memory_order_acq_rel);
+
+			// between the exchange and the store, the consumer sees the queue as empty.
+			prev->next.store(n, std::memory_order_release);
+		}
+
+		/**
+		 * @brief Pop a value from the queue, return std::nullopt if the queue is empty.
+		 * Only the consumer can call this function.
+		 */
+		std::optional<T> pop()
+		{
+			node* tail = tail_;
+			node* next = tail->next.load(std::memory_order_acquire);
+
+			if (next == nullptr)
+				return std::nullopt;
+
+			// the next node becomes the new dummy node.
+			std::optional<T> value = std::move(next->value);
+			next->value.reset();
+
+			tail_ = next;
+
+			if (tail != std::addressof(stub_))
+				delete tail;
+
+			return value;
+		}
+
+		/**
+		 * @brief Check whether the queue is empty. Only the consumer can call this function.
+		 */
+		bool empty() const noexcept
+		{
+			return tail_->next.load(std::memory_order_acquire) == nullptr;
+		}
+
+	protected:
+		alignas(64) std::atomic<node*> head_;
+
+		alignas(64) node*              tail_;
+
+		node                           stub_;
+	};
+}
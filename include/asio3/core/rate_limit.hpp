@@ -0,0 +1,427 @@
+/*
+ * Copyright (c) 2017-2023 zhllxt
+ *
+ * author   : zhllxt
+ * email    : 37792738@qq.com
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <asio3/core/asio.hpp>
+#include <asio3/core/frame_allocator.hpp>
+
+namespace asio
+{
+	/**
+	 * @brief A token bucket of bytes, it is lock free and thread safety, so a bucket can be
+	 * shared by many connections in different threads, e.g. a per user or a global limit.
+	 * The bucket is implemented by the generic cell rate algorithm, the whole state is one
+	 * atomic time point, and the consumption is allowed to go into debt, the debt is paid by
+	 * the later waits.
+	 * @eg: auto global = std::make_shared<asio::token_bucket>(100 * 1024 * 1024);
+	 */
+	class token_bucket
+	{
+	public:
+		using clock_type = std::chrono::steady_clock;
+
+		static constexpr std::size_t unlimited = (std::numeric_limits<std::size_t>::max)();
+
+		/**
+		 * @param rate - The bytes per second, 0 means unlimited.
+		 * @param burst - The capacity of the bucket, 0 means the bytes of 100 milliseconds.
+		 */
+		explicit token_bucket(std::uint64_t rate = 0, std::uint64_t burst = 0) noexcept
+		{
+			set_rate(rate, burst);
+		}
+
+		token_bucket(const token_bucket&) = delete;
+		token_bucket& operator=(const token_bucket&) = delete;
+
+		/**
+		 * @brief Change the rate, it can be called at any time in any thread.
+		 */
+		inline void set_rate(std::uint64_t rate, std::uint64_t burst = 0) noexcept
+		{
+			if (burst == 0)
+				burst = (std::max<std::uint64_t>)(rate / 10, 1);
+
+			burst_.store(burst, std::memory_order_relaxed);
+			rate_.store(rate, std::memory_order_release);
+		}
+
+		inline std::uint64_t rate() const noexcept { return rate_.load(std::memory_order_acquire); }
+
+		inline std::uint64_t burst() const noexcept { return burst_.load(std::memory_order_relaxed); }
+
+		/**
+		 * @brief The bytes which can be consumed now without waiting.
+		 */
+		inline std::size_t available(clock_type::time_point now = clock_type::now()) const noexcept
+		{
+			std::uint64_t rate = this->rate();
+			if (rate == 0)
+				return unlimited;
+
+			double debt = double((std::max<std::int64_t>)(tat_.load(std::memory_order_relaxed) - to_ns(now), 0));
+			double avail = double(burst()) - debt * double(rate) / 1e9;
+
+			return avail < 1.0 ? 0 : std::size_t(avail);
+		}
+
+		/**
+		 * @brief The duration to wait until n bytes are available, n is clamped to the burst.
+		 */
+		inline clock_type::duration wait_time(std::size_t n, clock_type::time_point now = clock_type::now()) const noexcept
+		{
+			std::uint64_t rate = this->rate();
+			if (rate == 0)
+				return clock_type::duration::zero();
+
+			std::uint64_t burst = this->burst();
+
+			n = std::size_t((std::min<std::uint64_t>)(n, burst));
+
+			std::int64_t debt = tat_.load(std::memory_order_relaxed) - to_ns(now);
+			std::int64_t allow = std::llround(double(burst - n) * 1e9 / double(rate));
+
+			return debt <= allow ? clock_type::duration::zero() :
+				std::chrono::duration_cast<clock_type::duration>(std::chrono::nanoseconds(debt - allow));
+		}
+
+		/**
+		 * @brief Take n bytes from the bucket, it never fails, the bucket goes into debt if
+		 * there are not enough bytes.
+		 */
+		inline void consume(std::size_t n, clock_type::time_point now = clock_type::now()) noexcept
+		{
+			std::uint64_t rate = this->rate();
+			if (rate == 0 || n == 0)
+				return;
+
+			std::int64_t cost = std::llround(double(n) * 1e9 / double(rate));
+			std::int64_t tnow = to_ns(now);
+			std::int64_t tat  = tat_.load(std::memory_order_relaxed);
+
+			while (!tat_.compare_exchange_weak(tat, (std::max)(tat, tnow) + cost, std::memory_order_relaxed))
+			{
+			}
+		}
+
+	protected:
+		static inline std::int64_t to_ns(clock_type::time_point t) noexcept
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+		}
+
+	protected:
+		std::atomic<std::uint64_t> rate_ { 0 };
+		std::atomic<std::uint64_t> burst_{ 1 };
+
+		/// the time point when the bucket is full again, in nanoseconds.
+		std::atomic<std::int64_t>  tat_  { 0 };
+	};
+
+	/**
+	 * @brief The hierarchical limit of one direction of a stream: the bucket of the connection
+	 * itself, and the shared parent buckets, e.g. the per user and the global ones. The bytes
+	 * are charged to all of them, so the strictest one decides.
+	 */
+	class rate_limit
+	{
+	public:
+		using clock_type = token_bucket::clock_type;
+
+		rate_limit() noexcept = default;
+
+		rate_limit(const rate_limit&) = delete;
+		rate_limit& operator=(const rate_limit&) = delete;
+
+		/**
+		 * @brief The bucket of the connection itself, it is unlimited by default.
+		 */
+		inline token_bucket& bucket() noexcept { return bucket_; }
+
+		/**
+		 * @brief Add a shared parent bucket.
+		 */
+		inline void add(std::shared_ptr<token_bucket> parent)
+		{
+			if (parent)
+				parents_.emplace_back(std::move(parent));
+		}
+
+		inline void clear() noexcept
+		{
+			parents_.clear();
+		}
+
+		/**
+		 * @brief The smallest burst of the limited buckets.
+		 */
+		inline std::size_t burst() const noexcept
+		{
+			std::size_t n = bucket_.rate() ? std::size_t(bucket_.burst()) : token_bucket::unlimited;
+
+			for (const auto& p : parents_)
+				n = p->rate() ? (std::min)(n, std::size_t(p->burst())) : n;
+
+			return n;
+		}
+
+		inline std::size_t available(clock_type::time_point now) const noexcept
+		{
+			std::size_t n = bucket_.available(now);
+
+			for (const auto& p : parents_)
+				n = (std::min)(n, p->available(now));
+
+			return n;
+		}
+
+		inline clock_type::duration wait_time(std::size_t n, clock_type::time_point now) const noexcept
+		{
+			clock_type::duration d = bucket_.wait_time(n, now);
+
+			for (const auto& p : parents_)
+				d = (std::max)(d, p->wait_time(n, now));
+
+			return d;
+		}
+
+		inline void consume(std::size_t n, clock_type::time_point now) noexcept
+		{
+			bucket_.consume(n, now);
+
+			for (const auto& p : parents_)
+				p->consume(n, now);
+		}
+
+	protected:
+		token_bucket                               bucket_;
+
+		std::vector<std::shared_ptr<token_bucket>> parents_;
+	};
+}
+
+namespace asio::detail
+{
+	// a prefix of at most n bytes of the buffer sequence.
+	template<typename Buffer, typename BufferSequence>
+	inline auto buffers_prefix(const BufferSequence& buffers, std::size_t n)
+	{
+		asio::detail::prepared_buffers<Buffer, 16> result;
+
+		for (auto it = asio::buffer_sequence_begin(buffers);
+			it != asio::buffer_sequence_end(buffers) && n > 0 && result.count < result.max_buffers; ++it)
+		{
+			Buffer b(*it);
+			if (b.size() == 0)
+				continue;
+			b = Buffer(b.data(), (std::min)(b.size(), n));
+			n -= b.size();
+			result.elems[result.count++] = b;
+		}
+
+		return result;
+	}
+
+	template<bool IsRead>
+	struct async_rate_limited_io_op
+	{
+		template<typename RateLimitedStream, typename BufferSequence>
+		auto operator()(auto state, std::reference_wrapper<RateLimitedStream> stream_ref, BufferSequence buffers) -> void
+		{
+			using clock_type = rate_limit::clock_type;
+			using buffer_type = std::conditional_t<IsRead, asio::mutable_buffer, asio::const_buffer>;
+
+			state.reset_cancellation_state(asio::enable_terminal_cancellation());
+
+			auto& s = stream_ref.get();
+
+			rate_limit& limit = IsRead ? s.read_limit() : s.write_limit();
+
+			asio::steady_timer& timer = IsRead ? s.read_timer_ : s.write_timer_;
+
+			std::size_t want = asio::buffer_size(buffers);
+
+			auto now = clock_type::now();
+
+			std::size_t allowed = limit.available(now);
+
+			// suspend only when the budget is exhausted, and then wait for a reasonable chunk,
+			// otherwise the refill of a few bytes per microsecond turns into tiny syscalls.
+			std::size_t required = (std::min)({ want, RateLimitedStream::min_grant, limit.burst() });
+
+			while (allowed < required)
+			{
+				timer.expires_after((std::max)(limit.wait_time(required, now), clock_type::duration(1)));
+
+				auto [ec] = co_await timer.async_wait(use_nothrow_deferred);
+				if (ec)
+					co_return{ ec, 0 };
+
+				now = clock_type::now();
+
+				allowed = limit.available(now);
+			}
+
+			asio::error_code ec{};
+			std::size_t n = 0;
+
+			if (allowed >= want)
+			{
+				if constexpr (IsRead)
+					std::tie(ec, n) = co_await s.next_layer().async_read_some(buffers, use_nothrow_deferred);
+				else
+					std::tie(ec, n) = co_await s.next_layer().async_write_some(buffers, use_nothrow_deferred);
+			}
+			else
+			{
+				auto prefix = buffers_prefix<buffer_type>(buffers, allowed);
+
+				if constexpr (IsRead)
+					std::tie(ec, n) = co_await s.next_layer().async_read_some(prefix, use_nothrow_deferred);
+				else
+					std::tie(ec, n) = co_await s.next_layer().async_write_some(prefix, use_nothrow_deferred);
+			}
+
+			limit.consume(n, clock_type::now());
+
+			co_return{ ec, n };
+		}
+	};
+}
+
+namespace asio
+{
+	/**
+	 * @brief A stream wrapper which shapes the traffic of both directions by token buckets,
+	 * it can be used with any function which takes an AsyncReadStream or an AsyncWriteStream,
+	 * e.g. asio::async_read, asio::async_write. The reads and the writes are passed through
+	 * directly while the budget is available, they are suspended only when it is exhausted.
+	 * @eg:
+	 * asio::rate_limited_stream<asio::tcp_socket> stream(std::move(sock));
+	 * stream.read_limit().bucket().set_rate(1024 * 1024);
+	 * stream.write_limit().add(user_bucket);
+	 * stream.write_limit().add(global_bucket);
+	 * auto [ec, n] = co_await asio::async_write(stream, asio::buffer(data));
+	 */
+	template<typename AsyncStream>
+	class rate_limited_stream
+	{
+		template<bool> friend struct detail::async_rate_limited_io_op;
+
+	public:
+		using next_layer_type   = std::remove_reference_t<AsyncStream>;
+		using lowest_layer_type = typename next_layer_type::lowest_layer_type;
+		using executor_type     = typename next_layer_type::executor_type;
+
+		/// a suspended read or write waits until this many bytes are available at least.
+		static constexpr std::size_t min_grant = 4096;
+
+		/**
+		 * @param args - The arguments to construct the next layer stream, AsyncStream can be
+		 *               a reference type to wrap an existing stream.
+		 */
+		template<typename... Args>
+		explicit rate_limited_stream(Args&&... args)
+			: next_layer_(std::forward<Args>(args)...)
+			, read_timer_(next_layer_.get_executor())
+			, write_timer_(next_layer_.get_executor())
+		{
+		}
+
+		rate_limited_stream(rate_limited_stream&&) = delete;
+		rate_limited_stream& operator=(rate_limited_stream&&) = delete;
+
+		inline executor_type get_executor() noexcept { return next_layer_.get_executor(); }
+
+		inline next_layer_type& next_layer() noexcept { return next_layer_; }
+
+		inline const next_layer_type& next_layer() const noexcept { return next_layer_; }
+
+		inline lowest_layer_type& lowest_layer() noexcept { return next_layer_.lowest_layer(); }
+
+		inline rate_limit& read_limit() noexcept { return read_limit_; }
+
+		inline rate_limit& write_limit() noexcept { return write_limit_; }
+
+		/**
+		 * @brief Cancel the pending operations, include the suspended ones.
+		 */
+		inline void cancel()
+		{
+			asio::error_code ec{};
+			read_timer_.cancel();
+			write_timer_.cancel();
+			next_layer_.lowest_layer().cancel(ec);
+		}
+
+		/**
+		 * @brief Start an asynchronous read, at most the available budget is read.
+		 * @param token - The completion handler to invoke when the operation completes.
+		 *	  The equivalent function signature of the handler must be:
+		 *    @code
+		 *    void handler(const asio::error_code& ec, std::size_t bytes_transferred);
+		 */
+		template<typename MutableBufferSequence,
+			ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, std::size_t)) ReadToken
+			ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(executor_type)>
+		ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(ReadToken, void(asio::error_code, std::size_t))
+		async_read_some(
+			const MutableBufferSequence& buffers,
+			ReadToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(executor_type))
+		{
+			return asio::async_initiate<ReadToken, void(asio::error_code, std::size_t)>(
+				detail::recycled_co_composed<void(asio::error_code, std::size_t)>(
+					detail::async_rate_limited_io_op<true>{}, next_layer_),
+				token, std::ref(*this), buffers);
+		}
+
+		/**
+		 * @brief Start an asynchronous write, at most the available budget is written.
+		 * @param token - The completion handler to invoke when the operation completes.
+		 *	  The equivalent function signature of the handler must be:
+		 *    @code
+		 *    void handler(const asio::error_code& ec, std::size_t bytes_transferred);
+		 */
+		template<typename ConstBufferSequence,
+			ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, std::size_t)) WriteToken
+			ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(executor_type)>
+		ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(WriteToken, void(asio::error_code, std::size_t))
+		async_write_some(
+			const ConstBufferSequence& buffers,
+			WriteToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(executor_type))
+		{
+			return asio::async_initiate<WriteToken, void(asio::error_code, std::size_t)>(
+				detail::recycled_co_composed<void(asio::error_code, std::size_t)>(
+					detail::async_rate_limited_io_op<false>{}, next_layer_),
+				token, std::ref(*this), buffers);
+		}
+
+	protected:
+		AsyncStream        next_layer_;
+
+		rate_limit         read_limit_;
+		rate_limit         write_limit_;
+
+		asio::steady_timer read_timer_;
+		asio::steady_timer write_timer_;
+	};
+}
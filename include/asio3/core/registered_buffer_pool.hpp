@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2017-2023 zhllxt
+ *
+ * author   : zhllxt
+ * email    : 37792738@qq.com
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <asio3/core/asio.hpp>
+#include <asio3/core/spin_lock.hpp>
+
+namespace asio
+{
+	class registered_buffer_pool_service;
+
+	struct registered_buffer_pool_option
+	{
+		/// The bytes of each block.
+		std::size_t block_size  = 16 * 1024;
+
+		/// The number of blocks, all the blocks are registered with the kernel at once, so the
+		/// total bytes are limited by RLIMIT_MEMLOCK on the older kernels.
+		std::size_t block_count = 256;
+	};
+
+	/**
+	 * @brief A block borrowed from the registered buffer pool, it is returned to the pool when destroyed.
+	 * The block must be destroyed before the io_context.
+	 */
+	class registered_block
+	{
+	public:
+		registered_block() noexcept = default;
+
+		registered_block(registered_buffer_pool_service* pool, std::size_t index,
+			asio::mutable_registered_buffer buffer) noexcept
+			: pool_(pool), index_(index), buffer_(buffer)
+		{
+		}
+
+		~registered_block()
+		{
+			reset();
+		}
+
+		registered_block(registered_block&& other) noexcept
+			: pool_(std::exchange(other.pool_, nullptr))
+			, index_(std::exchange(other.index_, 0))
+			, buffer_(std::exchange(other.buffer_, asio::mutable_registered_buffer{}))
+		{
+		}
+
+		registered_block& operator=(registered_block&& other) noexcept
+		{
+			if (this != std::addressof(other))
+			{
+				reset();
+
+				pool_   = std::exchange(other.pool_, nullptr);
+				index_  = std::exchange(other.index_, 0);
+				buffer_ = std::exchange(other.buffer_, asio::mutable_registered_buffer{});
+			}
+			return *this;
+		}
+
+		registered_block(const registered_block&) = delete;
+		registered_block& operator=(const registered_block&) = delete;
+
+		/**
+		 * @brief The whole block, pass it to the read or write functions of a socket.
+		 */
+		inline asio::mutable_registered_buffer buffer() const noexcept { return buffer_; }
+
+		/**
+		 * @brief The first n bytes of the block, e.g. to write the data which is read into the block.
+		 */
+		inline asio::mutable_registered_buffer buffer(std::size_t n) const noexcept { return asio::buffer(buffer_, n); }
+
+		inline char* data() const noexcept { return static_cast<char*>(buffer_.data()); }
+
+		inline std::size_t size() const noexcept { return buffer_.size(); }
+
+		inline bool empty() const noexcept { return pool_ == nullptr; }
+
+		inline explicit operator bool() const noexcept { return pool_ != nullptr; }
+
+		/**
+		 * @brief Return the block to the pool.
+		 */
+		inline void reset() noexcept;
+
+	protected:
+		registered_buffer_pool_service* pool_  = nullptr;
+		std::size_t                     index_ = 0;
+		asio::mutable_registered_buffer buffer_{};
+	};
+
+	/**
+	 * @brief A per execution context pool of the buffers which are registered with the io_context.
+	 * When asio is built with io_uring (ASIO_HAS_IO_URING), the socket reads and writes of a
+	 * registered buffer are submitted as the fixed buffer operations, which skip the per operation
+	 * page pinning, otherwise the blocks are just pooled buffers. It is thread safety.
+	 * @eg: asio::use_service<asio::registered_buffer_pool_service>(ctx).set_option({ .block_count = 1024 });
+	 */
+	class registered_buffer_pool_service : public asio::execution_context::service
+	{
+	public:
+		using key_type = registered_buffer_pool_service;
+
+		inline static asio::execution_context::id id{};
+
+		explicit registered_buffer_pool_service(asio::execution_context& ctx)
+			: asio::execution_context::service(ctx)
+		{
+		}
+
+		/**
+		 * @brief Set the pool option, it only takes effect before the first block is acquired.
+		 * @return false if the buffers are registered already.
+		 */
+		inline bool set_option(registered_buffer_pool_option opt)
+		{
+			std::lock_guard guard(this->lock_);
+
+			if (this->initialized_)
+				return false;
+
+			this->option_ = std::move(opt);
+
+			return true;
+		}
+
+		/**
+		 * @brief Borrow a block, the buffers are registered when the first block is acquired.
+		 * @return An empty block if all the blocks are in use, or the registration failed, the
+		 *         caller should fall back to a normal buffer.
+		 */
+		template<typename Executor>
+		registered_block acquire(const Executor& executor)
+		{
+			std::lock_guard guard(this->lock_);
+
+			if (!this->initialized_)
+				this->init(executor);
+
+			if (this->free_.empty() || !this->registration_)
+				return registered_block{};
+
+			std::size_t index = this->free_.back();
+			this->free_.pop_back();
+
+			return registered_block(this, index, (*this->registration_)[index]);
+		}
+
+		/**
+		 * @brief Whether the buffers are registered successfully.
+		 */
+		inline bool is_registered() const noexcept
+		{
+			std::lock_guard guard(this->lock_);
+			return this->registration_.has_value();
+		}
+
+		/**
+		 * @brief The number of the free blocks.
+		 */
+		inline std::size_t available() const noexcept
+		{
+			std::lock_guard guard(this->lock_);
+			return this->free_.size();
+		}
+
+		/**
+		 * @brief The error of the registration, e.g. the memlock limit is exceeded.
+		 */
+		inline asio::error_code registration_error() const noexcept
+		{
+			std::lock_guard guard(this->lock_);
+			return this->error_;
+		}
+
+	protected:
+		friend class registered_block;
+
+		// the io_uring service is created after this service, so it is destroyed before this
+		// service, the registration must be released before that.
+		void shutdown() override
+		{
+			std::lock_guard guard(this->lock_);
+
+			this->registration_.reset();
+		}
+
+		template<typename Executor>
+		void init(const Executor& executor)
+		{
+			this->initialized_ = true;
+
+			std::size_t block_size  = (std::max)(this->option_.block_size, std::size_t(1));
+			std::size_t block_count = this->option_.block_count;
+
+			try
+			{
+				this->arena_ = std::make_unique<char[]>(block_size * block_count);
+
+				std::vector<asio::mutable_buffer> bufs;
+				bufs.reserve(block_count);
+
+				for (std::size_t i = 0; i < block_count; ++i)
+					bufs.emplace_back(this->arena_.get() + i * block_size, block_size);
+
+				this->registration_.emplace(asio::register_buffers(executor, bufs));
+
+				this->free_.reserve(block_count);
+
+				for (std::size_t i = block_count; i > 0; --i)
+					this->free_.emplace_back(i - 1);
+			}
+			catch (const asio::system_error& e)
+			{
+				this->error_ = e.code();
+				this->registration_.reset();
+				this->arena_.reset();
+			}
+			catch (const std::bad_alloc&)
+			{
+				this->error_ = asio::error::no_memory;
+				this->registration_.reset();
+				this->arena_.reset();
+			}
+		}
+
+		void release(std::size_t index) noexcept
+		{
+			std::lock_guard guard(this->lock_);
+
+			// the capacity is reserved for all the blocks, so it never throws.
+			this->free_.emplace_back(index);
+		}
+
+	protected:
+		mutable asio::spin_lock       lock_;
+
+		registered_buffer_pool_option option_{};
+
+		bool                          initialized_ = false;
+
+		asio::error_code              error_{};
+
+		std::unique_ptr<char[]>       arena_;
+
+		std::optional<asio::buffer_registration<std::vector<asio::mutable_buffer>>> registration_;
+
+		std::vector<std::size_t>      free_;
+	};
+
+	inline void registered_block::reset() noexcept
+	{
+		if (pool_)
+			pool_->release(index_);
+
+		pool_   = nullptr;
+		index_  = 0;
+		buffer_ = asio::mutable_registered_buffer{};
+	}
+
+	/**
+	 * @brief Borrow a block from the registered buffer pool of the executor's context.
+	 * @return An empty block if no block is available.
+	 * @eg:
+	 * asio::registered_block block = asio::acquire_registered_buffer(sock.get_executor());
+	 * if (block)
+	 *     auto [ec, n] = co_await sock.async_read_some(block.buffer());
+	 */
+	template<typename Executor>
+	inline registered_block acquire_registered_buffer(const Executor& executor)
+	{
+		return asio::use_service<registered_buffer_pool_service>(
+			asio::query(executor, asio::execution::context)).acquire(executor);
+	}
+}
@@ -0,0 +1,421 @@
+/*
+ * Copyright (c) 2017-2023 zhllxt
+ *
+ * author   : zhllxt
+ * email    : 37792738@qq.com
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <asio3/core/asio.hpp>
+#include <asio3/core/strutil.hpp>
+#include <asio3/dns/resolver.hpp>
+
+namespace asio
+{
+	struct resolve_cache_option
+	{
+		/// How long a successful resolution is cached.
+		std::chrono::steady_clock::duration ttl          = std::chrono::seconds(60);
+
+		/// How long a failed resolution is cached.
+		std::chrono::steady_clock::duration negative_ttl = std::chrono::seconds(5);
+
+		/// The maximum number of cached names.
+		std::size_t                         max_entries  = 4096;
+
+		/// Use the builtin asynchronous dns stub resolver instead of the getaddrinfo thread.
+		/// The system resolver is still used when there are no name servers, the port is a
+		/// service name, or a single label name is not found (the search domains are not supported).
+		bool                                builtin_dns  = true;
+
+		/// The option of the builtin dns resolver.
+		asio::dns::option                   dns_option{};
+	};
+
+	/**
+	 * @brief A per execution context dns resolution cache, it is thread safety.
+	 * Concurrent lookups for the same name are coalesced into one resolver call.
+	 * The successful resolution is cached for the minimum of the record ttl and the option ttl.
+	 * @eg: asio::use_service<asio::resolve_cache_service>(ctx).set_option({ .ttl = std::chrono::minutes(5) });
+	 */
+	class resolve_cache_service : public asio::execution_context::service
+	{
+	public:
+		using key_type      = resolve_cache_service;
+		using results_type  = asio::ip::tcp::resolver::results_type;
+		using handler_type  = asio::any_completion_handler<void(asio::error_code, results_type)>;
+		using clock_type    = std::chrono::steady_clock;
+
+		inline static asio::execution_context::id id{};
+
+		explicit resolve_cache_service(asio::execution_context& ctx) : asio::execution_context::service(ctx)
+		{
+		}
+
+		/**
+		 * @brief Set the cache option.
+		 */
+		inline void set_option(resolve_cache_option opt)
+		{
+			std::shared_ptr<asio::dns::resolver> dns;
+
+			std::lock_guard guard(this->mtx_);
+
+			this->option_ = std::move(opt);
+
+			// the dns option maybe changed, recreate the resolver when next resolving, the old one
+			// is kept alive by the outstanding resolutions which are using it.
+			dns.swap(this->dns_);
+		}
+
+		/**
+		 * @brief Remove all the cached names which are not resolving.
+		 */
+		inline void clear()
+		{
+			std::lock_guard guard(this->mtx_);
+
+			std::erase_if(this->entries_, [](auto& pair) { return !pair.second.resolving; });
+		}
+
+		/**
+		 * @brief Resolve the host and port, the handler is always invoked by the executor.
+		 * A waiting handler supports the cancellation of all types, it is completed with
+		 * asio::error::operation_aborted, and the shared resolution keeps going for the others.
+		 */
+		void async_resolve(asio::any_io_executor executor, std::string host, std::string port, handler_type handler)
+		{
+			// ip literal, no need to resolve.
+			if (results_type results; make_numeric_results(host, port, results))
+			{
+				asio::post(executor, asio::append(std::move(handler), asio::error_code{}, std::move(results)));
+				return;
+			}
+
+			std::string key = host;
+			key += '\0';
+			key += port;
+
+			std::unique_lock guard(this->mtx_);
+
+			auto now = clock_type::now();
+
+			auto it = this->entries_.find(key);
+			if (it != this->entries_.end())
+			{
+				entry& e = it->second;
+
+				if (e.resolving)
+				{
+					this->add_waiter(key, e, std::move(executor), std::move(handler));
+					return;
+				}
+
+				if (e.expiry > now)
+				{
+					asio::error_code ec = e.ec;
+					results_type results = e.results;
+
+					guard.unlock();
+
+					asio::post(executor, asio::append(std::move(handler), ec, std::move(results)));
+					return;
+				}
+			}
+			else
+			{
+				if (this->entries_.size() >= this->option_.max_entries)
+					this->evict(now);
+
+				it = this->entries_.emplace(key, entry{}).first;
+			}
+
+			entry& e = it->second;
+
+			e.resolving = true;
+
+			this->add_waiter(key, e, executor, std::move(handler));
+
+			if (!this->option_.builtin_dns)
+			{
+				guard.unlock();
+
+				this->system_resolve(std::move(executor), std::move(host), std::move(port), std::move(key));
+				return;
+			}
+
+			if (!this->dns_)
+				this->dns_ = std::make_shared<asio::dns::resolver>(executor, this->option_.dns_option);
+
+			std::shared_ptr<asio::dns::resolver> dns = this->dns_;
+
+			guard.unlock();
+
+			// the resolver is captured, so it is alive until the resolution is finished.
+			dns->async_resolve(host, port,
+			[this, dns, executor = std::move(executor), host, port, key = std::move(key)]
+			(const asio::error_code& ec, results_type results, std::uint32_t ttl) mutable
+			{
+				if (ec == asio::dns::error::no_name_servers || ec == asio::error::service_not_found ||
+					(ec && host.find('.') == std::string::npos))
+				{
+					this->system_resolve(std::move(executor), std::move(host), std::move(port), std::move(key));
+				}
+				else
+				{
+					this->complete(key, ec, std::move(results), std::chrono::seconds(ttl));
+				}
+			});
+		}
+
+	protected:
+		struct waiter
+		{
+			asio::any_io_executor executor;
+			handler_type          handler;
+			std::uint64_t         id = 0;
+		};
+
+		struct entry
+		{
+			results_type          results{};
+			asio::error_code      ec{};
+			clock_type::time_point expiry{};
+			bool                  resolving = false;
+			std::vector<waiter>   waiters{};
+		};
+
+		/**
+		 * @brief Queue the handler of a resolving name, a cancellation of the handler completes it
+		 * with asio::error::operation_aborted, the resolution is not affected by it.
+		 * The mutex must be held by the caller.
+		 */
+		void add_waiter(const std::string& key, entry& e, asio::any_io_executor executor, handler_type handler)
+		{
+			waiter& w = e.waiters.emplace_back(waiter{ std::move(executor), std::move(handler), ++this->waiter_id_ });
+
+			if (asio::cancellation_slot slot = w.handler.get_cancellation_slot(); slot.is_connected())
+			{
+				slot.assign([this, key, id = w.id](asio::cancellation_type_t type) mutable
+				{
+					if (type != asio::cancellation_type::none)
+						this->cancel_waiter(key, id);
+				});
+			}
+		}
+
+		void cancel_waiter(const std::string& key, std::uint64_t id)
+		{
+			std::optional<waiter> w;
+
+			{
+				std::lock_guard guard(this->mtx_);
+
+				auto it = this->entries_.find(key);
+				if (it == this->entries_.end())
+					return;
+
+				std::vector<waiter>& waiters = it->second.waiters;
+
+				auto iter = std::find_if(waiters.begin(), waiters.end(), [id](const waiter& x) { return x.id == id; });
+				if (iter == waiters.end())
+					return;
+
+				w.emplace(std::move(*iter));
+
+				waiters.erase(iter);
+			}
+
+			post_completion(std::move(*w), asio::error::operation_aborted, results_type{});
+		}
+
+		/// the cancellation handler is removed from the slot before the handler is invoked, it is done
+		/// in the executor of the handler, where the cancellation is emitted too. The wrapper is bound
+		/// to the associated executor and allocator of the handler, like the append of the cache hit.
+		static void post_completion(waiter w, const asio::error_code& ec, results_type results)
+		{
+			auto executor  = asio::get_associated_executor(w.handler, w.executor);
+			auto allocator = asio::get_associated_allocator(w.handler);
+
+			asio::post(w.executor, asio::bind_executor(std::move(executor), asio::bind_allocator(std::move(allocator),
+			[handler = std::move(w.handler), ec, results = std::move(results)]() mutable
+			{
+				if (asio::cancellation_slot slot = handler.get_cancellation_slot(); slot.is_connected())
+					slot.clear();
+
+				std::move(handler)(ec, std::move(results));
+			})));
+		}
+
+		void shutdown() override
+		{
+			std::vector<waiter> waiters;
+
+			{
+				std::lock_guard guard(this->mtx_);
+
+				for (auto& [key, e] : this->entries_)
+				{
+					for (waiter& w : e.waiters)
+						waiters.emplace_back(std::move(w));
+				}
+
+				this->entries_.clear();
+
+				this->dns_.reset();
+			}
+
+			// destroy the handlers outside the lock.
+			waiters.clear();
+		}
+
+		void system_resolve(asio::any_io_executor executor, std::string host, std::string port, std::string key)
+		{
+			auto resolver = std::make_shared<asio::ip::tcp::resolver>(executor);
+
+			resolver->async_resolve(host, port,
+			[this, key = std::move(key), resolver](const asio::error_code& ec, results_type results) mutable
+			{
+				this->complete(key, ec, std::move(results));
+			});
+		}
+
+		void complete(const std::string& key, const asio::error_code& ec, results_type results,
+			std::optional<clock_type::duration> record_ttl = std::nullopt)
+		{
+			std::vector<waiter> waiters;
+
+			{
+				std::lock_guard guard(this->mtx_);
+
+				auto it = this->entries_.find(key);
+				if (it == this->entries_.end())
+					return;
+
+				entry& e = it->second;
+
+				bool failed = (ec || results.empty());
+
+				e.resolving = false;
+				e.ec        = ec;
+				e.results   = results;
+				e.expiry    = clock_type::now() + (failed ? this->option_.negative_ttl :
+					(record_ttl ? (std::min)(*record_ttl, this->option_.ttl) : this->option_.ttl));
+
+				waiters.swap(e.waiters);
+			}
+
+			for (waiter& w : waiters)
+			{
+				post_completion(std::move(w), ec, results);
+			}
+		}
+
+		void evict(clock_type::time_point now)
+		{
+			std::erase_if(this->entries_, [now](auto& pair)
+			{
+				return !pair.second.resolving && pair.second.expiry <= now;
+			});
+
+			for (auto it = this->entries_.begin();
+				it != this->entries_.end() && this->entries_.size() >= this->option_.max_entries;)
+			{
+				if (it->second.resolving)
+					++it;
+				else
+					it = this->entries_.erase(it);
+			}
+		}
+
+		static bool make_numeric_results(const std::string& host, const std::string& port, results_type& results)
+		{
+			asio::error_code ec{};
+
+			asio::ip::address addr = asio::ip::make_address(host, ec);
+			if (ec)
+				return false;
+
+			std::uint16_t uport{};
+
+			auto [ptr, err] = std::from_chars(port.data(), port.data() + port.size(), uport);
+			if (err != std::errc{} || ptr != port.data() + port.size())
+				return false;
+
+			results = results_type::create(asio::ip::tcp::endpoint(addr, uport), host, port);
+
+			return true;
+		}
+
+	protected:
+		std::mutex                             mtx_;
+
+		resolve_cache_option                   option_{};
+
+		std::unordered_map<std::string, entry> entries_;
+
+		std::shared_ptr<asio::dns::resolver>   dns_;
+
+		std::uint64_t                          waiter_id_ = 0;
+	};
+}
+
+namespace asio::detail
+{
+	struct async_cached_resolve_initiation
+	{
+		template<typename Handler>
+		inline void operator()(Handler&& handler,
+			asio::any_io_executor executor, std::string host, std::string port) const
+		{
+			asio::resolve_cache_service& svc = asio::use_service<asio::resolve_cache_service>(
+				asio::query(executor, asio::execution::context));
+
+			svc.async_resolve(std::move(executor), std::move(host), std::move(port),
+				asio::resolve_cache_service::handler_type(std::forward<Handler>(handler)));
+		}
+	};
+}
+
+namespace asio
+{
+	/**
+	 * @brief Resolve the host and port asynchronously through the resolve cache of the executor's context.
+	 * @param executor - The executor.
+	 * @param host - The host name or ip.
+	 * @param port - The port or service name.
+	 * @param token - The completion handler to invoke when the operation completes.
+	 *	  The equivalent function signature of the handler must be:
+     *    @code
+     *    void handler(const asio::error_code& ec, asio::ip::tcp::resolver::results_type results);
+	 */
+	template<typename Executor, typename String, typename StrOrInt,
+		ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, asio::ip::tcp::resolver::results_type)) ResolveToken
+		ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(std::remove_cvref_t<Executor>)>
+	requires
+		(std::constructible_from<std::string, String> &&
+		(std::constructible_from<std::string, StrOrInt> || std::integral<std::remove_cvref_t<StrOrInt>>))
+	ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(ResolveToken, void(asio::error_code, asio::ip::tcp::resolver::results_type))
+	async_cached_resolve(
+		Executor&& executor, String&& host, StrOrInt&& port,
+		ResolveToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(std::remove_cvref_t<Executor>))
+	{
+		return asio::async_initiate<ResolveToken, void(asio::error_code, asio::ip::tcp::resolver::results_type)>(
+			detail::async_cached_resolve_initiation{}, token, asio::any_io_executor(executor),
+			asio::to_string(std::forward<String>(host)), asio::to_string(std::forward<StrOrInt>(port)));
+	}
+}
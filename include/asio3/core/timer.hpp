@@ -11,7 +11,9 @@
 #pragma once
 
 #include <asio3/core/asio.hpp>
+#include <asio3/core/frame_allocator.hpp>
 #include <asio3/core/detail/type_traits.hpp>
+#include <asio3/core/timing_wheel.hpp>
 
 namespace asio
 {
@@ -64,7 +66,7 @@ namespace asio
 		SleepToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(typename asio::timer::executor_type))
 	{
 		return asio::async_initiate<SleepToken, void(asio::error_code)>(
-			asio::experimental::co_composed<void(asio::error_code)>(
+			asio::detail::recycled_co_composed<void(asio::error_code)>(
 				detail::async_sleep_op{}, executor),
 			token, executor, duration);
 	}
@@ -86,14 +88,14 @@ namespace asio
 
 	/**
 	 * @brief Asynchronously wait a timeout for the duration.
+	 * The timeout is driven by the timing wheel of the context, see asio::timing_wheel_service,
+	 * so it is rounded up to the tick of the wheel.
 	 * @param duration - The duration. 
 	 */
 	asio::awaitable<std::tuple<asio::error_code, detail::timer_tag_t>> timeout(
 		std::chrono::steady_clock::duration duration)
 	{
-		asio::steady_timer t(co_await asio::this_coro::executor);
-
-		t.expires_after(duration);
+		asio::deadline t(co_await asio::this_coro::executor, duration);
 
 		auto [ec] = co_await t.async_wait(use_nothrow_awaitable);
 
@@ -0,0 +1,673 @@
+/*
+ * Copyright (c) 2017-2023 zhllxt
+ *
+ * author   : zhllxt
+ * email    : 37792738@qq.com
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <asio3/core/asio.hpp>
+#include <asio3/core/spin_lock.hpp>
+
+namespace asio
+{
+	class timing_wheel_service;
+}
+
+namespace asio::detail
+{
+	struct timing_wheel_link
+	{
+		timing_wheel_link* prev = this;
+		timing_wheel_link* next = this;
+
+		inline bool linked() const noexcept { return next != this; }
+
+		inline void unlink() noexcept
+		{
+			prev->next = next;
+			next->prev = prev;
+			prev = next = this;
+		}
+
+		inline void link_before(timing_wheel_link* pos) noexcept
+		{
+			prev = pos->prev;
+			next = pos;
+			pos->prev->next = this;
+			pos->prev = this;
+		}
+	};
+
+	struct timing_wheel_entry : timing_wheel_link
+	{
+		std::chrono::steady_clock::time_point expiry = (std::chrono::steady_clock::time_point::max)();
+
+		std::uint64_t tick = 0;
+
+		/// linked in the wheel, otherwise it is linked in the idle list when it has a waiter.
+		bool armed = false;
+
+		bool expired = false;
+
+		asio::any_completion_handler<void(asio::error_code)> handler{};
+
+		asio::any_io_executor work{};
+
+		asio::cancellation_slot slot{};
+	};
+
+	struct timing_wheel_completion
+	{
+		asio::any_completion_handler<void(asio::error_code)> handler;
+		asio::any_io_executor work;
+		asio::error_code ec;
+	};
+}
+
+namespace asio
+{
+	/**
+	 * @brief A hierarchical timing wheel per execution context, which is the backend of asio::deadline.
+	 * Arming, re-arming and cancelling a deadline are O(1), and the context is woken up at most once
+	 * per tick no matter how many deadlines are armed, so it is suitable for a large number of idle
+	 * timeouts. The deadlines are rounded up to the tick, they never expire early.
+	 * @eg: asio::use_service<asio::timing_wheel_service>(ctx).set_tick(std::chrono::milliseconds(100));
+	 */
+	class timing_wheel_service : public asio::execution_context::service
+	{
+	public:
+		using key_type    = timing_wheel_service;
+		using clock_type  = std::chrono::steady_clock;
+		using duration    = clock_type::duration;
+		using time_point  = clock_type::time_point;
+
+		inline static asio::execution_context::id id{};
+
+		static constexpr duration default_tick = std::chrono::milliseconds(10);
+
+		explicit timing_wheel_service(asio::execution_context& ctx)
+			: asio::execution_context::service(ctx)
+		{
+		}
+
+		/**
+		 * @brief Set the tick, it only takes effect before the first deadline is armed.
+		 * @return false if the wheel is in use already.
+		 */
+		inline bool set_tick(duration tick)
+		{
+			std::lock_guard guard(this->lock_);
+
+			if (this->timer_ || tick <= duration::zero())
+				return false;
+
+			this->tick_ = tick;
+
+			return true;
+		}
+
+		inline duration tick() const noexcept
+		{
+			std::lock_guard guard(this->lock_);
+			return this->tick_;
+		}
+
+		/**
+		 * @brief The number of the armed deadlines.
+		 */
+		inline std::size_t size() const noexcept
+		{
+			std::lock_guard guard(this->lock_);
+			return this->count_;
+		}
+
+	protected:
+		friend class deadline;
+
+		static constexpr std::size_t root_bits   = 8;
+		static constexpr std::size_t root_size   = std::size_t(1) << root_bits;
+		static constexpr std::size_t level_bits  = 6;
+		static constexpr std::size_t level_size  = std::size_t(1) << level_bits;
+		static constexpr std::size_t level_count = 3;
+
+		/// the ticks which the wheel can hold, the farther deadlines are re-inserted when cascaded.
+		static constexpr std::uint64_t max_ticks =
+			std::uint64_t(1) << (root_bits + level_bits * level_count);
+
+		void shutdown() override
+		{
+			std::vector<detail::timing_wheel_completion> dropped;
+
+			{
+				std::lock_guard guard(this->lock_);
+
+				this->shutdown_ = true;
+
+				this->timer_.reset();
+
+				auto drop = [&dropped](detail::timing_wheel_link& head)
+				{
+					while (head.linked())
+					{
+						auto* e = static_cast<detail::timing_wheel_entry*>(head.next);
+						e->unlink();
+						e->armed = false;
+						e->slot.clear();
+						if (e->handler)
+							dropped.push_back({ std::move(e->handler), std::move(e->work), {} });
+					}
+				};
+
+				for (auto& head : this->root_)
+					drop(head);
+
+				for (auto& level : this->levels_)
+					for (auto& head : level)
+						drop(head);
+
+				drop(this->idle_);
+
+				this->count_ = 0;
+			}
+
+			// destroying the handlers may destroy the deadlines, so it must be done without the lock.
+			dropped.clear();
+		}
+
+		void arm(detail::timing_wheel_entry& e, time_point expiry, const asio::any_io_executor& ex)
+		{
+			{
+				std::lock_guard guard(this->lock_);
+
+				this->remove(e);
+
+				e.expiry = expiry;
+				e.expired = false;
+
+				if (expiry == (time_point::max)() || this->shutdown_)
+				{
+					if (e.handler)
+						e.link_before(&this->idle_);
+					return;
+				}
+
+				if (!this->timer_)
+				{
+					this->origin_ = clock_type::now();
+					this->timer_.emplace(ex);
+				}
+
+				// nothing is in the wheel, so the wheel can jump to now without cascading.
+				if (this->count_ == 0)
+					this->current_ = (std::max)(this->current_, this->now_tick());
+
+				e.tick = this->ceil_tick(expiry);
+				e.armed = true;
+
+				this->insert(e);
+
+				++this->count_;
+
+				this->schedule();
+			}
+		}
+
+		void cancel(detail::timing_wheel_entry& e)
+		{
+			std::vector<detail::timing_wheel_completion> done;
+
+			{
+				std::lock_guard guard(this->lock_);
+
+				this->remove(e);
+
+				e.expiry = (time_point::max)();
+				e.expired = false;
+
+				this->take(e, asio::error::operation_aborted, done);
+
+				// don't keep the context running when nothing is armed.
+				if (this->count_ == 0 && this->timer_running_)
+				{
+					this->timer_running_ = false;
+					this->timer_->cancel();
+				}
+			}
+
+			complete(done);
+		}
+
+		template<typename Handler>
+		void wait(detail::timing_wheel_entry& e, Handler&& handler, const asio::any_io_executor& ex);
+
+		void cancel_wait(detail::timing_wheel_entry& e)
+		{
+			std::vector<detail::timing_wheel_completion> done;
+
+			{
+				std::lock_guard guard(this->lock_);
+
+				if (!e.handler)
+					return;
+
+				// the cancellation handler is running now, so the slot must not be cleared here.
+				e.slot = asio::cancellation_slot{};
+
+				done.push_back({ std::move(e.handler), std::move(e.work), asio::error::operation_aborted });
+
+				if (!e.armed)
+					e.unlink();
+			}
+
+			complete(done);
+		}
+
+		// remove the entry from the wheel, but keep the waiter.
+		inline void remove(detail::timing_wheel_entry& e) noexcept
+		{
+			if (e.armed)
+				--this->count_;
+
+			e.unlink();
+			e.armed = false;
+		}
+
+		// take the waiter of the entry, the entry is unlinked if it isn't armed.
+		inline void take(detail::timing_wheel_entry& e, asio::error_code ec,
+			std::vector<detail::timing_wheel_completion>& done)
+		{
+			if (!e.handler)
+				return;
+
+			e.slot.clear();
+
+			done.push_back({ std::move(e.handler), std::move(e.work), ec });
+
+			if (!e.armed)
+				e.unlink();
+		}
+
+		inline std::uint64_t now_tick() const noexcept
+		{
+			auto d = clock_type::now() - this->origin_;
+			return d <= duration::zero() ? 0 : std::uint64_t(d / this->tick_);
+		}
+
+		inline std::uint64_t ceil_tick(time_point tp) const noexcept
+		{
+			if (tp <= this->origin_)
+				return 0;
+
+			auto d = (tp - this->origin_).count();
+			auto t = this->tick_.count();
+
+			if (d > (std::numeric_limits<duration::rep>::max)() - t)
+				return (std::numeric_limits<std::uint64_t>::max)() / 2;
+
+			return std::uint64_t((d + t - 1) / t);
+		}
+
+		void insert(detail::timing_wheel_entry& e) noexcept
+		{
+			std::uint64_t t = (std::max)(e.tick, this->current_);
+			std::uint64_t d = t - this->current_;
+
+			if (d < root_size)
+			{
+				e.link_before(&this->root_[t & (root_size - 1)]);
+				return;
+			}
+
+			if (d >= max_ticks)
+				t = this->current_ + max_ticks - 1;
+
+			for (std::size_t i = 0; i < level_count; ++i)
+			{
+				std::size_t shift = root_bits + level_bits * (i + 1);
+
+				if (i + 1 == level_count || d < (std::uint64_t(1) << shift))
+				{
+					e.link_before(&this->levels_[i][(t >> (shift - level_bits)) & (level_size - 1)]);
+					return;
+				}
+			}
+		}
+
+		void cascade(detail::timing_wheel_link& head) noexcept
+		{
+			detail::timing_wheel_link list;
+
+			if (!head.linked())
+				return;
+
+			// move the whole slot to a temporary list, then insert them into the lower levels.
+			list.next = head.next;
+			list.prev = head.prev;
+			list.next->prev = &list;
+			list.prev->next = &list;
+			head.prev = head.next = &head;
+
+			while (list.linked())
+			{
+				auto* e = static_cast<detail::timing_wheel_entry*>(list.next);
+				e->unlink();
+				this->insert(*e);
+			}
+		}
+
+		void advance(std::uint64_t target, std::vector<detail::timing_wheel_completion>& done)
+		{
+			while (this->current_ <= target && this->count_ > 0)
+			{
+				std::size_t index = std::size_t(this->current_ & (root_size - 1));
+
+				if (index == 0)
+				{
+					for (std::size_t i = 0; i < level_count; ++i)
+					{
+						std::size_t k = std::size_t(
+							(this->current_ >> (root_bits + level_bits * i)) & (level_size - 1));
+
+						this->cascade(this->levels_[i][k]);
+
+						if (k != 0)
+							break;
+					}
+				}
+
+				detail::timing_wheel_link& head = this->root_[index];
+
+				while (head.linked())
+				{
+					auto* e = static_cast<detail::timing_wheel_entry*>(head.next);
+
+					this->remove(*e);
+
+					e->expired = true;
+
+					this->take(*e, asio::error_code{}, done);
+				}
+
+				++this->current_;
+			}
+
+			if (this->count_ == 0)
+				this->current_ = (std::max)(this->current_, target + 1);
+		}
+
+		void schedule()
+		{
+			if (this->count_ == 0 || this->shutdown_ || !this->timer_)
+				return;
+
+			// wake up at the next non empty slot, or the next cascade, whichever comes first.
+			std::uint64_t next = this->current_;
+			std::uint64_t end  = (this->current_ | (root_size - 1)) + 1;
+
+			while (next < end && !this->root_[next & (root_size - 1)].linked())
+				++next;
+
+			time_point wake = this->origin_ + this->tick_ * next;
+
+			if (this->timer_running_ && wake >= this->wake_)
+				return;
+
+			this->wake_ = wake;
+			this->timer_running_ = true;
+
+			this->timer_->expires_at(wake);
+			this->timer_->async_wait([this](const asio::error_code& ec)
+			{
+				this->on_timer(ec);
+			});
+		}
+
+		void on_timer(const asio::error_code& ec)
+		{
+			// the timer is rescheduled to an earlier time, or the service is shutdown.
+			if (ec == asio::error::operation_aborted)
+				return;
+
+			std::vector<detail::timing_wheel_completion> done;
+
+			{
+				std::lock_guard guard(this->lock_);
+
+				if (this->shutdown_)
+					return;
+
+				this->timer_running_ = false;
+
+				this->advance(this->now_tick(), done);
+
+				this->schedule();
+			}
+
+			complete(done);
+		}
+
+		static void complete(std::vector<detail::timing_wheel_completion>& done)
+		{
+			for (auto& c : done)
+			{
+				asio::any_io_executor work = std::move(c.work);
+				asio::post(work, asio::append(std::move(c.handler), c.ec));
+			}
+		}
+
+	protected:
+		mutable asio::spin_lock                   lock_;
+
+		duration                                  tick_ = default_tick;
+
+		time_point                                origin_{};
+
+		std::uint64_t                             current_ = 0;
+
+		std::size_t                               count_ = 0;
+
+		bool                                      shutdown_ = false;
+
+		bool                                      timer_running_ = false;
+
+		time_point                                wake_{};
+
+		std::optional<asio::steady_timer>         timer_;
+
+		detail::timing_wheel_link                 root_[root_size];
+
+		detail::timing_wheel_link                 levels_[level_count][level_size];
+
+		/// the entries which have a waiter but are not armed.
+		detail::timing_wheel_link                 idle_;
+	};
+
+	template<typename Handler>
+	void timing_wheel_service::wait(detail::timing_wheel_entry& e, Handler&& handler, const asio::any_io_executor& ex)
+	{
+		struct cancel_handler
+		{
+			timing_wheel_service* service;
+			detail::timing_wheel_entry* entry;
+
+			void operator()(asio::cancellation_type_t type)
+			{
+				if (!!(type & (asio::cancellation_type::terminal |
+					asio::cancellation_type::partial | asio::cancellation_type::total)))
+				{
+					service->cancel_wait(*entry);
+				}
+			}
+		};
+
+		asio::cancellation_slot slot = asio::get_associated_cancellation_slot(handler);
+
+		std::vector<detail::timing_wheel_completion> done;
+
+		detail::timing_wheel_completion self{ std::forward<Handler>(handler),
+			asio::prefer(ex, asio::execution::outstanding_work.tracked), {} };
+
+		{
+			std::lock_guard guard(this->lock_);
+
+			// the handler is destroyed after the lock is released.
+			if (this->shutdown_)
+				return;
+
+			// only one waiter is supported, the previous one is aborted.
+			this->take(e, asio::error::operation_aborted, done);
+
+			if (e.expired)
+			{
+				self.ec = asio::error_code{};
+				done.push_back(std::move(self));
+			}
+			else
+			{
+				e.handler = std::move(self.handler);
+				e.work = std::move(self.work);
+
+				if (!e.armed)
+					e.link_before(&this->idle_);
+
+				if (slot.is_connected())
+				{
+					e.slot = slot;
+					slot.template emplace<cancel_handler>(this, std::addressof(e));
+				}
+			}
+		}
+
+		complete(done);
+	}
+
+	/**
+	 * @brief A cheap timer which is driven by the timing wheel of the execution context, it is
+	 * designed for the idle timeouts which are re-armed frequently. Unlike asio::steady_timer,
+	 * re-arming a deadline doesn't abort the pending wait, the wait just completes at the new
+	 * expiry, so a watchdog can wait once while the io operations keep refreshing the deadline.
+	 * The deadline must be destroyed before the execution context.
+	 * @eg:
+	 * asio::deadline deadline(sock.get_executor());
+	 * deadline.expires_after(std::chrono::minutes(10));
+	 * co_await (transfer(sock, deadline) || deadline.async_wait());
+	 */
+	class deadline
+	{
+	public:
+		using clock_type    = std::chrono::steady_clock;
+		using duration      = clock_type::duration;
+		using time_point    = clock_type::time_point;
+		using executor_type = asio::as_tuple_t<asio::deferred_t>::executor_with_default<asio::any_io_executor>;
+
+		template<typename Executor>
+		explicit deadline(const Executor& ex)
+			: executor_(ex)
+			, service_(std::addressof(asio::use_service<timing_wheel_service>(
+				asio::query(ex, asio::execution::context))))
+		{
+		}
+
+		template<typename Executor>
+		explicit deadline(const Executor& ex, duration expiry_time) : deadline(ex)
+		{
+			this->expires_after(expiry_time);
+		}
+
+		~deadline()
+		{
+			this->service_->cancel(this->entry_);
+		}
+
+		deadline(const deadline&) = delete;
+		deadline& operator=(const deadline&) = delete;
+
+		inline executor_type get_executor() const noexcept
+		{
+			return this->executor_;
+		}
+
+		/**
+		 * @brief Set the expiry time, the pending wait is kept. time_point::max() disarms the deadline.
+		 */
+		inline void expires_at(time_point expiry_time)
+		{
+			this->service_->arm(this->entry_, expiry_time, this->executor_);
+		}
+
+		/**
+		 * @brief Set the expiry time relative to now, the pending wait is kept.
+		 */
+		inline void expires_after(duration expiry_time)
+		{
+			this->expires_at(clock_type::now() + expiry_time);
+		}
+
+		/**
+		 * @brief Disarm the deadline, the pending wait completes with asio::error::operation_aborted.
+		 */
+		inline void cancel()
+		{
+			this->service_->cancel(this->entry_);
+		}
+
+		/**
+		 * @brief Get the expiry time, it is time_point::max() if the deadline is not armed.
+		 */
+		inline time_point expiry() const noexcept
+		{
+			std::lock_guard guard(this->service_->lock_);
+			return this->entry_.expiry;
+		}
+
+		/**
+		 * @brief Whether the deadline is expired and is not re-armed since.
+		 */
+		inline bool expired() const noexcept
+		{
+			std::lock_guard guard(this->service_->lock_);
+			return this->entry_.expired;
+		}
+
+		/**
+		 * @brief Wait until the deadline expires, only one wait can be pending, a new wait aborts
+		 * the previous one. It completes immediately if the deadline is expired already.
+		 * @param token - The completion handler to invoke when the operation completes.
+		 *	  The equivalent function signature of the handler must be:
+	     *    @code
+	     *    void handler(const asio::error_code& ec);
+		 */
+		template<
+			ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code)) WaitToken
+			ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(executor_type)>
+		ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(WaitToken, void(asio::error_code))
+		async_wait(WaitToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(executor_type))
+		{
+			return asio::async_initiate<WaitToken, void(asio::error_code)>(
+				[this](auto handler) mutable
+				{
+					this->service_->wait(this->entry_, std::move(handler), this->executor_);
+				}, token);
+		}
+
+	protected:
+		asio::any_io_executor       executor_;
+
+		timing_wheel_service*       service_;
+
+		detail::timing_wheel_entry  entry_;
+	};
+}
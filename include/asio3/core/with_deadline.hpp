@@ -0,0 +1,363 @@
+/*
+ * Copyright (c) 2017-2023 zhllxt
+ *
+ * author   : zhllxt
+ * email    : 37792738@qq.com
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <asio3/core/asio.hpp>
+#include <asio3/core/detail/type_traits.hpp>
+#include <asio3/core/timing_wheel.hpp>
+
+namespace asio
+{
+	/**
+	 * @brief A completion token adapter which cancels the operation when the deadline expires,
+	 * see asio::with_deadline.
+	 */
+	template<typename CompletionToken>
+	struct with_deadline_t
+	{
+		CompletionToken                       token_;
+
+		std::chrono::steady_clock::time_point expiry_;
+
+		asio::cancellation_type_t             cancel_type_ = asio::cancellation_type::terminal;
+	};
+}
+
+namespace asio::detail
+{
+	template<typename Handler>
+	struct with_deadline_state;
+
+	template<typename Handler>
+	using with_deadline_allocator_t = typename std::allocator_traits<
+		asio::associated_allocator_t<Handler, asio::recycling_allocator<void>>>::template
+		rebind_alloc<with_deadline_state<Handler>>;
+
+	template<typename Handler>
+	struct with_deadline_state
+	{
+		template<typename H, typename Executor>
+		with_deadline_state(H&& h, const Executor& ex, const with_deadline_allocator_t<Handler>& a)
+			: handler(std::forward<H>(h)), alloc(a), timer(ex)
+		{
+		}
+
+		Handler                   handler;
+
+		/// the handler may be moved out when the state is released, so keep a copy of its allocator.
+		with_deadline_allocator_t<Handler> alloc;
+
+		asio::deadline            timer;
+
+		asio::cancellation_signal signal{};
+
+		asio::cancellation_type_t cancel_type = asio::cancellation_type::terminal;
+
+		/// the operation and the timer wait both hold a reference, they are released in the same
+		/// executor, but the count is atomic anyway, so a misuse can't free the state twice.
+		std::atomic<int>          refs{ 2 };
+
+		std::atomic<bool>         timed_out{ false };
+
+		std::atomic<bool>         done{ false };
+	};
+
+	template<typename Handler>
+	inline void with_deadline_release(with_deadline_state<Handler>* s)
+	{
+		if (s->refs.fetch_sub(1, std::memory_order_acq_rel) > 1)
+			return;
+
+		with_deadline_allocator_t<Handler> alloc(s->alloc);
+
+		std::allocator_traits<with_deadline_allocator_t<Handler>>::destroy(alloc, s);
+		std::allocator_traits<with_deadline_allocator_t<Handler>>::deallocate(alloc, s, 1);
+	}
+
+	// replace the error of the completion with timed_out, the error is the first argument, or the
+	// first element of the tuple when the signature is transformed by asio::as_tuple.
+	template<typename T>
+	inline void with_deadline_set_timed_out(T& arg) noexcept
+	{
+		if constexpr (std::is_same_v<std::decay_t<T>, asio::error_code>)
+		{
+			if (arg)
+				arg = asio::error::timed_out;
+		}
+		else if constexpr (asio::detail::is_template_instance_of<std::tuple, std::decay_t<T>>)
+		{
+			if constexpr (std::tuple_size_v<std::decay_t<T>> > 0)
+				with_deadline_set_timed_out(std::get<0>(arg));
+		}
+	}
+
+	template<typename Handler>
+	class with_deadline_handler
+	{
+	public:
+		using cancellation_slot_type = asio::cancellation_slot;
+
+		explicit with_deadline_handler(with_deadline_state<Handler>* s) noexcept : state_(s)
+		{
+		}
+
+		with_deadline_handler(with_deadline_handler&& other) noexcept
+			: state_(std::exchange(other.state_, nullptr))
+		{
+		}
+
+		with_deadline_handler(const with_deadline_handler&) = delete;
+		with_deadline_handler& operator=(const with_deadline_handler&) = delete;
+
+		~with_deadline_handler()
+		{
+			// the operation is destroyed without completion, e.g. the context is shutdown.
+			if (state_)
+			{
+				state_->done = true;
+				state_->timer.cancel();
+				asio::get_associated_cancellation_slot(state_->handler).clear();
+				with_deadline_release(state_);
+			}
+		}
+
+		inline cancellation_slot_type get_cancellation_slot() const noexcept
+		{
+			return state_->signal.slot();
+		}
+
+		template<typename... Args>
+		void operator()(Args... args)
+		{
+			with_deadline_state<Handler>* s = std::exchange(state_, nullptr);
+
+			s->done = true;
+			s->timer.cancel();
+
+			asio::get_associated_cancellation_slot(s->handler).clear();
+
+			if (s->timed_out)
+			{
+				if constexpr (sizeof...(Args) > 0)
+				{
+					with_deadline_set_timed_out(std::get<0>(std::forward_as_tuple(args...)));
+				}
+			}
+
+			// the state must be released before the upcall, so it can be reused by the next operation.
+			Handler handler(std::move(s->handler));
+
+			with_deadline_release(s);
+
+			std::move(handler)(std::move(args)...);
+		}
+
+	protected:
+		template<template<typename, typename> class, typename, typename>
+		friend struct asio::associator;
+
+		with_deadline_state<Handler>* state_;
+	};
+
+	template<typename Handler>
+	class with_deadline_timer_handler
+	{
+	public:
+		explicit with_deadline_timer_handler(with_deadline_state<Handler>* s) noexcept : state_(s)
+		{
+		}
+
+		with_deadline_timer_handler(with_deadline_timer_handler&& other) noexcept
+			: state_(std::exchange(other.state_, nullptr))
+		{
+		}
+
+		with_deadline_timer_handler(const with_deadline_timer_handler&) = delete;
+		with_deadline_timer_handler& operator=(const with_deadline_timer_handler&) = delete;
+
+		// the wait is dropped without completion when the context is shutdown.
+		~with_deadline_timer_handler()
+		{
+			if (state_)
+				with_deadline_release(state_);
+		}
+
+		void operator()(const asio::error_code& ec)
+		{
+			with_deadline_state<Handler>* s = std::exchange(state_, nullptr);
+
+			if (!ec && !s->done)
+			{
+				s->timed_out = true;
+				s->signal.emit(s->cancel_type);
+			}
+
+			with_deadline_release(s);
+		}
+
+	protected:
+		with_deadline_state<Handler>* state_;
+	};
+
+	template<typename Handler>
+	struct with_deadline_cancel_forwarder
+	{
+		with_deadline_state<Handler>* state;
+
+		void operator()(asio::cancellation_type_t type)
+		{
+			state->signal.emit(type);
+		}
+	};
+
+	template<typename Initiation>
+	struct with_deadline_init
+	{
+		Initiation                            initiation;
+
+		std::chrono::steady_clock::time_point expiry;
+
+		asio::cancellation_type_t             cancel_type;
+
+		template<typename Handler, typename... Args>
+		void operator()(Handler&& h, Args&&... args)
+		{
+			using handler_t = std::decay_t<Handler>;
+			using state_t = with_deadline_state<handler_t>;
+
+			with_deadline_allocator_t<handler_t> alloc(
+				asio::get_associated_allocator(h, asio::recycling_allocator<void>()));
+
+			// the timer must run in the executor of the operation, the system executor of a plain
+			// callback would run it in any thread.
+			auto executor = asio::get_associated_executor(h, asio::get_associated_executor(initiation));
+
+			state_t* s = std::allocator_traits<with_deadline_allocator_t<handler_t>>::allocate(alloc, 1);
+
+			try
+			{
+				std::allocator_traits<with_deadline_allocator_t<handler_t>>::construct(
+					alloc, s, std::forward<Handler>(h), executor, alloc);
+			}
+			catch (...)
+			{
+				std::allocator_traits<with_deadline_allocator_t<handler_t>>::deallocate(alloc, s, 1);
+				throw;
+			}
+
+			s->cancel_type = cancel_type;
+
+			// the cancellation of the outer handler is forwarded to the operation.
+			if (asio::cancellation_slot slot = asio::get_associated_cancellation_slot(s->handler); slot.is_connected())
+				slot.template emplace<with_deadline_cancel_forwarder<handler_t>>(s);
+
+			s->timer.expires_at(expiry);
+			s->timer.async_wait(with_deadline_timer_handler<handler_t>(s));
+
+			std::move(initiation)(with_deadline_handler<handler_t>(s), std::forward<Args>(args)...);
+		}
+	};
+}
+
+namespace asio
+{
+	template<template<typename, typename> class Associator, typename Handler, typename DefaultCandidate>
+	struct associator<Associator, detail::with_deadline_handler<Handler>, DefaultCandidate>
+		: Associator<Handler, DefaultCandidate>
+	{
+		static typename Associator<Handler, DefaultCandidate>::type get(
+			const detail::with_deadline_handler<Handler>& h) noexcept
+		{
+			return Associator<Handler, DefaultCandidate>::get(h.state_->handler);
+		}
+
+		static auto get(const detail::with_deadline_handler<Handler>& h, const DefaultCandidate& c) noexcept
+			-> decltype(Associator<Handler, DefaultCandidate>::get(h.state_->handler, c))
+		{
+			return Associator<Handler, DefaultCandidate>::get(h.state_->handler, c);
+		}
+	};
+
+	template<typename CompletionToken, typename... Signatures>
+	struct async_result<with_deadline_t<CompletionToken>, Signatures...>
+		: async_result<CompletionToken, Signatures...>
+	{
+		template<typename Initiation, typename RawCompletionToken, typename... Args>
+		static auto initiate(Initiation&& initiation, RawCompletionToken&& token, Args&&... args)
+		{
+			return asio::async_initiate<
+				std::conditional_t<std::is_const_v<std::remove_reference_t<RawCompletionToken>>,
+					const CompletionToken, CompletionToken>, Signatures...>(
+				detail::with_deadline_init<std::decay_t<Initiation>>{
+					std::forward<Initiation>(initiation), token.expiry_, token.cancel_type_ },
+				token.token_, std::forward<Args>(args)...);
+		}
+	};
+
+	/**
+	 * @brief Adapt a completion token, so the operation is cancelled when the deadline expires,
+	 * then the operation completes with its own completion signature, and the error is replaced
+	 * by asio::error::timed_out. The deadline is driven by the timing wheel of the context of the
+	 * handler's associated executor, so it is rounded up to the tick of the wheel, see
+	 * asio::timing_wheel_service. The operation must support the per-operation cancellation.
+	 * The deadline runs in the handler's associated executor, or the executor of the operation if the
+	 * handler has none, the cancellation is emitted there, so the executor must serialize it with the
+	 * operation, that is a strand or an io_context which is run by one thread.
+	 * @param token - The completion token to adapt.
+	 * @param timeout - The duration, or the time point of the deadline.
+	 * @eg:
+	 * auto [ec, n] = co_await sock.async_read_some(buf, asio::with_deadline(asio::use_nothrow_awaitable, 5s));
+	 * if (ec == asio::error::timed_out)
+	 * {
+	 * }
+	 */
+	template<typename CompletionToken, typename Rep, typename Period>
+	inline with_deadline_t<std::decay_t<CompletionToken>> with_deadline(
+		CompletionToken&& token, std::chrono::duration<Rep, Period> timeout,
+		asio::cancellation_type_t cancel_type = asio::cancellation_type::terminal)
+	{
+		return { std::forward<CompletionToken>(token),
+			std::chrono::steady_clock::now() +
+			std::chrono::ceil<std::chrono::steady_clock::duration>(timeout), cancel_type };
+	}
+
+	template<typename CompletionToken>
+	inline with_deadline_t<std::decay_t<CompletionToken>> with_deadline(
+		CompletionToken&& token, std::chrono::steady_clock::time_point expiry,
+		asio::cancellation_type_t cancel_type = asio::cancellation_type::terminal)
+	{
+		return { std::forward<CompletionToken>(token), expiry, cancel_type };
+	}
+
+	/**
+	 * @brief Adapt the default completion token asio::use_nothrow_deferred.
+	 * @eg: auto [ec, n] = co_await sock.async_read_some(buf, asio::with_deadline(5s));
+	 */
+	template<typename Rep, typename Period>
+	inline auto with_deadline(std::chrono::duration<Rep, Period> timeout,
+		asio::cancellation_type_t cancel_type = asio::cancellation_type::terminal)
+	{
+		return with_deadline(use_nothrow_deferred, timeout, cancel_type);
+	}
+
+	inline auto with_deadline(std::chrono::steady_clock::time_point expiry,
+		asio::cancellation_type_t cancel_type = asio::cancellation_type::terminal)
+	{
+		return with_deadline(use_nothrow_deferred, expiry, cancel_type);
+	}
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2017-2023 zhllxt
+ *
+ * author   : zhllxt
+ * email    : 37792738@qq.com
+ * 
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <asio3/core/asio.hpp>
+#include <asio3/core/detail/netutil.hpp>
+#include <asio3/dns/error.hpp>
+
+namespace asio::dns
+{
+	enum class record_type : std::uint16_t
+	{
+		a     = 1,
+		ns    = 2,
+		cname = 5,
+		soa   = 6,
+		ptr   = 12,
+		mx    = 15,
+		txt   = 16,
+		aaaa  = 28,
+		opt   = 41,
+		any   = 255,
+	};
+
+	enum class record_class : std::uint16_t
+	{
+		in    = 1,
+	};
+
+	enum class rcode : std::uint8_t
+	{
+		no_error        = 0,
+		format_error    = 1,
+		server_failure  = 2,
+		name_error      = 3,
+		not_implemented = 4,
+		refused         = 5,
+	};
+
+	struct option
+	{
+		/// The name servers, if it is empty, the name servers in the resolv_conf file will be used.
+		std::vector<asio::ip::udp::endpoint> nameservers{};
+
+		/// How long to wait for a response from one name server before retransmitting to the next.
+		std::chrono::steady_clock::duration  timeout     = std::chrono::seconds(5);
+
+		/// How many times to try the whole name server list.
+		std::size_t                          attempts    = 2;
+
+		/// The resolv.conf file, "nameserver" and "options timeout: attempts:" lines are used.
+		std::string                          resolv_conf = "/etc/resolv.conf";
+
+		/// The hosts file, the names in it are resolved without any query.
+		std::string                          hosts_file  = "/etc/hosts";
+	};
+
+	struct answer
+	{
+		/// The A or AAAA addresses in the answer section.
+		std::vector<asio::ip::address> addresses{};
+
+		/// The minimum ttl of the address records, in seconds.
+		std::uint32_t                  ttl       = 0;
+
+		/// The TC bit of the response, the response is truncated and need retry with tcp.
+		bool                           truncated = false;
+	};
+
+	/// The udp payload size advertised by the EDNS0 OPT record, see https://www.dnsflagday.net/2020/
+	static std::uint16_t constexpr edns_udp_payload_size = 1232;
+
+	/// The default dns port.
+	static std::uint16_t constexpr default_port = 53;
+}
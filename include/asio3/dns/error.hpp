@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2017-2023 zhllxt
+ *
+ * author   : zhllxt
+ * email    : 37792738@qq.com
+ * 
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <asio3/core/asio.hpp>
+
+namespace asio::dns
+{
+	///-----------------------------------------------------------------------------------------------
+	/// DOMAIN NAMES - IMPLEMENTATION AND SPECIFICATION: 
+	///		https://www.ietf.org/rfc/rfc1035.txt
+	/// DNS Extensions to Support IP Version 6 : 
+	///		https://www.ietf.org/rfc/rfc3596.txt
+	/// Extension Mechanisms for DNS (EDNS(0)) : 
+	///		https://www.ietf.org/rfc/rfc6891.txt
+	///-----------------------------------------------------------------------------------------------
+
+	/// The type of error category used by the library
+	using error_category = asio::error_category;
+
+	/// The type of error condition used by the library
+	using error_condition = asio::error_condition;
+
+	enum class error
+	{
+		success = 0,
+
+		/// the name server was unable to interpret the query.
+		format_error,
+
+		/// the name server was unable to process this query due to a problem with the name server.
+		server_failure,
+
+		/// the domain name referenced in the query does not exist.
+		name_error,
+
+		/// the name server does not support the requested kind of query.
+		not_implemented,
+
+		/// the name server refuses to perform the specified operation for policy reasons.
+		refused,
+
+		/// the response message is malformed or doesn't match the query.
+		malformed_response,
+
+		/// the domain name is invalid.
+		invalid_name,
+
+		/// there are no name servers configured.
+		no_name_servers,
+	};
+
+	class dns_error_category : public error_category
+	{
+	public:
+		const char* name() const noexcept override
+		{
+			return "asio2.dns";
+		}
+
+		inline std::string message(int ev) const override
+		{
+			switch (static_cast<error>(ev))
+			{
+			case error::success:
+				return "Success";
+			case error::format_error:
+				return "format error";
+			case error::server_failure:
+				return "server failure";
+			case error::name_error:
+				return "name error";
+			case error::not_implemented:
+				return "not implemented";
+			case error::refused:
+				return "refused";
+			case error::malformed_response:
+				return "malformed response";
+			case error::invalid_name:
+				return "invalid name";
+			case error::no_name_servers:
+				return "no name servers";
+			default:
+				return "Unknown DNS error";
+			}
+		}
+
+		inline error_condition default_error_condition(int ev) const noexcept override
+		{
+			return error_condition{ ev, *this };
+		}
+	};
+
+	inline const dns_error_category& dns_category() noexcept
+	{
+		static dns_error_category const cat{};
+		return cat;
+	}
+
+	inline error_code make_error_code(error e) noexcept
+	{
+		return error_code{ static_cast<std::underlying_type<error>::type>(e), dns_category() };
+	}
+}
+
+namespace std
+{
+	template<>
+	struct is_error_code_enum<::asio::dns::error>
+	{
+		static bool const value = true;
+	};
+}
@@ -0,0 +1,494 @@
+/*
+ * Copyright (c) 2017-2023 zhllxt
+ *
+ * author   : zhllxt
+ * email    : 37792738@qq.com
+ * 
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <asio3/dns/core.hpp>
+
+namespace asio::dns::detail
+{
+	inline bool read_u16(std::string_view msg, std::size_t& pos, std::uint16_t& v) noexcept
+	{
+		if (msg.size() < pos + 2)
+			return false;
+
+		const char* p = msg.data() + pos;
+		v = asio::detail::read<std::uint16_t>(p);
+		pos += 2;
+		return true;
+	}
+
+	inline bool read_u32(std::string_view msg, std::size_t& pos, std::uint32_t& v) noexcept
+	{
+		if (msg.size() < pos + 4)
+			return false;
+
+		const char* p = msg.data() + pos;
+		v = asio::detail::read<std::uint32_t>(p);
+		pos += 4;
+		return true;
+	}
+
+	/**
+	 * @brief Read a (maybe compressed) domain name at the pos, the pos is moved after the name.
+	 * The name is converted to lower case and without the trailing dot.
+	 */
+	inline bool read_name(std::string_view msg, std::size_t& pos, std::string& name)
+	{
+		name.clear();
+
+		std::size_t cur = pos;
+		bool jumped = false;
+
+		// limit the jumps to avoid the pointer loop.
+		for (int jumps = 0; jumps < 64;)
+		{
+			if (cur >= msg.size())
+				return false;
+
+			std::uint8_t len = std::uint8_t(msg[cur]);
+
+			if (len == 0)
+			{
+				if (!jumped)
+					pos = cur + 1;
+				return true;
+			}
+
+			if ((len & 0xC0) == 0xC0)
+			{
+				if (cur + 1 >= msg.size())
+					return false;
+
+				if (!jumped)
+					pos = cur + 2;
+
+				cur = (std::size_t(len & 0x3F) << 8) | std::uint8_t(msg[cur + 1]);
+				jumped = true;
+				++jumps;
+				continue;
+			}
+
+			if ((len & 0xC0) != 0 || cur + 1 + len > msg.size())
+				return false;
+
+			if (!name.empty())
+				name += '.';
+
+			for (std::size_t i = cur + 1; i < cur + 1 + len; ++i)
+			{
+				char c = msg[i];
+				name += (c >= 'A' && c <= 'Z') ? char(c - 'A' + 'a') : c;
+			}
+
+			if (name.size() > 255)
+				return false;
+
+			cur += 1 + len;
+		}
+
+		return false;
+	}
+
+	inline bool iequals(std::string_view a, std::string_view b) noexcept
+	{
+		if (a.size() != b.size())
+			return false;
+
+		for (std::size_t i = 0; i < a.size(); ++i)
+		{
+			char x = a[i], y = b[i];
+			if (x >= 'A' && x <= 'Z') x = char(x - 'A' + 'a');
+			if (y >= 'A' && y <= 'Z') y = char(y - 'A' + 'a');
+			if (x != y)
+				return false;
+		}
+
+		return true;
+	}
+
+	inline std::vector<std::string_view> split_words(std::string_view s)
+	{
+		std::vector<std::string_view> words;
+
+		while (!s.empty())
+		{
+			std::size_t b = s.find_first_not_of(" \t\r\n");
+			if (b == std::string_view::npos)
+				break;
+
+			s.remove_prefix(b);
+
+			std::size_t e = s.find_first_of(" \t\r\n");
+			words.emplace_back(s.substr(0, e));
+
+			s.remove_prefix(e == std::string_view::npos ? s.size() : e);
+		}
+
+		return words;
+	}
+
+	inline std::string_view trim_name(std::string_view name) noexcept
+	{
+		if (!name.empty() && name.back() == '.')
+			name.remove_suffix(1);
+		return name;
+	}
+}
+
+namespace asio::dns
+{
+	/**
+	 * @brief Make a recursive query message with one question and an EDNS0 OPT record.
+	 * @param msg - The output message.
+	 * @param id - The query id.
+	 * @param name - The domain name.
+	 * @param type - The query type.
+	 * @return false if the name is not a valid domain name.
+	 */
+	inline bool make_query(std::string& msg, std::uint16_t id, std::string_view name, record_type type)
+	{
+		name = detail::trim_name(name);
+
+		msg.clear();
+
+		if (name.empty() || name.size() > 253)
+			return false;
+
+		// header + question(labels + root + type + class) + opt record
+		msg.resize(12 + (name.size() + 2) + 4 + 11);
+
+		char* p = msg.data();
+
+		asio::detail::write(p, std::uint16_t(id));
+		asio::detail::write(p, std::uint16_t(0x0100)); // RD
+		asio::detail::write(p, std::uint16_t(1)); // QDCOUNT
+		asio::detail::write(p, std::uint16_t(0)); // ANCOUNT
+		asio::detail::write(p, std::uint16_t(0)); // NSCOUNT
+		asio::detail::write(p, std::uint16_t(1)); // ARCOUNT
+
+		while (!name.empty())
+		{
+			std::size_t n = name.find('.');
+			std::string_view label = name.substr(0, n);
+
+			if (label.empty() || label.size() > 63)
+			{
+				msg.clear();
+				return false;
+			}
+
+			asio::detail::write(p, std::uint8_t(label.size()));
+			std::memcpy(p, label.data(), label.size());
+			p += label.size();
+
+			name.remove_prefix(n == std::string_view::npos ? name.size() : n + 1);
+		}
+
+		asio::detail::write(p, std::uint8_t(0));
+		asio::detail::write(p, std::uint16_t(type));
+		asio::detail::write(p, std::uint16_t(record_class::in));
+
+		// OPT pseudo record
+		asio::detail::write(p, std::uint8_t(0));
+		asio::detail::write(p, std::uint16_t(record_type::opt));
+		asio::detail::write(p, std::uint16_t(edns_udp_payload_size));
+		asio::detail::write(p, std::uint32_t(0));
+		asio::detail::write(p, std::uint16_t(0));
+
+		msg.resize(std::size_t(p - msg.data()));
+
+		return true;
+	}
+
+	/**
+	 * @brief Check whether the message is a response to the query which is made by make_query:
+	 * the id, the QR bit and the question section must match, the name is case insensitive.
+	 * It is used to drop the spoofed or stale datagrams before the response is parsed.
+	 * @param msg - The response message.
+	 * @param query - The query message.
+	 */
+	inline bool is_response_of(std::string_view msg, std::string_view query) noexcept
+	{
+		// the question of the query is not compressed, skip the labels of its name.
+		std::size_t end = 12;
+		while (end < query.size() && query[end] != 0)
+			end += 1 + std::uint8_t(query[end]);
+
+		// the root label, the type and the class.
+		end += 1 + 4;
+
+		if (end > query.size() || end > msg.size())
+			return false;
+
+		// the id, and the QR bit.
+		if (msg[0] != query[0] || msg[1] != query[1] || (std::uint8_t(msg[2]) & 0x80) == 0)
+			return false;
+
+		// the qdcount.
+		if (msg[4] != 0 || msg[5] != 1)
+			return false;
+
+		// the type and the class must be the same exactly.
+		if (msg.substr(end - 4, 4) != query.substr(end - 4, 4))
+			return false;
+
+		// the length bytes of the labels are less than 64, so they are not changed by the case folding.
+		return detail::iequals(msg.substr(12, end - 16), query.substr(12, end - 16));
+	}
+
+	/**
+	 * @brief Parse the response message of the query which is made by make_query.
+	 * The response must match the query id, name and type, otherwise malformed_response is returned.
+	 * Only the addresses of the queried name, or of the end of its CNAME chain, are collected.
+	 * @param msg - The response message.
+	 * @param id - The query id.
+	 * @param name - The queried domain name.
+	 * @param type - The query type, only the records of this type are collected.
+	 * @param ans - The output answer.
+	 */
+	inline asio::error_code parse_response(
+		std::string_view msg, std::uint16_t id, std::string_view name, record_type type, answer& ans)
+	{
+		ans = {};
+
+		std::size_t pos = 0;
+		std::uint16_t rid{}, flags{}, qdcount{}, ancount{}, nscount{}, arcount{};
+
+		if (!detail::read_u16(msg, pos, rid) ||
+			!detail::read_u16(msg, pos, flags) ||
+			!detail::read_u16(msg, pos, qdcount) ||
+			!detail::read_u16(msg, pos, ancount) ||
+			!detail::read_u16(msg, pos, nscount) ||
+			!detail::read_u16(msg, pos, arcount))
+			return dns::error::malformed_response;
+
+		// must be a response to our query
+		if (rid != id || (flags & 0x8000) == 0 || qdcount != 1)
+			return dns::error::malformed_response;
+
+		std::string qname;
+		std::uint16_t qtype{}, qclass{};
+
+		if (!detail::read_name(msg, pos, qname) ||
+			!detail::read_u16(msg, pos, qtype) ||
+			!detail::read_u16(msg, pos, qclass))
+			return dns::error::malformed_response;
+
+		if (!detail::iequals(qname, detail::trim_name(name)) ||
+			qtype != std::uint16_t(type) || qclass != std::uint16_t(record_class::in))
+			return dns::error::malformed_response;
+
+		if (flags & 0x0200)
+		{
+			ans.truncated = true;
+			return {};
+		}
+
+		switch (static_cast<rcode>(flags & 0x000F))
+		{
+		case rcode::no_error       : break;
+		case rcode::format_error   : return dns::error::format_error;
+		case rcode::server_failure : return dns::error::server_failure;
+		case rcode::name_error     : return dns::error::name_error;
+		case rcode::not_implemented: return dns::error::not_implemented;
+		case rcode::refused        : return dns::error::refused;
+		default                    : return dns::error::server_failure;
+		}
+
+		struct record
+		{
+			std::string   owner;
+			std::uint16_t type;
+			std::uint32_t ttl;
+			std::size_t   rdpos;
+			std::uint16_t rdlen;
+		};
+
+		std::vector<record> records;
+
+		for (std::uint16_t i = 0; i < ancount; ++i)
+		{
+			record r{};
+			std::uint16_t rclass{};
+
+			if (!detail::read_name(msg, pos, r.owner) ||
+				!detail::read_u16(msg, pos, r.type) ||
+				!detail::read_u16(msg, pos, rclass) ||
+				!detail::read_u32(msg, pos, r.ttl) ||
+				!detail::read_u16(msg, pos, r.rdlen) ||
+				msg.size() < pos + r.rdlen)
+				return dns::error::malformed_response;
+
+			r.rdpos = pos;
+
+			pos += r.rdlen;
+
+			if (rclass == std::uint16_t(record_class::in))
+				records.emplace_back(std::move(r));
+		}
+
+		// follow the CNAME chain from the queried name, only the records which are owned by the
+		// end of the chain are accepted, so a record of an unrelated name is not cached for it.
+		std::string target = qname;
+		std::uint32_t min_ttl = (std::numeric_limits<std::uint32_t>::max)();
+
+		for (int depth = 0; depth < 16; ++depth)
+		{
+			auto it = std::find_if(records.begin(), records.end(), [&target](const record& r)
+			{
+				return r.type == std::uint16_t(record_type::cname) && r.owner == target;
+			});
+
+			if (it == records.end())
+				break;
+
+			std::size_t rdpos = it->rdpos;
+			if (!detail::read_name(msg, rdpos, target) || rdpos > it->rdpos + it->rdlen)
+				return dns::error::malformed_response;
+
+			min_ttl = (std::min)(min_ttl, it->ttl);
+		}
+
+		for (const record& r : records)
+		{
+			if (r.type != std::uint16_t(type) || r.owner != target)
+				continue;
+
+			if /**/ (r.type == std::uint16_t(record_type::a) && r.rdlen == 4)
+			{
+				asio::ip::address_v4::bytes_type bytes{};
+				std::memcpy(bytes.data(), msg.data() + r.rdpos, bytes.size());
+				ans.addresses.emplace_back(asio::ip::address_v4(bytes));
+				min_ttl = (std::min)(min_ttl, r.ttl);
+			}
+			else if (r.type == std::uint16_t(record_type::aaaa) && r.rdlen == 16)
+			{
+				asio::ip::address_v6::bytes_type bytes{};
+				std::memcpy(bytes.data(), msg.data() + r.rdpos, bytes.size());
+				ans.addresses.emplace_back(asio::ip::address_v6(bytes));
+				min_ttl = (std::min)(min_ttl, r.ttl);
+			}
+		}
+
+		ans.ttl = ans.addresses.empty() ? 0 : min_ttl;
+
+		return {};
+	}
+
+	/**
+	 * @brief Read the "nameserver" and "options timeout:n attempts:n" lines of the resolv.conf file.
+	 * The name servers which are already in the option are kept.
+	 * @return false if the file can't be opened.
+	 */
+	inline bool read_resolv_conf(const std::string& path, option& opt)
+	{
+		std::ifstream file(path);
+		if (!file)
+			return false;
+
+		bool has_servers = !opt.nameservers.empty();
+
+		for (std::string line; std::getline(file, line);)
+		{
+			std::string_view s = line;
+
+			if (std::size_t n = s.find_first_of("#;"); n != std::string_view::npos)
+				s = s.substr(0, n);
+
+			std::vector<std::string_view> words = detail::split_words(s);
+
+			if (words.size() < 2)
+				continue;
+
+			if (words[0] == "nameserver" && !has_servers)
+			{
+				asio::error_code ec{};
+				asio::ip::address addr = asio::ip::make_address(words[1], ec);
+				if (!ec)
+					opt.nameservers.emplace_back(addr, default_port);
+			}
+			else if (words[0] == "options")
+			{
+				for (std::size_t i = 1; i < words.size(); ++i)
+				{
+					std::string_view w = words[i];
+					std::size_t v{};
+
+					auto parse = [&w, &v](std::string_view key) -> bool
+					{
+						if (!w.starts_with(key))
+							return false;
+						auto [ptr, err] = std::from_chars(w.data() + key.size(), w.data() + w.size(), v);
+						return (err == std::errc{} && ptr == w.data() + w.size());
+					};
+
+					if /**/ (parse("timeout:") && v > 0)
+						opt.timeout = std::chrono::seconds(v);
+					else if (parse("attempts:") && v > 0)
+						opt.attempts = v;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	/**
+	 * @brief Read the hosts file, the key of the map is the lower case host name.
+	 */
+	inline std::unordered_multimap<std::string, asio::ip::address> read_hosts(const std::string& path)
+	{
+		std::unordered_multimap<std::string, asio::ip::address> hosts;
+
+		std::ifstream file(path);
+		if (!file)
+			return hosts;
+
+		for (std::string line; std::getline(file, line);)
+		{
+			std::string_view s = line;
+
+			if (std::size_t n = s.find('#'); n != std::string_view::npos)
+				s = s.substr(0, n);
+
+			std::vector<std::string_view> words = detail::split_words(s);
+
+			if (words.size() < 2)
+				continue;
+
+			asio::error_code ec{};
+			asio::ip::address addr = asio::ip::make_address(words[0], ec);
+			if (ec)
+				continue;
+
+			for (std::size_t i = 1; i < words.size(); ++i)
+			{
+				std::string name(detail::trim_name(words[i]));
+				for (char& c : name)
+				{
+					if (c >= 'A' && c <= 'Z')
+						c = char(c - 'A' + 'a');
+				}
+				hosts.emplace(std::move(name), addr);
+			}
+		}
+
+		return hosts;
+	}
+}
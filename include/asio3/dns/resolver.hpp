@@ -0,0 +1,564 @@
+/*
+ * Copyright (c) 2017-2023 zhllxt
+ *
+ * author   : zhllxt
+ * email    : 37792738@qq.com
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <charconv>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <asio3/core/asio.hpp>
+#include <asio3/core/frame_allocator.hpp>
+#include <asio3/core/strutil.hpp>
+#include <asio3/dns/core.hpp>
+#include <asio3/dns/parser.hpp>
+#include <asio3/tcp/core.hpp>
+#include <asio3/udp/core.hpp>
+
+namespace asio::dns::detail
+{
+	/**
+	 * Each query is sent by a new connected udp socket, so the source port which is chosen
+	 * by the kernel randomly is a part of the entropy besides the 16 bit query id, and the
+	 * icmp port unreachable error is reported. All the members are accessed in the strand only.
+	 */
+	class resolver_impl : public std::enable_shared_from_this<resolver_impl>
+	{
+	public:
+		using strand_type = asio::strand<asio::any_io_executor>;
+
+		explicit resolver_impl(const asio::any_io_executor& ex, dns::option opt)
+			: strand_(asio::make_strand(ex))
+			, option_(std::move(opt))
+			, rng_(std::random_device{}())
+		{
+			if (!option_.resolv_conf.empty())
+				dns::read_resolv_conf(option_.resolv_conf, option_);
+
+			if (!option_.hosts_file.empty())
+				hosts_ = dns::read_hosts(option_.hosts_file);
+
+			if (option_.attempts == 0)
+				option_.attempts = 1;
+		}
+
+		inline strand_type& strand() noexcept { return strand_; }
+
+		inline const dns::option& option() const noexcept { return option_; }
+
+		inline bool is_closed() const noexcept { return closed_; }
+
+		/**
+		 * @brief Find the name in the hosts file.
+		 */
+		inline std::vector<asio::ip::address> find_host(std::string_view name) const
+		{
+			std::string key(trim_name(name));
+			for (char& c : key)
+			{
+				if (c >= 'A' && c <= 'Z')
+					c = char(c - 'A' + 'a');
+			}
+
+			std::vector<asio::ip::address> addrs;
+
+			auto [beg, end] = hosts_.equal_range(key);
+			for (auto it = beg; it != end; ++it)
+				addrs.emplace_back(it->second);
+
+			return addrs;
+		}
+
+		inline std::uint16_t next_id()
+		{
+			std::uniform_int_distribution<std::uint32_t> dist(0, 0xFFFF);
+
+			return std::uint16_t(dist(rng_));
+		}
+
+		/**
+		 * @brief Track the socket of an outstanding query, it is closed by the close function.
+		 */
+		inline void add_socket(asio::udp_socket* sock)
+		{
+			socks_.emplace(sock);
+		}
+
+		inline void remove_socket(asio::udp_socket* sock)
+		{
+			socks_.erase(sock);
+		}
+
+		inline void close()
+		{
+			closed_ = true;
+
+			for (asio::udp_socket* sock : socks_)
+			{
+				asio::error_code ec{};
+				sock->close(ec);
+			}
+		}
+
+	protected:
+		strand_type                                             strand_;
+
+		dns::option                                             option_;
+
+		std::unordered_set<asio::udp_socket*>                   socks_;
+
+		std::unordered_multimap<std::string, asio::ip::address> hosts_;
+
+		std::mt19937                                            rng_;
+
+		bool                                                    closed_ = false;
+	};
+
+	struct async_udp_query_op
+	{
+		struct socket_guard
+		{
+			std::shared_ptr<resolver_impl>& impl;
+			asio::udp_socket& sock;
+
+			~socket_guard()
+			{
+				impl->remove_socket(std::addressof(sock));
+
+				asio::error_code ec_ignore{};
+				sock.close(ec_ignore);
+			}
+		};
+
+		auto operator()(
+			auto state, std::shared_ptr<resolver_impl> impl,
+			asio::ip::udp::endpoint server, std::string_view query) -> void
+		{
+			state.reset_cancellation_state(asio::enable_terminal_cancellation());
+
+			auto sock = std::make_shared<asio::udp_socket>(impl->strand());
+
+			std::string response;
+
+			asio::error_code ec{};
+
+			sock->open(server.protocol(), ec);
+			if (ec)
+				co_return{ ec, std::move(response) };
+
+			socket_guard guard{ impl, *sock };
+
+			impl->add_socket(sock.get());
+
+			// connected, so the datagrams of the other endpoints are dropped by the kernel.
+			sock->connect(server, ec);
+			if (ec)
+				co_return{ ec, std::move(response) };
+
+			asio::steady_timer timer(impl->strand());
+			timer.expires_after(impl->option().timeout);
+			timer.async_wait([sock](const asio::error_code& ec) mutable
+			{
+				if (!ec)
+				{
+					asio::error_code ec_ignore{};
+					sock->close(ec_ignore);
+				}
+			});
+
+			auto [e1, n1] = co_await sock->async_send(asio::buffer(query), use_nothrow_deferred);
+			if (e1)
+				co_return{ sock->is_open() ? e1 : asio::error_code(asio::error::timed_out), std::move(response) };
+
+			response.resize(4096);
+
+			for (;;)
+			{
+				// the icmp error, such as connection_refused, is reported here.
+				auto [e2, n2] = co_await sock->async_receive(asio::buffer(response), use_nothrow_deferred);
+				if (e2)
+				{
+					response.clear();
+					co_return{ sock->is_open() ? e2 : asio::error_code(asio::error::timed_out), std::move(response) };
+				}
+
+				// a stale or spoofed datagram, e.g. the late response to the former owner of the port,
+				// or one of another question, ignore it and keep waiting the real response.
+				if (dns::is_response_of(std::string_view(response.data(), n2), query))
+				{
+					response.resize(n2);
+					break;
+				}
+			}
+
+			asio::detail::cancel_timer(timer);
+
+			co_return{ asio::error_code{}, std::move(response) };
+		}
+	};
+
+	struct async_tcp_query_op
+	{
+		auto operator()(
+			auto state, std::shared_ptr<resolver_impl> impl,
+			asio::ip::udp::endpoint server, std::string_view query) -> void
+		{
+			state.reset_cancellation_state(asio::enable_terminal_cancellation());
+
+			auto sock = std::make_shared<asio::tcp_socket>(impl->strand());
+
+			// the whole exchange shares one timeout.
+			asio::steady_timer timer(impl->strand());
+			timer.expires_after(impl->option().timeout);
+			timer.async_wait([sock](const asio::error_code& ec) mutable
+			{
+				if (!ec)
+				{
+					asio::error_code ec_ignore{};
+					sock->close(ec_ignore);
+				}
+			});
+
+			std::string response;
+
+			auto [e1] = co_await sock->async_connect(
+				asio::ip::tcp::endpoint(server.address(), server.port()), use_nothrow_deferred);
+			if (e1)
+				co_return{ sock->is_open() ? e1 : asio::error_code(asio::error::timed_out), std::move(response) };
+
+			std::array<char, 2> head{};
+			char* p = head.data();
+			asio::detail::write(p, std::uint16_t(query.size()));
+
+			std::array<asio::const_buffer, 2> buffers{ asio::buffer(head), asio::buffer(query) };
+
+			auto [e2, n2] = co_await asio::async_write(*sock, buffers, use_nothrow_deferred);
+			if (e2)
+				co_return{ sock->is_open() ? e2 : asio::error_code(asio::error::timed_out), std::move(response) };
+
+			auto [e3, n3] = co_await asio::async_read(
+				*sock, asio::buffer(head), asio::transfer_exactly(head.size()), use_nothrow_deferred);
+			if (e3)
+				co_return{ sock->is_open() ? e3 : asio::error_code(asio::error::timed_out), std::move(response) };
+
+			const char* q = head.data();
+			response.resize(asio::detail::read<std::uint16_t>(q));
+
+			auto [e4, n4] = co_await asio::async_read(
+				*sock, asio::buffer(response), asio::transfer_exactly(response.size()), use_nothrow_deferred);
+			if (e4)
+				co_return{ sock->is_open() ? e4 : asio::error_code(asio::error::timed_out), std::move(response) };
+
+			asio::detail::cancel_timer(timer);
+
+			asio::error_code ec_ignore{};
+			sock->shutdown(asio::socket_base::shutdown_both, ec_ignore);
+			sock->close(ec_ignore);
+
+			co_return{ asio::error_code{}, std::move(response) };
+		}
+	};
+
+	struct async_query_op
+	{
+		auto operator()(
+			auto state, std::shared_ptr<resolver_impl> impl, std::string name, dns::record_type type) -> void
+		{
+			co_await asio::dispatch(impl->strand(), use_nothrow_deferred);
+
+			state.reset_cancellation_state(asio::enable_terminal_cancellation());
+
+			const std::vector<asio::ip::udp::endpoint>& servers = impl->option().nameservers;
+
+			if (servers.empty())
+				co_return{ dns::error::no_name_servers, dns::answer{} };
+
+			if (impl->is_closed())
+				co_return{ asio::error::operation_aborted, dns::answer{} };
+
+			std::uint16_t id = impl->next_id();
+
+			std::string query;
+			if (!dns::make_query(query, id, name, type))
+				co_return{ dns::error::invalid_name, dns::answer{} };
+
+			asio::error_code last_ec = asio::error::timed_out;
+
+			for (std::size_t attempt = 0; attempt < impl->option().attempts; ++attempt)
+			{
+				for (std::size_t index = 0; index < servers.size(); ++index)
+				{
+					const asio::ip::udp::endpoint& server = servers[index];
+
+					auto [e1, response] = co_await asio::async_initiate<
+						decltype(use_nothrow_deferred), void(asio::error_code, std::string)>(
+							asio::detail::recycled_co_composed<void(asio::error_code, std::string)>(
+								async_udp_query_op{}, impl->strand()),
+							use_nothrow_deferred, impl, server, std::string_view(query));
+
+					if (!!state.cancelled() || impl->is_closed())
+						co_return{ asio::error::operation_aborted, dns::answer{} };
+
+					if (e1)
+					{
+						last_ec = e1;
+						continue;
+					}
+
+					dns::answer ans{};
+
+					asio::error_code ec = dns::parse_response(response, id, name, type, ans);
+
+					// the udp response is truncated, retry with tcp.
+					if (!ec && ans.truncated)
+					{
+						auto [e2, tcp_response] = co_await asio::async_initiate<
+							decltype(use_nothrow_deferred), void(asio::error_code, std::string)>(
+								asio::detail::recycled_co_composed<void(asio::error_code, std::string)>(
+									async_tcp_query_op{}, impl->strand()),
+								use_nothrow_deferred, impl, server, std::string_view(query));
+
+						if (!!state.cancelled() || impl->is_closed())
+							co_return{ asio::error::operation_aborted, dns::answer{} };
+
+						if (e2)
+						{
+							last_ec = e2;
+							continue;
+						}
+
+						ec = dns::parse_response(tcp_response, id, name, type, ans);
+
+						if (!ec && ans.truncated)
+							ec = dns::error::malformed_response;
+					}
+
+					// the server can't answer, try the next one.
+					if (ec == dns::error::server_failure || ec == dns::error::refused ||
+						ec == dns::error::not_implemented || ec == dns::error::malformed_response)
+					{
+						last_ec = ec;
+						continue;
+					}
+
+					co_return{ ec, std::move(ans) };
+				}
+			}
+
+			co_return{ last_ec, dns::answer{} };
+		}
+	};
+
+	template<typename QueryToken>
+	inline auto async_query(std::shared_ptr<resolver_impl> impl,
+		std::string name, dns::record_type type, QueryToken&& token)
+	{
+		auto& strand = impl->strand();
+
+		return asio::async_initiate<QueryToken, void(asio::error_code, dns::answer)>(
+			asio::detail::recycled_co_composed<void(asio::error_code, dns::answer)>(
+				async_query_op{}, strand),
+			token, std::move(impl), std::move(name), type);
+	}
+
+	struct async_resolve_op
+	{
+		using results_type = asio::ip::tcp::resolver::results_type;
+
+		auto operator()(
+			auto state, std::shared_ptr<resolver_impl> impl, std::string host, std::string port) -> void
+		{
+			co_await asio::dispatch(impl->strand(), use_nothrow_deferred);
+
+			state.reset_cancellation_state(asio::enable_terminal_cancellation());
+
+			std::uint16_t uport{};
+
+			auto [ptr, err] = std::from_chars(port.data(), port.data() + port.size(), uport);
+			if (err != std::errc{} || ptr != port.data() + port.size())
+				co_return{ asio::error::service_not_found, results_type{}, std::uint32_t(0) };
+
+			std::vector<asio::ip::tcp::endpoint> eps;
+
+			auto add = [&eps, uport](const std::vector<asio::ip::address>& addrs) mutable
+			{
+				for (const asio::ip::address& addr : addrs)
+					eps.emplace_back(addr, uport);
+			};
+
+			asio::error_code ec{};
+
+			// ip literal, no need to resolve.
+			asio::ip::address addr = asio::ip::make_address(host, ec);
+			if (!ec)
+			{
+				add({ addr });
+
+				co_return{ asio::error_code{}, results_type::create(eps.begin(), eps.end(), host, port),
+					(std::numeric_limits<std::uint32_t>::max)() };
+			}
+
+			if (std::vector<asio::ip::address> addrs = impl->find_host(host); !addrs.empty())
+			{
+				add(addrs);
+
+				co_return{ asio::error_code{}, results_type::create(eps.begin(), eps.end(), host, port),
+					(std::numeric_limits<std::uint32_t>::max)() };
+			}
+
+			auto [order, e4, a4, e6, a6] = co_await asio::experimental::make_parallel_group(
+				detail::async_query(impl, host, dns::record_type::a, asio::deferred),
+				detail::async_query(impl, host, dns::record_type::aaaa, asio::deferred))
+				.async_wait(asio::experimental::wait_for_all(), use_nothrow_deferred);
+
+			asio::detail::ignore_unused(order);
+
+			add(a4.addresses);
+			add(a6.addresses);
+
+			if (eps.empty())
+			{
+				ec = e4 ? e4 : e6;
+
+				if /**/ (!ec || ec == dns::error::name_error)
+					ec = asio::error::host_not_found;
+				else if (ec == asio::error::timed_out || ec == asio::error::connection_refused ||
+					ec == dns::error::server_failure || ec == dns::error::refused)
+					ec = asio::error::host_not_found_try_again;
+
+				co_return{ ec, results_type{}, std::uint32_t(0) };
+			}
+
+			std::uint32_t ttl = (std::numeric_limits<std::uint32_t>::max)();
+
+			if (!a4.addresses.empty())
+				ttl = (std::min)(ttl, a4.ttl);
+			if (!a6.addresses.empty())
+				ttl = (std::min)(ttl, a6.ttl);
+
+			co_return{ asio::error_code{}, results_type::create(eps.begin(), eps.end(), host, port), ttl };
+		}
+	};
+}
+
+namespace asio::dns
+{
+	/**
+	 * @brief An asynchronous dns stub resolver, the queries are sent to the name servers of the
+	 * option (or the resolv.conf file) directly, no background thread is used. It is thread safety.
+	 */
+	class resolver
+	{
+	public:
+		using executor_type = asio::strand<asio::any_io_executor>;
+		using results_type  = asio::ip::tcp::resolver::results_type;
+
+		explicit resolver(const asio::any_io_executor& ex, dns::option opt = {})
+			: impl_(std::make_shared<detail::resolver_impl>(ex, std::move(opt)))
+		{
+		}
+
+		resolver(resolver&&) noexcept = default;
+		resolver& operator=(resolver&&) noexcept = default;
+
+		~resolver()
+		{
+			close();
+		}
+
+		/**
+		 * @brief Close the resolver, all the outstanding queries are aborted.
+		 */
+		inline void close()
+		{
+			if (impl_)
+			{
+				asio::dispatch(impl_->strand(), [impl = impl_]() mutable
+				{
+					impl->close();
+				});
+			}
+		}
+
+		/**
+		 * @brief Get the executor, it is a strand.
+		 */
+		inline executor_type get_executor() noexcept
+		{
+			return impl_->strand();
+		}
+
+		/**
+		 * @brief Get the option, the name servers of the resolv.conf file are included.
+		 */
+		inline const dns::option& get_option() const noexcept
+		{
+			return impl_->option();
+		}
+
+		/**
+		 * @brief Send a query for the name to the name servers asynchronously.
+		 * The query is retransmitted to the next name server when no response within the timeout,
+		 * and retried with tcp when the response is truncated.
+		 * @param name - The domain name.
+		 * @param type - The query type, only the a and aaaa records are collected into the answer.
+		 * @param token - The completion handler to invoke when the operation completes.
+		 *	  The equivalent function signature of the handler must be:
+		 *    @code
+		 *    void handler(const asio::error_code& ec, asio::dns::answer ans);
+		 */
+		template<typename String,
+			ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, dns::answer)) QueryToken
+			ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(executor_type)>
+		requires std::constructible_from<std::string, String>
+		ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(QueryToken, void(asio::error_code, dns::answer))
+		async_query(
+			String&& name, dns::record_type type,
+			QueryToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(executor_type))
+		{
+			return detail::async_query(impl_, asio::to_string(std::forward<String>(name)), type,
+				std::forward<QueryToken>(token));
+		}
+
+		/**
+		 * @brief Resolve the host and port asynchronously, the ip literal and the names in the hosts
+		 * file are resolved without query, otherwise the A and AAAA queries are sent concurrently.
+		 * @param host - The host name or ip.
+		 * @param port - The numeric port, service name is not supported.
+		 * @param token - The completion handler to invoke when the operation completes.
+		 *	  The equivalent function signature of the handler must be:
+		 *    @code
+		 *    void handler(const asio::error_code& ec, asio::ip::tcp::resolver::results_type results,
+		 *        std::uint32_t ttl); // the minimum ttl of the records, in seconds.
+		 */
+		template<typename String, typename StrOrInt,
+			ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, results_type, std::uint32_t)) ResolveToken
+			ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(executor_type)>
+		requires
+			(std::constructible_from<std::string, String> &&
+			(std::constructible_from<std::string, StrOrInt> || std::integral<std::remove_cvref_t<StrOrInt>>))
+		ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(ResolveToken, void(asio::error_code, results_type, std::uint32_t))
+		async_resolve(
+			String&& host, StrOrInt&& port,
+			ResolveToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(executor_type))
+		{
+			return asio::async_initiate<ResolveToken, void(asio::error_code, results_type, std::uint32_t)>(
+				asio::detail::recycled_co_composed<void(asio::error_code, results_type, std::uint32_t)>(
+					detail::async_resolve_op{}, impl_->strand()),
+				token, impl_,
+				asio::to_string(std::forward<String>(host)), asio::to_string(std::forward<StrOrInt>(port)));
+		}
+
+	protected:
+		std::shared_ptr<detail::resolver_impl> impl_;
+	};
+}
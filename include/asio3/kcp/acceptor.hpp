@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2017-2023 zhllxt
+ *
+ * author   : zhllxt
+ * email    : 37792738@qq.com
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <random>
+
+#include <asio3/core/asio.hpp>
+#include <asio3/core/frame_allocator.hpp>
+#include <asio3/udp/server_sessions.hpp>
+#include <asio3/kcp/core.hpp>
+#include <asio3/kcp/stream.hpp>
+
+namespace asio::detail
+{
+	struct async_kcp_accept_op
+	{
+		template<typename Acceptor>
+		auto operator()(auto state, std::reference_wrapper<Acceptor> acceptor_ref) -> void
+		{
+			state.reset_cancellation_state(asio::enable_terminal_cancellation());
+
+			auto& acceptor = acceptor_ref.get();
+
+			for (;;)
+			{
+				auto [e1, session] = co_await acceptor.sessions_.async_accept(use_nothrow_deferred);
+				if (e1)
+					co_return{ e1, kcp_stream{} };
+
+				// the first datagram of a new remote endpoint, a syn, or a kcp segment header.
+				char data[kcp_control::overhead];
+
+				auto [e2, n2] = co_await session->async_receive(asio::buffer(data), use_nothrow_deferred);
+
+				if (!e2)
+				{
+					std::optional<kcp_handshake> hs = kcp_handshake::decode(data, n2);
+
+					if (hs && hs->type == kcp_handshake_type::syn)
+					{
+						std::uint32_t conv = acceptor.next_conv();
+
+						auto impl = std::make_shared<kcp_stream_impl>(std::move(session), acceptor.option_);
+
+						impl->send_handshake(kcp_handshake_type::synack, conv);
+						impl->start(conv);
+
+						co_return{ asio::error_code{}, kcp_stream(std::move(impl)) };
+					}
+
+					// the conversation is unknown, e.g. the server side of it is closed already.
+					if (!(hs && hs->type == kcp_handshake_type::rst) && (hs || n2 >= kcp_control::overhead))
+					{
+						detail::kcp_send_handshake(session->socket(), std::addressof(session->remote_endpoint()),
+							kcp_handshake_type::rst, hs ? hs->conv : kcp_handshake::get32(data));
+					}
+				}
+
+				session->close();
+
+				if (!!state.cancelled())
+					co_return{ asio::error::operation_aborted, kcp_stream{} };
+			}
+		}
+	};
+}
+
+namespace asio
+{
+	/**
+	 * @brief A kcp server on a udp socket, the datagrams are demultiplexed by asio::udp_server_sessions,
+	 * a syn of a new remote endpoint is accepted as a kcp_stream, and the other datagrams of the
+	 * unknown conversations are replied with a rst.
+	 * The accepted streams use the executor of the socket, it must be a strand or a single threaded
+	 * io_context. A conversation which neither receives nor sends any datagram for the
+	 * udp_sessions_option::idle_timeout is broken with asio::error::timed_out.
+	 * @eg:
+	 * asio::kcp_acceptor acceptor(asio::udp_socket(ctx, asio::ip::udp::endpoint(asio::ip::udp::v4(), 8036)));
+	 * auto [ec, stream] = co_await acceptor.async_accept();
+	 */
+	class kcp_acceptor
+	{
+	public:
+		using executor_type = asio::udp_socket::executor_type;
+
+		explicit kcp_acceptor(asio::udp_socket sock, kcp_option opt = {}, udp_sessions_option sopt = {})
+			: sessions_(std::move(sock), adjust(opt, std::move(sopt)))
+			, option_(std::move(opt))
+			, conv_(std::random_device{}())
+		{
+		}
+
+		kcp_acceptor(kcp_acceptor&&) noexcept = default;
+		kcp_acceptor& operator=(kcp_acceptor&&) noexcept = default;
+
+		/**
+		 * @brief Close the socket, all the accepted streams are broken with asio::error::connection_aborted.
+		 */
+		inline void close()
+		{
+			sessions_.close();
+		}
+
+		inline executor_type get_executor() noexcept
+		{
+			return sessions_.get_executor();
+		}
+
+		/**
+		 * @brief Get the socket, it must be used in the executor of it.
+		 */
+		inline asio::udp_socket& socket() noexcept
+		{
+			return sessions_.socket();
+		}
+
+		inline const kcp_option& get_option() const noexcept
+		{
+			return option_;
+		}
+
+		/**
+		 * @brief Accept a new conversation asynchronously.
+		 * @param token - The completion handler to invoke when the operation completes.
+		 *	  The equivalent function signature of the handler must be:
+		 *    @code
+		 *    void handler(const asio::error_code& ec, asio::kcp_stream stream);
+		 */
+		template<
+			ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, kcp_stream)) AcceptToken
+			ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(executor_type)>
+		ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(AcceptToken, void(asio::error_code, kcp_stream))
+		async_accept(AcceptToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(executor_type))
+		{
+			return asio::async_initiate<AcceptToken, void(asio::error_code, kcp_stream)>(
+				asio::detail::recycled_co_composed<void(asio::error_code, kcp_stream)>(
+					detail::async_kcp_accept_op{}, sessions_.socket()),
+				token, std::ref(*this));
+		}
+
+	protected:
+		friend struct detail::async_kcp_accept_op;
+
+		/// the whole datagram of kcp must be received, and the queue must hold a window.
+		static inline udp_sessions_option adjust(const kcp_option& opt, udp_sessions_option sopt)
+		{
+			sopt.max_datagram_size = (std::max)(sopt.max_datagram_size, std::size_t(opt.mtu));
+			sopt.queue_size        = (std::max)(sopt.queue_size, std::size_t(opt.receive_window));
+			return sopt;
+		}
+
+		/// the conv starts from a random number, so the conversations of a restarted server don't
+		/// collide with the old ones which are still alive in the clients.
+		inline std::uint32_t next_conv() noexcept
+		{
+			if (++conv_ == 0)
+				++conv_;
+			return conv_;
+		}
+
+	protected:
+		udp_server_sessions sessions_;
+
+		kcp_option          option_;
+
+		std::uint32_t       conv_;
+	};
+}
@@ -0,0 +1,741 @@
+/*
+ * Copyright (c) 2017-2023 zhllxt
+ *
+ * author   : zhllxt
+ * email    : 37792738@qq.com
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+#include <asio3/core/asio.hpp>
+#include <asio3/core/detail/type_traits.hpp>
+#include <asio3/kcp/core.hpp>
+
+namespace asio::detail
+{
+	/**
+	 * @brief The kcp arq state machine, the wire format and the algorithms are the same as
+	 * ikcp.c of https://github.com/skywind3000/kcp, in the stream mode. It does no io: the
+	 * received datagrams are passed to input(), and the datagrams to be sent are passed to the
+	 * output callback by flush(). The receiving side supports partial reads, so it can be used
+	 * as a byte stream. It interoperates with an ikcp peer which uses the stream mode.
+	 */
+	class kcp_control
+	{
+	public:
+		static constexpr std::uint32_t rto_nodelay  = 30;
+		static constexpr std::uint32_t rto_min      = 100;
+		static constexpr std::uint32_t rto_default  = 200;
+		static constexpr std::uint32_t rto_max      = 60000;
+
+		static constexpr std::uint8_t  cmd_push     = 81;
+		static constexpr std::uint8_t  cmd_ack      = 82;
+		static constexpr std::uint8_t  cmd_wask     = 83;
+		static constexpr std::uint8_t  cmd_wins     = 84;
+
+		static constexpr std::uint32_t ask_send     = 1;
+		static constexpr std::uint32_t ask_tell     = 2;
+
+		static constexpr std::uint32_t wnd_rcv      = 128;
+		static constexpr std::uint32_t overhead     = 24;
+		static constexpr std::uint32_t thresh_init  = 2;
+		static constexpr std::uint32_t thresh_min   = 2;
+		static constexpr std::uint32_t probe_init   = 7000;
+		static constexpr std::uint32_t probe_limit  = 120000;
+		static constexpr std::uint32_t fastack_limit = 5;
+
+		/// the output callback, it is called with each datagram during flush().
+		using output_type = std::function<void(const char* data, std::size_t size)>;
+
+		kcp_control(std::uint32_t conv, const kcp_option& opt, output_type output)
+			: conv_(conv), output_(std::move(output))
+		{
+			mtu_ = (std::max)(opt.mtu, std::uint32_t(50));
+			mss_ = mtu_ - overhead;
+
+			snd_wnd_ = (std::max)(opt.send_window, std::uint32_t(1));
+			rcv_wnd_ = (std::max)(opt.receive_window, wnd_rcv);
+
+			nodelay_ = opt.nodelay ? 1 : 0;
+			rx_minrto_ = opt.nodelay ? rto_nodelay : rto_min;
+
+			interval_ = std::uint32_t((std::clamp)(opt.interval.count(), std::int64_t(10), std::int64_t(5000)));
+
+			fastresend_ = opt.fast_resend;
+			nocwnd_ = !opt.congestion_control;
+
+			dead_link_ = (std::max)(opt.dead_link, std::uint32_t(1));
+
+			buffer_.resize(mtu_);
+		}
+
+		kcp_control(const kcp_control&) = delete;
+		kcp_control& operator=(const kcp_control&) = delete;
+
+		inline std::uint32_t conv() const noexcept { return conv_; }
+
+		inline std::uint32_t mss() const noexcept { return mss_; }
+
+		inline std::uint32_t interval() const noexcept { return interval_; }
+
+		inline std::uint32_t send_window() const noexcept { return snd_wnd_; }
+
+		/// a segment has been sent dead_link times without an ack.
+		inline bool is_dead() const noexcept { return dead_; }
+
+		/// the count of the segments which are not acked yet.
+		inline std::size_t waitsnd() const noexcept { return snd_buf_.size() + snd_queue_.size(); }
+
+		inline bool readable() const noexcept { return !rcv_queue_.empty(); }
+
+		/// nothing to send, nothing to ack and nothing to probe, so the flush can be skipped.
+		inline bool is_idle() const noexcept
+		{
+			return snd_buf_.empty() && snd_queue_.empty() && acklist_.empty() && probe_ == 0 && rmt_wnd_ != 0;
+		}
+
+		/// all the received data has been read, and no segment is waiting for the missing ones.
+		inline bool is_drained() const noexcept { return rcv_queue_.empty() && rcv_buf_.empty(); }
+
+		/**
+		 * @brief Queue the data to be sent, at most limit bytes.
+		 * @return the bytes queued.
+		 */
+		template<typename ConstBufferSequence>
+		std::size_t send(const ConstBufferSequence& buffers, std::size_t limit)
+		{
+			std::size_t queued = 0;
+
+			for (auto it = asio::buffer_sequence_begin(buffers); it != asio::buffer_sequence_end(buffers); ++it)
+			{
+				asio::const_buffer b(*it);
+
+				while (b.size() > 0 && queued < limit)
+				{
+					// stream mode, fill the last segment first.
+					if (snd_queue_.empty() || snd_queue_.back().data.size() >= mss_)
+						snd_queue_.emplace_back(new_segment());
+
+					segment& seg = snd_queue_.back();
+
+					std::size_t n = (std::min)({ b.size(), std::size_t(mss_) - seg.data.size(), limit - queued });
+
+					const char* p = static_cast<const char*>(b.data());
+					seg.data.insert(seg.data.end(), p, p + n);
+
+					b += n;
+					queued += n;
+				}
+			}
+
+			return queued;
+		}
+
+		/**
+		 * @brief Read the received data, it may return less than a segment.
+		 * @return the bytes read.
+		 */
+		template<typename MutableBufferSequence>
+		std::size_t recv(const MutableBufferSequence& buffers)
+		{
+			bool recover = rcv_queue_.size() >= rcv_wnd_;
+
+			std::size_t total = 0;
+
+			for (auto it = asio::buffer_sequence_begin(buffers); it != asio::buffer_sequence_end(buffers); ++it)
+			{
+				asio::mutable_buffer b(*it);
+
+				while (b.size() > 0 && !rcv_queue_.empty())
+				{
+					segment& seg = rcv_queue_.front();
+
+					std::size_t n = (std::min)(b.size(), seg.data.size() - rcv_offset_);
+
+					std::memcpy(b.data(), seg.data.data() + rcv_offset_, n);
+
+					b += n;
+					total += n;
+					rcv_offset_ += n;
+
+					if (rcv_offset_ == seg.data.size())
+					{
+						free_segment(std::move(seg));
+						rcv_queue_.pop_front();
+						rcv_offset_ = 0;
+					}
+				}
+			}
+
+			move_to_rcv_queue();
+
+			// fast recover, tell the peer the window is open again.
+			if (recover && rcv_queue_.size() < rcv_wnd_)
+				probe_ |= ask_tell;
+
+			return total;
+		}
+
+		/**
+		 * @brief Process a received datagram.
+		 * @return 0 if succeeded, negative if the datagram is invalid or of another conv.
+		 */
+		int input(const char* data, std::size_t size, std::uint32_t current)
+		{
+			current_ = current;
+
+			std::uint32_t prev_una = snd_una_;
+			std::uint32_t maxack = 0, latest_ts = 0;
+			bool flag = false;
+
+			if (size < overhead)
+				return -1;
+
+			while (size >= overhead)
+			{
+				std::uint32_t conv = get32(data);
+				std::uint8_t  cmd  = std::uint8_t(data[4]);
+				std::uint8_t  frg  = std::uint8_t(data[5]);
+				std::uint16_t wnd  = get16(data + 6);
+				std::uint32_t ts   = get32(data + 8);
+				std::uint32_t sn   = get32(data + 12);
+				std::uint32_t una  = get32(data + 16);
+				std::uint32_t len  = get32(data + 20);
+
+				detail::ignore_unused(frg);
+
+				data += overhead;
+				size -= overhead;
+
+				if (conv != conv_)
+					return -1;
+
+				if (size < len)
+					return -2;
+
+				if (cmd != cmd_push && cmd != cmd_ack && cmd != cmd_wask && cmd != cmd_wins)
+					return -3;
+
+				rmt_wnd_ = wnd;
+
+				parse_una(una);
+				shrink_buf();
+
+				if (cmd == cmd_ack)
+				{
+					if (diff(current_, ts) >= 0)
+						update_ack(diff(current_, ts));
+
+					parse_ack(sn);
+					shrink_buf();
+
+					if (!flag)
+					{
+						flag = true;
+						maxack = sn;
+						latest_ts = ts;
+					}
+					else if (diff(sn, maxack) > 0)
+					{
+						maxack = sn;
+						latest_ts = ts;
+					}
+				}
+				else if (cmd == cmd_push)
+				{
+					if (diff(sn, rcv_nxt_ + rcv_wnd_) < 0)
+					{
+						acklist_.emplace_back(sn, ts);
+
+						if (diff(sn, rcv_nxt_) >= 0)
+						{
+							segment seg = new_segment();
+							seg.sn = sn;
+							seg.data.assign(data, data + len);
+
+							parse_data(std::move(seg));
+						}
+					}
+				}
+				else if (cmd == cmd_wask)
+				{
+					probe_ |= ask_tell;
+				}
+
+				data += len;
+				size -= len;
+			}
+
+			if (flag)
+				parse_fastack(maxack, latest_ts);
+
+			if (diff(snd_una_, prev_una) > 0 && cwnd_ < rmt_wnd_)
+			{
+				if (cwnd_ < ssthresh_)
+				{
+					++cwnd_;
+					incr_ += mss_;
+				}
+				else
+				{
+					if (incr_ < mss_)
+						incr_ = mss_;
+
+					incr_ += (mss_ * mss_) / incr_ + (mss_ / 16);
+
+					if ((cwnd_ + 1) * mss_ <= incr_)
+						cwnd_ = (incr_ + mss_ - 1) / mss_;
+				}
+
+				if (cwnd_ > rmt_wnd_)
+				{
+					cwnd_ = rmt_wnd_;
+					incr_ = rmt_wnd_ * mss_;
+				}
+			}
+
+			return 0;
+		}
+
+		/**
+		 * @brief Flush at the current time, it should be called every interval while the
+		 * connection is not idle, the caller paces the flushes, see is_idle().
+		 */
+		void flush(std::uint32_t current)
+		{
+			current_ = current;
+			updated_ = true;
+
+			flush();
+		}
+
+		/**
+		 * @brief Send the acks, the window probes, and the new and the timed out segments, the
+		 * segments are packed into the datagrams of mtu bytes.
+		 */
+		void flush()
+		{
+			if (!updated_)
+				return;
+
+			char* ptr = buffer_.data();
+
+			auto output = [this, &ptr](std::size_t space) mutable
+			{
+				if (std::size_t(ptr - buffer_.data()) + space > mtu_)
+				{
+					output_(buffer_.data(), std::size_t(ptr - buffer_.data()));
+					ptr = buffer_.data();
+				}
+			};
+
+			std::uint32_t wnd = wnd_unused();
+
+			for (auto [sn, ts] : acklist_)
+			{
+				output(overhead);
+				ptr = encode(ptr, cmd_ack, wnd, ts, sn, rcv_nxt_, 0);
+			}
+
+			acklist_.clear();
+
+			// probe the window size if the remote window is zero.
+			if (rmt_wnd_ == 0)
+			{
+				if (probe_wait_ == 0)
+				{
+					probe_wait_ = probe_init;
+					ts_probe_ = current_ + probe_wait_;
+				}
+				else if (diff(current_, ts_probe_) >= 0)
+				{
+					if (probe_wait_ < probe_init)
+						probe_wait_ = probe_init;
+
+					probe_wait_ += probe_wait_ / 2;
+
+					if (probe_wait_ > probe_limit)
+						probe_wait_ = probe_limit;
+
+					ts_probe_ = current_ + probe_wait_;
+					probe_ |= ask_send;
+				}
+			}
+			else
+			{
+				ts_probe_ = 0;
+				probe_wait_ = 0;
+			}
+
+			if (probe_ & ask_send)
+			{
+				output(overhead);
+				ptr = encode(ptr, cmd_wask, wnd, 0, 0, rcv_nxt_, 0);
+			}
+
+			if (probe_ & ask_tell)
+			{
+				output(overhead);
+				ptr = encode(ptr, cmd_wins, wnd, 0, 0, rcv_nxt_, 0);
+			}
+
+			probe_ = 0;
+
+			std::uint32_t cwnd = (std::min)(snd_wnd_, rmt_wnd_);
+			if (!nocwnd_)
+				cwnd = (std::min)(cwnd_, cwnd);
+
+			// move the segments from the queue to the send buffer, in the window.
+			while (diff(snd_nxt_, snd_una_ + cwnd) < 0 && !snd_queue_.empty())
+			{
+				segment& seg = snd_buf_.emplace_back(std::move(snd_queue_.front()));
+				snd_queue_.pop_front();
+
+				seg.ts       = current_;
+				seg.sn       = snd_nxt_++;
+				seg.resendts = current_;
+				seg.rto      = rx_rto_;
+				seg.fastack  = 0;
+				seg.xmit     = 0;
+			}
+
+			std::uint32_t resent = fastresend_ > 0 ? fastresend_ : 0xffffffff;
+			std::uint32_t rtomin = nodelay_ == 0 ? (rx_rto_ >> 3) : 0;
+
+			bool change = false, lost = false;
+
+			for (segment& seg : snd_buf_)
+			{
+				bool needsend = false;
+
+				if (seg.xmit == 0)
+				{
+					needsend = true;
+					++seg.xmit;
+					seg.rto = rx_rto_;
+					seg.resendts = current_ + seg.rto + rtomin;
+				}
+				else if (diff(current_, seg.resendts) >= 0)
+				{
+					needsend = true;
+					++seg.xmit;
+
+					if (nodelay_ == 0)
+						seg.rto += (std::max)(seg.rto, rx_rto_);
+					else
+						seg.rto += (nodelay_ < 2 ? seg.rto : rx_rto_) / 2;
+
+					seg.resendts = current_ + seg.rto;
+					lost = true;
+				}
+				else if (seg.fastack >= resent)
+				{
+					if (seg.xmit <= fastack_limit)
+					{
+						needsend = true;
+						++seg.xmit;
+						seg.fastack = 0;
+						seg.resendts = current_ + seg.rto;
+						change = true;
+					}
+				}
+
+				if (needsend)
+				{
+					seg.ts = current_;
+
+					output(overhead + seg.data.size());
+
+					ptr = encode(ptr, cmd_push, wnd, seg.ts, seg.sn, rcv_nxt_, std::uint32_t(seg.data.size()));
+
+					if (!seg.data.empty())
+					{
+						std::memcpy(ptr, seg.data.data(), seg.data.size());
+						ptr += seg.data.size();
+					}
+
+					if (seg.xmit >= dead_link_)
+						dead_ = true;
+				}
+			}
+
+			if (ptr != buffer_.data())
+				output_(buffer_.data(), std::size_t(ptr - buffer_.data()));
+
+			if (change)
+			{
+				std::uint32_t inflight = snd_nxt_ - snd_una_;
+
+				ssthresh_ = (std::max)(inflight / 2, thresh_min);
+				cwnd_ = ssthresh_ + resent;
+				incr_ = cwnd_ * mss_;
+			}
+
+			if (lost)
+			{
+				ssthresh_ = (std::max)(cwnd_ / 2, thresh_min);
+				cwnd_ = 1;
+				incr_ = mss_;
+			}
+
+			if (cwnd_ < 1)
+			{
+				cwnd_ = 1;
+				incr_ = mss_;
+			}
+		}
+
+	protected:
+		struct segment
+		{
+			std::uint32_t     sn       = 0;
+			std::uint32_t     ts       = 0;
+			std::uint32_t     resendts = 0;
+			std::uint32_t     rto      = 0;
+			std::uint32_t     fastack  = 0;
+			std::uint32_t     xmit     = 0;
+			std::vector<char> data;
+		};
+
+		static inline std::int32_t diff(std::uint32_t later, std::uint32_t earlier) noexcept
+		{
+			return static_cast<std::int32_t>(later - earlier);
+		}
+
+		static inline std::uint32_t get32(const char* p) noexcept
+		{
+			return kcp_handshake::get32(p);
+		}
+
+		static inline std::uint16_t get16(const char* p) noexcept
+		{
+			return std::uint16_t(std::uint16_t(std::uint8_t(p[0])) | (std::uint16_t(std::uint8_t(p[1])) << 8));
+		}
+
+		inline char* encode(char* p, std::uint8_t cmd, std::uint32_t wnd,
+			std::uint32_t ts, std::uint32_t sn, std::uint32_t una, std::uint32_t len) const noexcept
+		{
+			kcp_handshake::put32(p, conv_);
+			p[4] = char(cmd);
+			p[5] = 0; // frg, always 0 in the stream mode
+			p[6] = char(wnd & 0xff);
+			p[7] = char((wnd >> 8) & 0xff);
+			kcp_handshake::put32(p + 8, ts);
+			kcp_handshake::put32(p + 12, sn);
+			kcp_handshake::put32(p + 16, una);
+			kcp_handshake::put32(p + 20, len);
+			return p + overhead;
+		}
+
+		/// reuse the data buffers of the released segments, so the steady state does not allocate.
+		inline segment new_segment()
+		{
+			segment seg{};
+
+			if (!free_buffers_.empty())
+			{
+				seg.data = std::move(free_buffers_.back());
+				free_buffers_.pop_back();
+			}
+			else
+			{
+				seg.data.reserve(mss_);
+			}
+
+			return seg;
+		}
+
+		inline void free_segment(segment&& seg)
+		{
+			if (free_buffers_.size() < snd_wnd_ + rcv_wnd_)
+			{
+				seg.data.clear();
+				free_buffers_.emplace_back(std::move(seg.data));
+			}
+		}
+
+		inline std::uint32_t wnd_unused() const noexcept
+		{
+			return rcv_queue_.size() < rcv_wnd_ ? std::uint32_t(rcv_wnd_ - rcv_queue_.size()) : 0;
+		}
+
+		void update_ack(std::int32_t rtt)
+		{
+			if (rx_srtt_ == 0)
+			{
+				rx_srtt_ = rtt;
+				rx_rttval_ = rtt / 2;
+			}
+			else
+			{
+				std::int32_t delta = rtt - rx_srtt_;
+				if (delta < 0)
+					delta = -delta;
+
+				rx_rttval_ = (3 * rx_rttval_ + delta) / 4;
+				rx_srtt_ = (7 * rx_srtt_ + rtt) / 8;
+
+				if (rx_srtt_ < 1)
+					rx_srtt_ = 1;
+			}
+
+			std::int64_t rto = std::int64_t(rx_srtt_) + (std::max)(std::int64_t(interval_), std::int64_t(4) * rx_rttval_);
+
+			rx_rto_ = std::uint32_t((std::clamp)(rto, std::int64_t(rx_minrto_), std::int64_t(rto_max)));
+		}
+
+		inline void shrink_buf() noexcept
+		{
+			snd_una_ = snd_buf_.empty() ? snd_nxt_ : snd_buf_.front().sn;
+		}
+
+		void parse_ack(std::uint32_t sn)
+		{
+			if (diff(sn, snd_una_) < 0 || diff(sn, snd_nxt_) >= 0)
+				return;
+
+			for (auto it = snd_buf_.begin(); it != snd_buf_.end(); ++it)
+			{
+				if (sn == it->sn)
+				{
+					free_segment(std::move(*it));
+					snd_buf_.erase(it);
+					break;
+				}
+
+				if (diff(sn, it->sn) < 0)
+					break;
+			}
+		}
+
+		void parse_una(std::uint32_t una)
+		{
+			while (!snd_buf_.empty() && diff(una, snd_buf_.front().sn) > 0)
+			{
+				free_segment(std::move(snd_buf_.front()));
+				snd_buf_.pop_front();
+			}
+		}
+
+		void parse_fastack(std::uint32_t sn, std::uint32_t ts)
+		{
+			detail::ignore_unused(ts);
+
+			if (diff(sn, snd_una_) < 0 || diff(sn, snd_nxt_) >= 0)
+				return;
+
+			for (segment& seg : snd_buf_)
+			{
+				if (diff(sn, seg.sn) < 0)
+					break;
+
+				if (sn != seg.sn)
+					++seg.fastack;
+			}
+		}
+
+		void parse_data(segment&& newseg)
+		{
+			std::uint32_t sn = newseg.sn;
+
+			if (diff(sn, rcv_nxt_ + rcv_wnd_) >= 0 || diff(sn, rcv_nxt_) < 0)
+			{
+				free_segment(std::move(newseg));
+				return;
+			}
+
+			// the rcv_buf is sorted by sn, the new segment is usually the last one.
+			auto it = rcv_buf_.end();
+			bool repeat = false;
+
+			while (it != rcv_buf_.begin())
+			{
+				auto prev = std::prev(it);
+
+				if (prev->sn == sn)
+				{
+					repeat = true;
+					break;
+				}
+
+				if (diff(sn, prev->sn) > 0)
+					break;
+
+				it = prev;
+			}
+
+			if (repeat)
+				free_segment(std::move(newseg));
+			else
+				rcv_buf_.insert(it, std::move(newseg));
+
+			move_to_rcv_queue();
+		}
+
+		inline void move_to_rcv_queue()
+		{
+			while (!rcv_buf_.empty() && rcv_buf_.front().sn == rcv_nxt_ && rcv_queue_.size() < rcv_wnd_)
+			{
+				rcv_queue_.emplace_back(std::move(rcv_buf_.front()));
+				rcv_buf_.pop_front();
+				++rcv_nxt_;
+			}
+		}
+
+	protected:
+		std::uint32_t conv_;
+
+		output_type   output_;
+
+		std::uint32_t mtu_, mss_;
+
+		std::uint32_t snd_una_ = 0, snd_nxt_ = 0, rcv_nxt_ = 0;
+
+		std::uint32_t ssthresh_ = thresh_init;
+
+		std::int32_t  rx_rttval_ = 0, rx_srtt_ = 0;
+		std::uint32_t rx_rto_ = rto_default, rx_minrto_ = rto_min;
+
+		std::uint32_t snd_wnd_, rcv_wnd_, rmt_wnd_ = wnd_rcv, cwnd_ = 0, probe_ = 0;
+
+		std::uint32_t current_ = 0, interval_ = 100;
+
+		std::uint32_t nodelay_ = 0;
+		bool          updated_ = false;
+
+		std::uint32_t ts_probe_ = 0, probe_wait_ = 0;
+
+		std::uint32_t dead_link_ = 20;
+		bool          dead_ = false;
+
+		std::uint32_t incr_ = 0;
+
+		std::uint32_t fastresend_ = 0;
+		bool          nocwnd_ = false;
+
+		std::deque<segment> snd_queue_;
+		std::deque<segment> rcv_queue_;
+		std::deque<segment> snd_buf_;
+		std::deque<segment> rcv_buf_;
+
+		/// the bytes of the front segment of the rcv_queue which are read already.
+		std::size_t   rcv_offset_ = 0;
+
+		std::vector<std::pair<std::uint32_t, std::uint32_t>> acklist_;
+
+		std::vector<std::vector<char>> free_buffers_;
+
+		std::vector<char> buffer_;
+	};
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2017-2023 zhllxt
+ *
+ * author   : zhllxt
+ * email    : 37792738@qq.com
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+
+#include <asio3/core/asio.hpp>
+#include <asio3/core/detail/netutil.hpp>
+
+namespace asio
+{
+	/**
+	 * @brief The kcp option, the defaults are the "fast mode" of kcp: nodelay, 10ms interval,
+	 * fast resend after 2 skipped acks, and no congestion control.
+	 */
+	struct kcp_option
+	{
+		/// Use the small minimum rto and the slow rto backoff of the nodelay mode.
+		bool                      nodelay            = true;
+
+		/// The interval of the flush tick, 10ms to 5000ms.
+		std::chrono::milliseconds interval           = std::chrono::milliseconds(10);
+
+		/// A segment is resent when this many later segments are acked, 0 disables fast resend.
+		std::uint32_t             fast_resend        = 2;
+
+		/// Limit the sending rate by the congestion window, otherwise only by the windows.
+		bool                      congestion_control = false;
+
+		/// The send window and the receive window, in segments.
+		std::uint32_t             send_window        = 128;
+		std::uint32_t             receive_window     = 128;
+
+		/// The maximum bytes of a datagram, include the 24 bytes kcp header.
+		std::uint32_t             mtu                = 1400;
+
+		/// The connection is broken when a segment is sent this many times without an ack.
+		std::uint32_t             dead_link          = 20;
+
+		/// The timeout of the connect handshake.
+		std::chrono::milliseconds handshake_timeout  = std::chrono::milliseconds(asio::detail::udp_handshake_timeout);
+	};
+}
+
+namespace asio::detail
+{
+	/**
+	 * The handshake datagrams are shorter than a kcp segment header, so they are never mistaken
+	 * for the kcp segments. The layout is: magic(4) type(4) conv(4), little endian.
+	 */
+	enum class kcp_handshake_type : std::uint32_t
+	{
+		syn    = 1, // client -> server, ask for a conversation
+		synack = 2, // server -> client, the conv of the new conversation
+		fin    = 3, // no more data will be sent, all the sent data is acked already
+		finack = 4, // the fin is received
+		rst    = 5, // the conversation does not exist
+	};
+
+	struct kcp_handshake
+	{
+		static constexpr std::uint32_t magic = 0x3350434b; // "KCP3"
+		static constexpr std::size_t   size  = 12;
+
+		kcp_handshake_type type;
+		std::uint32_t      conv;
+
+		static inline void put32(char* p, std::uint32_t v) noexcept
+		{
+			p[0] = char(v & 0xff);
+			p[1] = char((v >> 8) & 0xff);
+			p[2] = char((v >> 16) & 0xff);
+			p[3] = char((v >> 24) & 0xff);
+		}
+
+		static inline std::uint32_t get32(const char* p) noexcept
+		{
+			return
+				(std::uint32_t(std::uint8_t(p[0]))      ) |
+				(std::uint32_t(std::uint8_t(p[1])) <<  8) |
+				(std::uint32_t(std::uint8_t(p[2])) << 16) |
+				(std::uint32_t(std::uint8_t(p[3])) << 24);
+		}
+
+		inline void encode(char* p) const noexcept
+		{
+			put32(p + 0, magic);
+			put32(p + 4, std::uint32_t(type));
+			put32(p + 8, conv);
+		}
+
+		static inline std::optional<kcp_handshake> decode(const char* p, std::size_t n) noexcept
+		{
+			if (n != size || get32(p) != magic)
+				return std::nullopt;
+
+			std::uint32_t type = get32(p + 4);
+			if (type < std::uint32_t(kcp_handshake_type::syn) || type > std::uint32_t(kcp_handshake_type::rst))
+				return std::nullopt;
+
+			return kcp_handshake{ kcp_handshake_type(type), get32(p + 8) };
+		}
+	};
+}
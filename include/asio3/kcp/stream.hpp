@@ -0,0 +1,1099 @@
+/*
+ * Copyright (c) 2017-2023 zhllxt
+ *
+ * author   : zhllxt
+ * email    : 37792738@qq.com
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <asio3/core/asio.hpp>
+#include <asio3/core/frame_allocator.hpp>
+#include <asio3/core/resolve_cache.hpp>
+#include <asio3/core/with_deadline.hpp>
+#include <asio3/udp/core.hpp>
+#include <asio3/udp/write.hpp>
+#include <asio3/udp/server_sessions.hpp>
+#include <asio3/kcp/core.hpp>
+#include <asio3/kcp/control.hpp>
+
+namespace asio::detail
+{
+	struct async_kcp_accept_op;
+
+	/**
+	 * @brief Send a handshake datagram without blocking, it is lost if it can't be sent now,
+	 * the handshakes are resent by timers.
+	 */
+	inline void kcp_send_handshake(asio::udp_socket& sock, const asio::ip::udp::endpoint* dest,
+		kcp_handshake_type type, std::uint32_t conv)
+	{
+		char data[kcp_handshake::size];
+		kcp_handshake{ type, conv }.encode(data);
+
+		asio::const_buffer buffer(data, sizeof(data));
+
+		asio::error_code ec{};
+		detail::send_batch_nonblocking(sock, std::span<const asio::const_buffer>(&buffer, 1),
+			dest ? std::span<const asio::ip::udp::endpoint>(dest, 1) : std::span<const asio::ip::udp::endpoint>{}, ec);
+	}
+
+	struct async_kcp_connect_op
+	{
+		template<typename Impl>
+		auto operator()(auto state, std::shared_ptr<Impl> impl, std::string host, std::string port) -> void
+		{
+			state.reset_cancellation_state(asio::enable_terminal_cancellation());
+
+			if (impl->kcp_ || impl->closed_)
+				co_return{ impl->kcp_ ? asio::error::already_connected : asio::error::bad_descriptor,
+					asio::ip::udp::endpoint{} };
+
+			auto [e1, eps] = co_await asio::async_cached_resolve(impl->executor_, host, port, use_nothrow_deferred);
+			if (e1)
+				co_return{ e1, asio::ip::udp::endpoint{} };
+
+			if (!!state.cancelled() || impl->closed_)
+				co_return{ asio::error::operation_aborted, asio::ip::udp::endpoint{} };
+
+			if (eps.empty())
+				co_return{ asio::error::host_unreachable, asio::ip::udp::endpoint{} };
+
+			asio::ip::udp::endpoint dest((*eps).endpoint().address(), (*eps).endpoint().port());
+
+			asio::udp_socket& sock = *impl->socket_;
+
+			asio::error_code ec{};
+
+			sock.close(ec);
+
+			sock.open(dest.protocol(), ec);
+			if (ec)
+				co_return{ ec, asio::ip::udp::endpoint{} };
+
+			sock.connect(dest, ec);
+			if (ec)
+				co_return{ ec, asio::ip::udp::endpoint{} };
+
+			auto expiry = std::chrono::steady_clock::now() + impl->option_.handshake_timeout;
+
+			for (;;)
+			{
+				detail::kcp_send_handshake(sock, nullptr, kcp_handshake_type::syn, 0);
+
+				auto [e2, n2] = co_await sock.async_receive(asio::buffer(impl->receive_buffer_),
+					asio::with_deadline(use_nothrow_deferred, (std::min)(expiry,
+						std::chrono::steady_clock::now() + std::chrono::milliseconds(Impl::handshake_interval))));
+
+				if (!!state.cancelled() || impl->closed_)
+					co_return{ asio::error::operation_aborted, asio::ip::udp::endpoint{} };
+
+				if (e2 == asio::error::timed_out)
+				{
+					if (std::chrono::steady_clock::now() >= expiry)
+					{
+						sock.close(ec);
+						co_return{ asio::error::timed_out, asio::ip::udp::endpoint{} };
+					}
+
+					continue;
+				}
+
+				if (e2)
+				{
+					sock.close(ec);
+					co_return{ e2, asio::ip::udp::endpoint{} };
+				}
+
+				std::optional<kcp_handshake> hs = kcp_handshake::decode(impl->receive_buffer_.data(), n2);
+				if (!hs)
+					continue;
+
+				if (hs->type == kcp_handshake_type::synack)
+				{
+					impl->start(hs->conv);
+					co_return{ asio::error_code{}, dest };
+				}
+
+				if (hs->type == kcp_handshake_type::rst)
+				{
+					sock.close(ec);
+					co_return{ asio::error::connection_refused, asio::ip::udp::endpoint{} };
+				}
+			}
+		}
+	};
+
+	struct async_kcp_read_op
+	{
+		template<typename Impl, typename MutableBufferSequence>
+		auto operator()(auto state, std::shared_ptr<Impl> impl, MutableBufferSequence buffers) -> void
+		{
+			state.reset_cancellation_state(asio::enable_terminal_cancellation());
+
+			std::size_t seq = impl->cancel_seq_;
+
+			// the data is usually queued already, but the handler is never invoked inside the initiating
+			// function, otherwise a read loop would recurse without bound.
+			bool suspended = false;
+
+			for (;;)
+			{
+				asio::error_code ec{};
+				std::size_t n = impl->read_some(buffers, ec);
+				if (ec != asio::error::would_block)
+				{
+					if (!suspended)
+						co_await asio::detail::async_yield(state);
+
+					co_return{ ec, n };
+				}
+
+				impl->read_waiting_ = true;
+
+				impl->read_notifier_.expires_at((asio::steady_timer::time_point::max)());
+
+				co_await impl->read_notifier_.async_wait(use_nothrow_deferred);
+
+				suspended = true;
+
+				impl->read_waiting_ = false;
+
+				if (!!state.cancelled() || impl->cancel_seq_ != seq)
+					co_return{ asio::error::operation_aborted, 0 };
+			}
+		}
+	};
+
+	struct async_kcp_write_op
+	{
+		template<typename Impl, typename ConstBufferSequence>
+		auto operator()(auto state, std::shared_ptr<Impl> impl, ConstBufferSequence buffers) -> void
+		{
+			state.reset_cancellation_state(asio::enable_terminal_cancellation());
+
+			std::size_t seq = impl->cancel_seq_;
+
+			// never complete inside the initiating function, see async_kcp_read_op.
+			bool suspended = false;
+
+			for (;;)
+			{
+				asio::error_code ec{};
+				std::size_t n = impl->write_some(buffers, ec);
+				if (ec != asio::error::would_block)
+				{
+					if (!suspended)
+						co_await asio::detail::async_yield(state);
+
+					co_return{ ec, n };
+				}
+
+				impl->write_waiting_ = true;
+
+				impl->write_notifier_.expires_at((asio::steady_timer::time_point::max)());
+
+				co_await impl->write_notifier_.async_wait(use_nothrow_deferred);
+
+				suspended = true;
+
+				impl->write_waiting_ = false;
+
+				if (!!state.cancelled() || impl->cancel_seq_ != seq)
+					co_return{ asio::error::operation_aborted, 0 };
+			}
+		}
+	};
+
+	/**
+	 * The connection state of a kcp_stream, all the members are accessed in the executor of the
+	 * transport only. The client side owns a connected udp socket, the server side receives by
+	 * a udp_session and sends by the shared server socket.
+	 * The receiving is a loop of one datagram each time, and the flush is a timer of the kcp
+	 * interval, it is stopped when there is nothing to send, to ack or to probe, and restarted
+	 * by the write, the input and the close. The datagrams of one flush are sent by one batch.
+	 */
+	class kcp_stream_impl : public std::enable_shared_from_this<kcp_stream_impl>
+	{
+	public:
+		using executor_type = asio::udp_socket::executor_type;
+
+		/// the interval of resending the syn and the fin, in milliseconds.
+		static constexpr std::uint32_t handshake_interval = 200;
+
+		enum class fin_state { none, pending, sent, acked };
+
+		/// the client side, the socket is opened by the connect.
+		kcp_stream_impl(const executor_type& ex, const kcp_option& opt)
+			: executor_(ex)
+			, option_(opt)
+			, socket_(std::in_place, ex)
+			, read_notifier_(ex)
+			, write_notifier_(ex)
+			, ticker_(ex)
+			, receive_buffer_((std::max)(opt.mtu, std::uint32_t(kcp_control::overhead)))
+		{
+		}
+
+		/// the server side, the conversation is accepted already.
+		kcp_stream_impl(std::shared_ptr<udp_session> session, const kcp_option& opt)
+			: executor_(session->get_executor())
+			, option_(opt)
+			, session_(std::move(session))
+			, read_notifier_(executor_)
+			, write_notifier_(executor_)
+			, ticker_(executor_)
+			, receive_buffer_((std::max)(opt.mtu, std::uint32_t(kcp_control::overhead)))
+		{
+		}
+
+		kcp_stream_impl(const kcp_stream_impl&) = delete;
+		kcp_stream_impl& operator=(const kcp_stream_impl&) = delete;
+
+		inline const executor_type& get_executor() const noexcept { return executor_; }
+
+		inline bool is_open() const noexcept { return kcp_.has_value() && !closed_ && !stopped_; }
+
+		inline std::uint32_t conv() const noexcept { return kcp_ ? kcp_->conv() : 0; }
+
+		asio::ip::udp::endpoint remote_endpoint(asio::error_code& ec) const
+		{
+			ec = {};
+
+			if (session_)
+				return session_->remote_endpoint();
+
+			return socket_->remote_endpoint(ec);
+		}
+
+		asio::ip::udp::endpoint local_endpoint(asio::error_code& ec) const
+		{
+			if (session_)
+				return session_->socket().local_endpoint(ec);
+
+			return socket_->local_endpoint(ec);
+		}
+
+		/**
+		 * @brief Start the conversation, it is called when the handshake is done.
+		 */
+		void start(std::uint32_t conv)
+		{
+			kcp_.emplace(conv, option_, [this](const char* data, std::size_t size)
+			{
+				output_storage_.insert(output_storage_.end(), data, data + size);
+				output_sizes_.emplace_back(size);
+			});
+
+			this->receive();
+		}
+
+		void send_handshake(kcp_handshake_type type, std::uint32_t conv)
+		{
+			if (session_)
+				detail::kcp_send_handshake(session_->socket(), std::addressof(session_->remote_endpoint()), type, conv);
+			else
+				detail::kcp_send_handshake(*socket_, nullptr, type, conv);
+		}
+
+		/**
+		 * @brief Send a fin when all the sent data is acked, the received data can still be read.
+		 */
+		void shutdown_send()
+		{
+			if (!kcp_ || stopped_ || fin_ != fin_state::none)
+				return;
+
+			fin_ = fin_state::pending;
+
+			this->wake_writer();
+			this->ensure_ticking();
+		}
+
+		/**
+		 * @brief Discard the received data, the read completes with asio::error::eof.
+		 */
+		void shutdown_receive()
+		{
+			receive_shutdown_ = true;
+
+			this->discard_received();
+			this->wake_reader();
+		}
+
+		void cancel()
+		{
+			++cancel_seq_;
+
+			this->wake_reader();
+			this->wake_writer();
+		}
+
+		/**
+		 * @brief Abort the pending operations, and close the conversation gracefully in background.
+		 */
+		void close()
+		{
+			if (closed_)
+				return;
+
+			closed_ = true;
+
+			this->wake_reader();
+			this->wake_writer();
+
+			if (!kcp_)
+			{
+				this->stop();
+				return;
+			}
+
+			if (stopped_)
+				return;
+
+			if (fin_ == fin_state::none)
+				fin_ = fin_state::pending;
+
+			this->discard_received();
+			this->ensure_ticking();
+			this->check_closed();
+		}
+
+	protected:
+		friend struct async_kcp_connect_op;
+		friend struct async_kcp_read_op;
+		friend struct async_kcp_write_op;
+
+		static inline std::uint32_t now_ms() noexcept
+		{
+			return static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+
+		static inline bool reached(std::uint32_t now, std::uint32_t ts) noexcept
+		{
+			return static_cast<std::int32_t>(now - ts) >= 0;
+		}
+
+		template<typename MutableBufferSequence>
+		std::size_t read_some(const MutableBufferSequence& buffers, asio::error_code& ec)
+		{
+			if (!kcp_)
+			{
+				ec = closed_ ? asio::error::bad_descriptor : asio::error::not_connected;
+				return 0;
+			}
+
+			if (closed_)
+			{
+				ec = asio::error::operation_aborted;
+				return 0;
+			}
+
+			if (asio::buffer_size(buffers) == 0)
+				return 0;
+
+			if (std::size_t n = kcp_->recv(buffers); n > 0)
+			{
+				// the window may be opened again, it is told to the peer by the next flush.
+				this->ensure_ticking();
+				return n;
+			}
+
+			if (error_)
+				ec = error_;
+			else if (receive_shutdown_ || (peer_fin_ && kcp_->is_drained()))
+				ec = asio::error::eof;
+			else
+				ec = asio::error::would_block;
+
+			return 0;
+		}
+
+		template<typename ConstBufferSequence>
+		std::size_t write_some(const ConstBufferSequence& buffers, asio::error_code& ec)
+		{
+			if (!kcp_)
+			{
+				ec = closed_ ? asio::error::bad_descriptor : asio::error::not_connected;
+				return 0;
+			}
+
+			if (closed_)
+			{
+				ec = asio::error::operation_aborted;
+				return 0;
+			}
+
+			if (error_)
+			{
+				ec = error_;
+				return 0;
+			}
+
+			if (fin_ != fin_state::none)
+			{
+				ec = asio::error::shut_down;
+				return 0;
+			}
+
+			if (asio::buffer_size(buffers) == 0)
+				return 0;
+
+			// queue at most two windows, so the writer is paced by the acks.
+			std::size_t limit = std::size_t(kcp_->send_window()) * 2;
+			if (kcp_->waitsnd() >= limit)
+			{
+				ec = asio::error::would_block;
+				return 0;
+			}
+
+			std::size_t n = kcp_->send(buffers, (limit - kcp_->waitsnd()) * kcp_->mss());
+
+			this->ensure_ticking();
+
+			return n;
+		}
+
+		inline bool writable() const noexcept
+		{
+			return kcp_->waitsnd() < std::size_t(kcp_->send_window()) * 2;
+		}
+
+		inline void wake_reader() noexcept
+		{
+			if (read_waiting_)
+			{
+				read_waiting_ = false;
+				asio::detail::cancel_timer(read_notifier_);
+			}
+		}
+
+		inline void wake_writer() noexcept
+		{
+			if (write_waiting_)
+			{
+				write_waiting_ = false;
+				asio::detail::cancel_timer(write_notifier_);
+			}
+		}
+
+		void discard_received()
+		{
+			if (!kcp_)
+				return;
+
+			while (kcp_->recv(asio::buffer(receive_buffer_)) > 0);
+		}
+
+		void receive()
+		{
+			auto handler = [self = this->shared_from_this()](const asio::error_code& ec, std::size_t n) mutable
+			{
+				self->on_receive(ec, n);
+			};
+
+			if (session_)
+				session_->async_receive(asio::buffer(receive_buffer_), std::move(handler));
+			else
+				socket_->async_receive(asio::buffer(receive_buffer_), std::move(handler));
+		}
+
+		void on_receive(const asio::error_code& ec, std::size_t n)
+		{
+			if (stopped_)
+				return;
+
+			// an icmp port unreachable is reported to the connected socket, the conversation is
+			// not broken by it, the dead link detects a peer which is gone.
+			if (ec == asio::error::connection_refused)
+			{
+				this->receive();
+				return;
+			}
+
+			if (ec)
+			{
+				this->fail(ec == asio::error::operation_aborted ? asio::error::connection_aborted : ec);
+				return;
+			}
+
+			if (n < kcp_control::overhead)
+			{
+				this->on_handshake(n);
+			}
+			else if (kcp_->input(receive_buffer_.data(), n, now_ms()) == 0)
+			{
+				if (closed_ || receive_shutdown_)
+					this->discard_received();
+				else if (kcp_->readable())
+					this->wake_reader();
+
+				if (writable())
+					this->wake_writer();
+
+				this->ensure_ticking();
+			}
+
+			if (!stopped_)
+				this->receive();
+		}
+
+		void on_handshake(std::size_t n)
+		{
+			std::optional<kcp_handshake> hs = kcp_handshake::decode(receive_buffer_.data(), n);
+			if (!hs)
+				return;
+
+			// the synack was lost, the client is still connecting.
+			if (hs->type == kcp_handshake_type::syn)
+			{
+				if (session_)
+					this->send_handshake(kcp_handshake_type::synack, kcp_->conv());
+				return;
+			}
+
+			if (hs->conv != kcp_->conv())
+				return;
+
+			switch (hs->type)
+			{
+			case kcp_handshake_type::fin:
+				peer_fin_ = true;
+				this->send_handshake(kcp_handshake_type::finack, kcp_->conv());
+				this->wake_reader();
+				this->check_closed();
+				break;
+			case kcp_handshake_type::finack:
+				if (fin_ == fin_state::sent)
+				{
+					fin_ = fin_state::acked;
+					this->check_closed();
+				}
+				break;
+			case kcp_handshake_type::rst:
+				// the peer is closed already, so the fin needs no ack.
+				if (fin_ == fin_state::sent || fin_ == fin_state::acked)
+				{
+					fin_ = fin_state::acked;
+					peer_fin_ = true;
+					this->check_closed();
+				}
+				else
+				{
+					this->fail(asio::error::connection_reset);
+				}
+				break;
+			default:
+				break;
+			}
+		}
+
+		void ensure_ticking()
+		{
+			if (ticking_ || stopped_ || !kcp_)
+				return;
+
+			ticking_ = true;
+
+			// flush at once, the writes of the current handler are sent by one flush.
+			ticker_.expires_after(std::chrono::steady_clock::duration::zero());
+			ticker_.async_wait([self = this->shared_from_this()](const asio::error_code& ec) mutable
+			{
+				self->on_tick(ec);
+			});
+		}
+
+		void on_tick(const asio::error_code& ec)
+		{
+			if (ec || stopped_)
+			{
+				ticking_ = false;
+				return;
+			}
+
+			std::uint32_t now = now_ms();
+
+			kcp_->flush(now);
+
+			this->send_output();
+
+			if (kcp_->is_dead())
+			{
+				ticking_ = false;
+				this->fail(asio::error::timed_out);
+				return;
+			}
+
+			this->process_fin(now);
+
+			if (stopped_)
+			{
+				ticking_ = false;
+				return;
+			}
+
+			if (write_waiting_ && writable())
+				this->wake_writer();
+
+			if (kcp_->is_idle() && (fin_ == fin_state::none || (fin_ == fin_state::acked && !closed_)))
+			{
+				ticking_ = false;
+				return;
+			}
+
+			ticker_.expires_after(option_.interval);
+			ticker_.async_wait([self = this->shared_from_this()](const asio::error_code& ec) mutable
+			{
+				self->on_tick(ec);
+			});
+		}
+
+		void process_fin(std::uint32_t now)
+		{
+			if (fin_ == fin_state::pending && kcp_->waitsnd() == 0)
+			{
+				fin_ = fin_state::sent;
+				fin_xmit_ = 0;
+				fin_resend_ = now;
+			}
+
+			if (fin_ == fin_state::sent && reached(now, fin_resend_))
+			{
+				if (fin_xmit_++ >= option_.dead_link)
+				{
+					this->fail(asio::error::timed_out);
+					return;
+				}
+
+				this->send_handshake(kcp_handshake_type::fin, kcp_->conv());
+
+				fin_resend_ = now + handshake_interval;
+
+				// after closed, wait the fin of the peer for a while, like the FIN_WAIT_2 of tcp.
+				linger_until_ = now + handshake_interval * option_.dead_link;
+			}
+
+			if (closed_ && fin_ == fin_state::acked && reached(now, linger_until_))
+				this->stop();
+		}
+
+		void check_closed()
+		{
+			if (closed_ && fin_ == fin_state::acked && peer_fin_)
+				this->stop();
+		}
+
+		void send_output()
+		{
+			if (output_sizes_.empty())
+				return;
+
+			output_buffers_.clear();
+
+			const char* p = output_storage_.data();
+			for (std::size_t n : output_sizes_)
+			{
+				output_buffers_.emplace_back(p, n);
+				p += n;
+			}
+
+			// the datagrams which can't be sent now are lost, they are resent by kcp.
+			asio::error_code ec{};
+			if (session_)
+				detail::send_batch_nonblocking(session_->socket(), std::span<const asio::const_buffer>(output_buffers_),
+					std::span<const asio::ip::udp::endpoint>(std::addressof(session_->remote_endpoint()), 1), ec);
+			else
+				detail::send_batch_nonblocking(*socket_, std::span<const asio::const_buffer>(output_buffers_),
+					std::span<const asio::ip::udp::endpoint>{}, ec);
+
+			output_storage_.clear();
+			output_sizes_.clear();
+		}
+
+		void fail(const asio::error_code& ec)
+		{
+			if (stopped_)
+				return;
+
+			error_ = ec;
+
+			this->stop();
+		}
+
+		void stop()
+		{
+			if (stopped_)
+				return;
+
+			stopped_ = true;
+
+			ticker_.cancel();
+
+			asio::error_code ec{};
+			if (socket_)
+				socket_->close(ec);
+			if (session_)
+				session_->close();
+
+			this->wake_reader();
+			this->wake_writer();
+		}
+
+	protected:
+		executor_type                             executor_;
+
+		kcp_option                                option_;
+
+		std::optional<asio::udp_socket>           socket_;
+
+		std::shared_ptr<udp_session>              session_;
+
+		std::optional<kcp_control>                kcp_;
+
+		/// canceled when the data is received, the window is opened, or the stream is closed.
+		asio::steady_timer                        read_notifier_;
+		asio::steady_timer                        write_notifier_;
+
+		/// the flush timer, the timing wheel is too coarse for the interval of kcp.
+		asio::steady_timer                        ticker_;
+
+		std::vector<char>                         receive_buffer_;
+
+		/// the datagrams of one flush, they are sent by one batch.
+		std::vector<char>                         output_storage_;
+		std::vector<std::size_t>                  output_sizes_;
+		std::vector<asio::const_buffer>           output_buffers_;
+
+		asio::error_code                          error_{};
+
+		fin_state                                 fin_ = fin_state::none;
+		std::uint32_t                             fin_xmit_ = 0, fin_resend_ = 0, linger_until_ = 0;
+
+		/// the pending read and write are aborted when it is changed by cancel().
+		std::size_t                               cancel_seq_ = 0;
+
+		bool                                      peer_fin_         = false;
+		bool                                      receive_shutdown_ = false;
+		bool                                      read_waiting_     = false;
+		bool                                      write_waiting_    = false;
+		bool                                      ticking_          = false;
+		bool                                      closed_           = false;
+		bool                                      stopped_          = false;
+	};
+}
+
+namespace asio
+{
+	/**
+	 * @brief A reliable byte stream over udp by the kcp arq, it is used like a tcp socket: the
+	 * client connects by async_connect, and the server accepts by asio::kcp_acceptor. The data is
+	 * flushed every kcp_option::interval while there is anything to send, so the latency is lower
+	 * than tcp on a lossy link at the cost of more bandwidth.
+	 * The conversation is closed by a fin which is sent after all the data is acked, the read of
+	 * the peer completes with asio::error::eof then. close() returns immediately, and the data
+	 * written before it is still delivered in background.
+	 * All the functions must be called in the executor, which must be a strand or a single
+	 * threaded io_context.
+	 * @eg:
+	 * asio::kcp_stream stream(ctx);
+	 * auto [e1, ep] = co_await stream.async_connect("127.0.0.1", 8036);
+	 * auto [e2, n2] = co_await asio::async_write(stream, asio::buffer(data));
+	 * auto [e3, n3] = co_await stream.async_read_some(asio::buffer(buf));
+	 */
+	class kcp_stream
+	{
+	public:
+		using executor_type = asio::udp_socket::executor_type;
+
+		using lowest_layer_type = kcp_stream;
+
+		kcp_stream() = default;
+
+		explicit kcp_stream(const executor_type& ex, const kcp_option& opt = {})
+			: impl_(std::make_shared<detail::kcp_stream_impl>(ex, opt))
+		{
+		}
+
+		template<typename ExecutionContext>
+		requires std::is_convertible_v<ExecutionContext&, asio::execution_context&>
+		explicit kcp_stream(ExecutionContext& ctx, const kcp_option& opt = {})
+			: kcp_stream(executor_type(ctx.get_executor()), opt)
+		{
+		}
+
+		kcp_stream(kcp_stream&&) noexcept = default;
+
+		kcp_stream& operator=(kcp_stream&& other) noexcept
+		{
+			if (this != std::addressof(other))
+			{
+				close();
+				impl_ = std::move(other.impl_);
+			}
+			return *this;
+		}
+
+		~kcp_stream()
+		{
+			close();
+		}
+
+		inline executor_type get_executor() noexcept
+		{
+			return impl_->get_executor();
+		}
+
+		inline lowest_layer_type& lowest_layer() noexcept
+		{
+			return *this;
+		}
+
+		inline const lowest_layer_type& lowest_layer() const noexcept
+		{
+			return *this;
+		}
+
+		/**
+		 * @brief Whether the conversation is established, and neither closed nor broken.
+		 */
+		inline bool is_open() const noexcept
+		{
+			return impl_ && impl_->is_open();
+		}
+
+		/**
+		 * @brief The conversation id, 0 if it is not connected.
+		 */
+		inline std::uint32_t conv() const noexcept
+		{
+			return impl_ ? impl_->conv() : 0;
+		}
+
+		inline asio::ip::udp::endpoint remote_endpoint() const
+		{
+			asio::error_code ec{};
+			asio::ip::udp::endpoint ep = remote_endpoint(ec);
+			asio::detail::throw_error(ec, "remote_endpoint");
+			return ep;
+		}
+
+		inline asio::ip::udp::endpoint remote_endpoint(asio::error_code& ec) const
+		{
+			if (!impl_)
+			{
+				ec = asio::error::bad_descriptor;
+				return {};
+			}
+			return impl_->remote_endpoint(ec);
+		}
+
+		inline asio::ip::udp::endpoint local_endpoint() const
+		{
+			asio::error_code ec{};
+			asio::ip::udp::endpoint ep = local_endpoint(ec);
+			asio::detail::throw_error(ec, "local_endpoint");
+			return ep;
+		}
+
+		inline asio::ip::udp::endpoint local_endpoint(asio::error_code& ec) const
+		{
+			if (!impl_)
+			{
+				ec = asio::error::bad_descriptor;
+				return {};
+			}
+			return impl_->local_endpoint(ec);
+		}
+
+		/**
+		 * @brief Abort the pending operations, and close the conversation gracefully in background:
+		 * the fin is sent after the written data is acked, and the data received later is discarded.
+		 * It can be called in any thread.
+		 */
+		inline void close()
+		{
+			if (impl_)
+			{
+				asio::dispatch(impl_->get_executor(), [impl = impl_]() mutable
+				{
+					impl->close();
+				});
+			}
+		}
+
+		inline void close(asio::error_code& ec)
+		{
+			ec = {};
+			close();
+		}
+
+		/**
+		 * @brief Abort the pending read and write, they complete with asio::error::operation_aborted.
+		 */
+		inline void cancel()
+		{
+			asio::error_code ec{};
+			cancel(ec);
+			asio::detail::throw_error(ec, "cancel");
+		}
+
+		inline void cancel(asio::error_code& ec)
+		{
+			if (!impl_)
+			{
+				ec = asio::error::bad_descriptor;
+				return;
+			}
+
+			ec = {};
+			impl_->cancel();
+		}
+
+		/**
+		 * @brief The shutdown_send sends a fin after the written data is acked, the read of the
+		 * peer completes with asio::error::eof then, and the later writes of this side fail with
+		 * asio::error::shut_down. The shutdown_receive discards the received data.
+		 */
+		inline void shutdown(asio::socket_base::shutdown_type what)
+		{
+			asio::error_code ec{};
+			shutdown(what, ec);
+			asio::detail::throw_error(ec, "shutdown");
+		}
+
+		inline void shutdown(asio::socket_base::shutdown_type what, asio::error_code& ec)
+		{
+			if (!impl_ || !impl_->is_open())
+			{
+				ec = impl_ && impl_->conv() ? asio::error::bad_descriptor : asio::error::not_connected;
+				return;
+			}
+
+			ec = {};
+
+			if (what == asio::socket_base::shutdown_send || what == asio::socket_base::shutdown_both)
+				impl_->shutdown_send();
+
+			if (what == asio::socket_base::shutdown_receive || what == asio::socket_base::shutdown_both)
+				impl_->shutdown_receive();
+		}
+
+		/**
+		 * @brief Connect to the server asynchronously, it resends the syn every 200 milliseconds
+		 * until the server replies, or the kcp_option::handshake_timeout expires.
+		 * @param host - The ip address or the domain of the server.
+		 * @param port - The port of the server.
+		 * @param token - The completion handler to invoke when the operation completes.
+		 *	  The equivalent function signature of the handler must be:
+		 *    @code
+		 *    void handler(const asio::error_code& ec, asio::ip::udp::endpoint ep);
+		 */
+		template<
+			typename String, typename StrOrInt,
+			ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, asio::ip::udp::endpoint)) ConnectToken
+			ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(executor_type)>
+		requires
+			(std::constructible_from<std::string, String> &&
+			(std::constructible_from<std::string, StrOrInt> || std::integral<std::remove_cvref_t<StrOrInt>>))
+		ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(ConnectToken, void(asio::error_code, asio::ip::udp::endpoint))
+		async_connect(
+			String&& host, StrOrInt&& port,
+			ConnectToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(executor_type))
+		{
+			return asio::async_initiate<ConnectToken, void(asio::error_code, asio::ip::udp::endpoint)>(
+				asio::detail::recycled_co_composed<void(asio::error_code, asio::ip::udp::endpoint)>(
+					detail::async_kcp_connect_op{}, impl_->get_executor()),
+				token, impl_,
+				asio::to_string(std::forward<String>(host)), asio::to_string(std::forward<StrOrInt>(port)));
+		}
+
+		/**
+		 * @brief Connect to the server endpoint asynchronously.
+		 * @param ep - The endpoint of the server.
+		 * @param token - The completion handler to invoke when the operation completes.
+		 *	  The equivalent function signature of the handler must be:
+		 *    @code
+		 *    void handler(const asio::error_code& ec, asio::ip::udp::endpoint ep);
+		 */
+		template<
+			ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, asio::ip::udp::endpoint)) ConnectToken
+			ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(executor_type)>
+		ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(ConnectToken, void(asio::error_code, asio::ip::udp::endpoint))
+		async_connect(
+			const asio::ip::udp::endpoint& ep,
+			ConnectToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(executor_type))
+		{
+			return async_connect(ep.address().to_string(), ep.port(), std::forward<ConnectToken>(token));
+		}
+
+		/**
+		 * @brief Read some data asynchronously.
+		 * @param token - The completion handler to invoke when the operation completes.
+		 *	  The equivalent function signature of the handler must be:
+		 *    @code
+		 *    void handler(const asio::error_code& ec, std::size_t bytes_transferred);
+		 *    The ec is asio::error::eof when the peer has shutdown the sending and all the data
+		 *    is read, asio::error::timed_out when the peer does not ack for kcp_option::dead_link
+		 *    times, asio::error::connection_reset when the conversation is unknown to the peer.
+		 */
+		template<typename MutableBufferSequence,
+			ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, std::size_t)) ReadToken
+			ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(executor_type)>
+		ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(ReadToken, void(asio::error_code, std::size_t))
+		async_read_some(
+			const MutableBufferSequence& buffers,
+			ReadToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(executor_type))
+		{
+			return asio::async_initiate<ReadToken, void(asio::error_code, std::size_t)>(
+				asio::detail::recycled_co_composed<void(asio::error_code, std::size_t)>(
+					detail::async_kcp_read_op{}, impl_->get_executor()),
+				token, impl_, buffers);
+		}
+
+		/**
+		 * @brief Write some data asynchronously, it completes when the data is queued, at most two
+		 * send windows are queued, so it waits for the acks when the peer is slow.
+		 * @param token - The completion handler to invoke when the operation completes.
+		 *	  The equivalent function signature of the handler must be:
+		 *    @code
+		 *    void handler(const asio::error_code& ec, std::size_t bytes_transferred);
+		 */
+		template<typename ConstBufferSequence,
+			ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, std::size_t)) WriteToken
+			ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(executor_type)>
+		ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(WriteToken, void(asio::error_code, std::size_t))
+		async_write_some(
+			const ConstBufferSequence& buffers,
+			WriteToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(executor_type))
+		{
+			return asio::async_initiate<WriteToken, void(asio::error_code, std::size_t)>(
+				asio::detail::recycled_co_composed<void(asio::error_code, std::size_t)>(
+					detail::async_kcp_write_op{}, impl_->get_executor()),
+				token, impl_, buffers);
+		}
+
+	protected:
+		friend struct detail::async_kcp_accept_op;
+
+		explicit kcp_stream(std::shared_ptr<detail::kcp_stream_impl> impl) noexcept
+			: impl_(std::move(impl))
+		{
+		}
+
+	protected:
+		std::shared_ptr<detail::kcp_stream_impl> impl_;
+	};
+}
@@ -14,6 +14,8 @@
 #pragma once
 
 #include <asio3/core/error.hpp>
+#include <asio3/core/frame_allocator.hpp>
+#include <asio3/core/resolve_cache.hpp>
 #include <asio3/core/detail/netutil.hpp>
 
 #include <asio3/socks5/core.hpp>
@@ -390,8 +392,8 @@ namespace asio::socks5::detail
 
 				std::string str_port = std::to_string(dst_port);
 
-				asio::ip::tcp::resolver resolver(sock.get_executor());
-				auto [er, eps] = co_await resolver.async_resolve(dst_addr, str_port, use_nothrow_deferred);
+				auto [er, eps] = co_await asio::async_cached_resolve(
+					sock.get_executor(), dst_addr, str_port, use_nothrow_deferred);
 				if (er || eps.empty())
 				{
 					urep = std::uint8_t(socks5::connect_result::host_unreachable);
@@ -400,7 +402,8 @@ namespace asio::socks5::detail
 				else
 				{
 					connect_socket_t bnd_socket(sock.get_executor());
-					auto [ed, ep] = co_await asio::async_connect(bnd_socket, eps, use_nothrow_deferred);
+					auto [ed, ep] = co_await asio::async_race_connect(
+						bnd_socket, eps, asio::detail::default_set_option_callback{}, use_nothrow_deferred);
 
 					if (!ed)
 					{
@@ -440,8 +443,8 @@ namespace asio::socks5::detail
 				{
 					std::string str_port = std::to_string(dst_port);
 
-					asio::ip::udp::resolver resolver(sock.get_executor());
-					auto [er, eps] = co_await resolver.async_resolve(dst_addr, str_port, use_nothrow_deferred);
+					auto [er, eps] = co_await asio::async_cached_resolve(
+						sock.get_executor(), dst_addr, str_port, use_nothrow_deferred);
 					if (!er && !eps.empty())
 					{
 						if ((*eps).endpoint().address().is_v6())
@@ -548,7 +551,7 @@ namespace asio::socks5
 		AcceptToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(typename AsyncStream::executor_type))
 	{
 		return asio::async_initiate<AcceptToken, void(asio::error_code, socks5::handshake_info)>(
-			asio::experimental::co_composed<void(asio::error_code, socks5::handshake_info)>(
+			asio::detail::recycled_co_composed<void(asio::error_code, socks5::handshake_info)>(
 				detail::async_accept_op{}, sock),
 			token, std::ref(sock), std::ref(auth_cfg));
 	}
@@ -15,6 +15,7 @@
 #pragma once
 
 #include <asio3/core/error.hpp>
+#include <asio3/core/frame_allocator.hpp>
 #include <asio3/core/detail/netutil.hpp>
 
 #include <asio3/socks5/core.hpp>
@@ -512,7 +513,7 @@ namespace asio::socks5
 		HandshakeToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(typename tcp_socket::executor_type))
 	{
 		return asio::async_initiate<HandshakeToken, void(asio::error_code)>(
-			asio::experimental::co_composed<void(asio::error_code)>(
+			asio::detail::recycled_co_composed<void(asio::error_code)>(
 				detail::async_handshake_op{}, sock),
 			token, std::ref(sock), std::ref(sock5_opt));
 	}
@@ -14,7 +14,9 @@
 #include <tuple>
 
 #include <asio3/socks5/core.hpp>
+#include <asio3/socks5/error.hpp>
 #include <asio3/core/detail/netutil.hpp>
+#include <asio3/tcp/frame.hpp>
 
 namespace asio::socks5
 {
@@ -23,7 +25,7 @@ namespace
 	using iterator = asio::buffers_iterator<asio::streambuf::const_buffers_type>;
 	using diff_type = typename iterator::difference_type;
 
-	std::pair<iterator, bool> udp_match_condition(iterator begin, iterator end) noexcept
+	inline std::pair<iterator, bool> udp_match_condition(iterator begin, iterator end) noexcept
 	{
 		// +----+------+------+----------+----------+----------+
 		// |RSV | FRAG | ATYP | DST.ADDR | DST.PORT |   DATA   |
@@ -36,8 +38,9 @@ namespace
 			if (end - p < static_cast<diff_type>(5))
 				break;
 
-			std::uint16_t data_size = asio::detail::network_to_host(
-				std::uint16_t(*(reinterpret_cast<const std::uint16_t*>(p.operator->()))));
+			// the data may be unaligned, read it by memcpy.
+			const char* q = p.operator->();
+			std::uint16_t data_size = asio::detail::read<std::uint16_t>(q);
 
 			std::uint8_t atyp = std::uint8_t(p[3]);
 
@@ -61,4 +64,45 @@ namespace
 		return std::pair(begin, false);
 	}
 }
+
+	/**
+	 * @brief The framing of the udp over tcp extension packet, used with asio::async_read_frame.
+	 * The payload of the frame is the whole packet, include the header.
+	 */
+	struct udp_framing
+	{
+		inline frame_view parse(std::string_view data, asio::error_code& ec) const noexcept
+		{
+			ec = {};
+
+			if (data.size() < std::size_t(5))
+				return {};
+
+			// the data may be unaligned, read it by memcpy.
+			const char* p = data.data();
+			std::uint16_t data_size = asio::detail::read<std::uint16_t>(p);
+
+			std::uint8_t atyp = std::uint8_t(data[3]);
+
+			std::size_t need = 0;
+
+			// ATYP
+			if /**/ (atyp == std::uint8_t(0x01))
+				need = std::size_t(2 + 1 + 1 + 4 + 2 + data_size);
+			else if (atyp == std::uint8_t(0x03))
+				need = std::size_t(2 + 1 + 1 + 1 + std::uint8_t(data[4]) + 2 + data_size);
+			else if (atyp == std::uint8_t(0x04))
+				need = std::size_t(2 + 1 + 1 + 16 + 2 + data_size);
+			else
+			{
+				ec = socks5::make_error_code(socks5::error::address_type_not_supported);
+				return {};
+			}
+
+			if (data.size() < need)
+				return {};
+
+			return { need, data.substr(0, need) };
+		}
+	};
 }
@@ -30,8 +30,9 @@ parse_udp_packet(std::string_view data, bool rsv_as_datalen = false)
 	if (data.size() < std::size_t(3))
 		return { 1,{},{},{} };
 
-	std::uint16_t data_size = asio::detail::network_to_host(
-		std::uint16_t(*(reinterpret_cast<const std::uint16_t*>(data.data()))));
+	// the data may be unaligned, read it by memcpy.
+	const char* p = data.data();
+	std::uint16_t data_size = asio::detail::read<std::uint16_t>(p);
 
 	data.remove_prefix(3);
 
@@ -11,16 +11,57 @@
 #pragma once
 
 #include <asio3/core/asio.hpp>
+#include <asio3/core/frame_allocator.hpp>
 #include <asio3/core/timer.hpp>
 #include <asio3/core/strutil.hpp>
 #include <asio3/tcp/core.hpp>
 
+namespace asio
+{
+	/**
+	 * @brief A group of tcp acceptors which are listening on the same address and port.
+	 * Each shard is bound to its own executor, so the accept loops of the shards can be
+	 * running in different threads, and the kernel will spread the incoming connections.
+	 */
+	struct sharded_acceptor
+	{
+		std::vector<asio::tcp_acceptor> shards{};
+
+		inline std::size_t size() const noexcept { return shards.size(); }
+		inline bool       empty() const noexcept { return shards.empty(); }
+
+		inline asio::tcp_acceptor& operator[](std::size_t i) noexcept { return shards[i]; }
+
+		inline auto begin() noexcept { return shards.begin(); }
+		inline auto end  () noexcept { return shards.end  (); }
+
+		inline asio::ip::tcp::endpoint local_endpoint(asio::error_code& ec) const
+		{
+			if (shards.empty())
+			{
+				ec = asio::error::not_socket;
+				return {};
+			}
+			return shards.front().local_endpoint(ec);
+		}
+
+		inline void close(asio::error_code& ec)
+		{
+			for (asio::tcp_acceptor& acceptor : shards)
+			{
+				acceptor.close(ec);
+			}
+		}
+	};
+}
+
 namespace asio::detail
 {
 	struct async_create_acceptor_op
 	{
 		template<typename String, typename StrOrInt>
-		auto operator()(auto state, auto&& executor, String&& listen_address, StrOrInt&& listen_port) -> void
+		auto operator()(auto state, auto&& executor, String&& listen_address, StrOrInt&& listen_port,
+			tcp_socket_option opt) -> void
 		{
 			state.reset_cancellation_state(asio::enable_terminal_cancellation());
 
@@ -40,16 +81,197 @@ namespace asio::detail
 			if (eps.empty())
 				co_return{ asio::error::host_not_found, asio::tcp_acceptor{executor} };
 
-			try
+			asio::ip::tcp::endpoint ep = (*eps).endpoint();
+
+			asio::error_code ec{};
+
+			asio::tcp_acceptor acceptor(executor);
+
+			acceptor.open(ep.protocol(), ec);
+			if (!ec) acceptor.set_option(asio::socket_base::reuse_address(opt.reuse_address), ec);
+		#if defined(TCP_FASTOPEN)
+			// the fast open queue must be set before listen.
+			if (!ec && opt.fast_open_queue_length > 0)
+				acceptor.set_option(asio::tcp_fast_open(opt.fast_open_queue_length), ec);
+		#endif
+			if (!ec) acceptor.bind(ep, ec);
+			if (!ec) acceptor.listen(asio::socket_base::max_listen_connections, ec);
+			if (ec)
+				co_return{ ec, asio::tcp_acceptor{executor} };
+
+			co_return{ asio::error_code{}, std::move(acceptor) };
+		}
+	};
+
+	struct async_create_sharded_acceptor_op
+	{
+		template<typename String, typename StrOrInt>
+		auto operator()(auto state, std::vector<asio::any_io_executor> executors,
+			String&& listen_address, StrOrInt&& listen_port) -> void
+		{
+			state.reset_cancellation_state(asio::enable_terminal_cancellation());
+
+			std::string host = asio::to_string(std::forward<String>(listen_address));
+			std::string port = asio::to_string(std::forward<StrOrInt>(listen_port));
+
+			sharded_acceptor group{};
+
+		#if !defined(SO_REUSEPORT)
+			asio::detail::ignore_unused(executors, host, port);
+			co_return{ asio::error::operation_not_supported, std::move(group) };
+		#else
+			if (executors.empty())
+				co_return{ asio::error::invalid_argument, std::move(group) };
+
+			ip::tcp::resolver resolver(executors.front());
+
+			auto [e1, eps] = co_await resolver.async_resolve(
+				host, port, asio::ip::tcp::resolver::passive, use_nothrow_deferred);
+			if (e1)
+				co_return{ e1, std::move(group) };
+
+			if (!!state.cancelled())
+				co_return{ asio::error::operation_aborted, std::move(group) };
+
+			if (eps.empty())
+				co_return{ asio::error::host_not_found, std::move(group) };
+
+			asio::ip::tcp::endpoint ep = (*eps).endpoint();
+
+			asio::error_code ec{};
+
+			group.shards.reserve(executors.size());
+
+			for (auto& ex : executors)
 			{
-				asio::tcp_acceptor acceptor(executor, *eps);
+				asio::tcp_acceptor acceptor(ex);
+
+				acceptor.open(ep.protocol(), ec);
+				if (!ec) acceptor.set_option(asio::socket_base::reuse_address(true), ec);
+				if (!ec) acceptor.set_option(asio::reuse_port(true), ec);
+				if (!ec) acceptor.bind(ep, ec);
+				if (!ec) acceptor.listen(asio::socket_base::max_listen_connections, ec);
 
-				co_return{ asio::error_code{}, std::move(acceptor) };
+				// if the listen port is 0, the other shards must bind to the port which
+				// is chosen by the first shard.
+				if (!ec && ep.port() == 0)
+				{
+					std::uint16_t chosen = acceptor.local_endpoint(ec).port();
+					if (!ec)
+						ep.port(chosen);
+				}
+
+				if (ec)
+				{
+					asio::error_code ec_ignored{};
+					acceptor.close(ec_ignored);
+					group.close(ec_ignored);
+					group.shards.clear();
+					co_return{ ec, std::move(group) };
+				}
+
+				group.shards.emplace_back(std::move(acceptor));
 			}
-			catch (const asio::system_error& e)
+
+			co_return{ asio::error_code{}, std::move(group) };
+		#endif
+		}
+	};
+
+	template<typename AsyncAcceptor>
+	using accepted_socket_t = typename AsyncAcceptor::protocol_type::socket::template
+		rebind_executor<typename AsyncAcceptor::executor_type>::other;
+
+	struct async_accept_batch_op
+	{
+		template<typename AsyncAcceptor, typename ExecutorSelector>
+		auto operator()(
+			auto state, std::reference_wrapper<AsyncAcceptor> acceptor_ref, std::size_t max_n,
+			ExecutorSelector select) -> void
+		{
+			using socket_t = accepted_socket_t<AsyncAcceptor>;
+
+			state.reset_cancellation_state(asio::enable_terminal_cancellation());
+
+			auto& acceptor = acceptor_ref.get();
+
+			std::vector<socket_t> socks;
+
+			if (max_n == 0)
+				max_n = 1;
+
+			asio::error_code ec{};
+
+			bool suspended = false;
+
+			// only the native mode is switched, which the async operations of asio use already, the
+			// user mode is untouched, so the synchronous operations of the user still block.
+			if (!acceptor.native_non_blocking())
+				acceptor.native_non_blocking(true, ec);
+
+			auto protocol = acceptor.local_endpoint(ec).protocol();
+			if (ec)
 			{
-				co_return{ e.code(), asio::tcp_acceptor{executor} };
+				co_await asio::detail::async_yield(state);
+				co_return{ ec, std::move(socks) };
 			}
+
+			socks.reserve((std::min)(max_n, std::size_t(16)));
+
+			for (;;)
+			{
+				// drain the pending connections without suspending, until the backlog is empty.
+				while (socks.size() < max_n)
+				{
+					asio::detail::socket_holder fd(asio::detail::socket_ops::accept(
+						acceptor.native_handle(), nullptr, nullptr, ec));
+
+					// the connection was reset before it was accepted, take the next one.
+					if (ec == asio::error::connection_aborted)
+						continue;
+				#if defined(EPROTO)
+					if (ec.value() == EPROTO && ec.category() == asio::error::get_system_category())
+						continue;
+				#endif
+					if (ec)
+						break;
+
+					socket_t sock(select());
+					sock.assign(protocol, fd.get(), ec);
+					if (ec)
+						break;
+					fd.release();
+
+					socks.emplace_back(std::move(sock));
+				}
+
+				if (!socks.empty() || (ec && ec != asio::error::would_block && ec != asio::error::try_again))
+					break;
+
+				auto [e1] = co_await acceptor.async_wait(asio::socket_base::wait_read, use_nothrow_deferred);
+
+				suspended = true;
+
+				if (e1)
+				{
+					ec = e1;
+					break;
+				}
+
+				if (!!state.cancelled())
+				{
+					ec = asio::error::operation_aborted;
+					break;
+				}
+			}
+
+			if (!socks.empty())
+				ec = {};
+
+			if (!suspended)
+				co_await asio::detail::async_yield(state);
+
+			co_return{ ec, std::move(socks) };
 		}
 	};
 }
@@ -79,8 +301,135 @@ namespace asio
 		CreateToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(typename asio::tcp_acceptor::executor_type))
 	{
 		return async_initiate<CreateToken, void(asio::error_code, asio::tcp_acceptor)>(
-			experimental::co_composed<void(asio::error_code, asio::tcp_acceptor)>(
+			detail::recycled_co_composed<void(asio::error_code, asio::tcp_acceptor)>(
+				detail::async_create_acceptor_op{}, executor),
+			token, executor, std::forward<String>(listen_address), std::forward<StrOrInt>(listen_port),
+			tcp_socket_option{});
+	}
+
+	/**
+	 * @brief Create a tcp acceptor asynchronously with the socket option.
+	 * The reuse_address and fast_open_queue_length of the option are applied to the acceptor,
+	 * the fast open is ignored if the platform doesn't support TCP_FASTOPEN.
+	 * @param executor - The executor.
+	 * @param listen_address - The listen ip. 
+	 * @param listen_port - The listen port. 
+	 * @param opt - The socket option.
+	 * @param token - The completion handler to invoke when the operation completes. 
+	 *	  The equivalent function signature of the handler must be:
+     *    @code
+     *    void handler(const asio::error_code& ec, asio::tcp_acceptor acceptor);
+	 */
+	template<typename Executor, typename String, typename StrOrInt,
+		ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, asio::tcp_acceptor)) CreateToken
+		ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(typename asio::tcp_acceptor::executor_type)>
+	requires
+		(std::constructible_from<std::string, String> &&
+		(std::constructible_from<std::string, StrOrInt> || std::integral<std::remove_cvref_t<StrOrInt>>))
+	ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(CreateToken, void(asio::error_code, asio::tcp_acceptor))
+	async_create_acceptor(
+		Executor&& executor,
+		String&& listen_address, StrOrInt&& listen_port, const tcp_socket_option& opt,
+		CreateToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(typename asio::tcp_acceptor::executor_type))
+	{
+		return async_initiate<CreateToken, void(asio::error_code, asio::tcp_acceptor)>(
+			detail::recycled_co_composed<void(asio::error_code, asio::tcp_acceptor)>(
 				detail::async_create_acceptor_op{}, executor),
-			token, executor, std::forward<String>(listen_address), std::forward<StrOrInt>(listen_port));
+			token, executor, std::forward<String>(listen_address), std::forward<StrOrInt>(listen_port), opt);
+	}
+
+	/**
+	 * @brief Create a group of tcp acceptors which are listening on the same address with
+	 *        SO_REUSEPORT asynchronously, one acceptor for each executor.
+	 * @param executors - The executors, the Nth acceptor will be bound to the Nth executor.
+	 * @param listen_address - The listen ip. 
+	 * @param listen_port - The listen port. 
+	 * @param token - The completion handler to invoke when the operation completes. 
+	 *	  The equivalent function signature of the handler must be:
+     *    @code
+     *    void handler(const asio::error_code& ec, asio::sharded_acceptor acceptors);
+	 */
+	template<typename Executors, typename String, typename StrOrInt,
+		ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, asio::sharded_acceptor)) CreateToken
+		ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(typename asio::tcp_acceptor::executor_type)>
+	requires
+		(std::ranges::range<Executors> &&
+		std::constructible_from<std::string, String> &&
+		(std::constructible_from<std::string, StrOrInt> || std::integral<std::remove_cvref_t<StrOrInt>>))
+	ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(CreateToken, void(asio::error_code, asio::sharded_acceptor))
+	async_create_sharded_acceptor(
+		Executors&& executors,
+		String&& listen_address, StrOrInt&& listen_port,
+		CreateToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(typename asio::tcp_acceptor::executor_type))
+	{
+		std::vector<asio::any_io_executor> exs;
+		for (auto&& ex : executors)
+		{
+			exs.emplace_back(ex);
+		}
+
+		asio::any_io_executor executor = exs.empty() ? asio::any_io_executor{ asio::system_executor{} } : exs.front();
+
+		return async_initiate<CreateToken, void(asio::error_code, asio::sharded_acceptor)>(
+			detail::recycled_co_composed<void(asio::error_code, asio::sharded_acceptor)>(
+				detail::async_create_sharded_acceptor_op{}, executor),
+			token, std::move(exs), std::forward<String>(listen_address), std::forward<StrOrInt>(listen_port));
+	}
+
+	/**
+	 * @brief Accept all the pending connections of the acceptor asynchronously.
+	 * After each readiness notification, it keeps accepting in non-blocking mode until
+	 * the backlog is empty or max_n connections are accepted. The user visible blocking mode of
+	 * the acceptor is not changed.
+	 * @param acceptor - The acceptor reference.
+	 * @param max_n - The maximum number of connections to accept in one call.
+	 * @param token - The completion handler to invoke when the operation completes. 
+	 *	  The equivalent function signature of the handler must be:
+     *    @code
+     *    void handler(const asio::error_code& ec, std::vector<asio::tcp_socket> socks);
+	 */
+	template<typename AsyncAcceptor,
+		ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, std::vector<detail::accepted_socket_t<AsyncAcceptor>>)) AcceptToken
+		ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(typename AsyncAcceptor::executor_type)>
+	ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(AcceptToken, void(asio::error_code, std::vector<detail::accepted_socket_t<AsyncAcceptor>>))
+	async_accept_batch(
+		AsyncAcceptor& acceptor, std::size_t max_n,
+		AcceptToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(typename AsyncAcceptor::executor_type))
+	{
+		using socket_t = detail::accepted_socket_t<AsyncAcceptor>;
+
+		return async_initiate<AcceptToken, void(asio::error_code, std::vector<socket_t>)>(
+			detail::recycled_co_composed<void(asio::error_code, std::vector<socket_t>)>(
+				detail::async_accept_batch_op{}, acceptor),
+			token, std::ref(acceptor), max_n, [&acceptor]() { return acceptor.get_executor(); });
+	}
+
+	/**
+	 * @brief Accept all the pending connections of the acceptor asynchronously, each connection
+	 * is accepted into a socket of the executor which is returned by the selector, e.g. to spread
+	 * the connections over the contexts of an asio::io_context_pool.
+	 * @param acceptor - The acceptor reference.
+	 * @param max_n - The maximum number of connections to accept in one call.
+	 * @param select - The function to get the executor of each accepted socket: Executor select();
+	 * @param token - The completion handler to invoke when the operation completes. 
+	 *	  The equivalent function signature of the handler must be:
+     *    @code
+     *    void handler(const asio::error_code& ec, std::vector<asio::tcp_socket> socks);
+	 */
+	template<typename AsyncAcceptor, typename ExecutorSelector,
+		ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, std::vector<detail::accepted_socket_t<AsyncAcceptor>>)) AcceptToken
+		ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(typename AsyncAcceptor::executor_type)>
+	requires (std::invocable<ExecutorSelector&> && asio::execution::executor<std::invoke_result_t<ExecutorSelector&>>)
+	ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(AcceptToken, void(asio::error_code, std::vector<detail::accepted_socket_t<AsyncAcceptor>>))
+	async_accept_batch(
+		AsyncAcceptor& acceptor, std::size_t max_n, ExecutorSelector&& select,
+		AcceptToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(typename AsyncAcceptor::executor_type))
+	{
+		using socket_t = detail::accepted_socket_t<AsyncAcceptor>;
+
+		return async_initiate<AcceptToken, void(asio::error_code, std::vector<socket_t>)>(
+			detail::recycled_co_composed<void(asio::error_code, std::vector<socket_t>)>(
+				detail::async_accept_batch_op{}, acceptor),
+			token, std::ref(acceptor), max_n, std::forward<ExecutorSelector>(select));
 	}
 }
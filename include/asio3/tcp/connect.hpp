@@ -11,7 +11,10 @@
 #pragma once
 
 #include <asio3/core/asio.hpp>
+#include <asio3/core/frame_allocator.hpp>
 #include <asio3/core/strutil.hpp>
+#include <asio3/core/resolve_cache.hpp>
+#include <asio3/core/detail/netutil.hpp>
 #include <asio3/tcp/core.hpp>
 
 namespace asio::detail
@@ -24,12 +27,233 @@ namespace asio::detail
 		}
 	};
 
+	/**
+	 * @brief Reorder the endpoints so that the address families are interleaved, starting with
+	 *        the family of the first endpoint. see RFC 8305 section 4.
+	 */
+	template<typename Endpoints>
+	inline std::vector<asio::ip::tcp::endpoint> interleave_address_families(const Endpoints& eps)
+	{
+		std::vector<asio::ip::tcp::endpoint> primary, secondary, result;
+
+		for (auto&& e : eps)
+		{
+			asio::ip::tcp::endpoint ep;
+
+			if constexpr (requires { e.endpoint(); })
+				ep = e.endpoint();
+			else
+				ep = e;
+
+			if (primary.empty() || primary.front().address().is_v6() == ep.address().is_v6())
+				primary.emplace_back(std::move(ep));
+			else
+				secondary.emplace_back(std::move(ep));
+		}
+
+		result.reserve(primary.size() + secondary.size());
+
+		for (std::size_t i = 0; i < primary.size() || i < secondary.size(); ++i)
+		{
+			if (i < primary.size())
+				result.emplace_back(primary[i]);
+			if (i < secondary.size())
+				result.emplace_back(secondary[i]);
+		}
+
+		return result;
+	}
+
+	template<typename AsyncStream>
+	struct race_connect_state
+	{
+		template<typename Executor>
+		explicit race_connect_state(const Executor& ex) : notifier(ex) {}
+
+		asio::steady_timer                        notifier;
+
+		// attempts[i] is connecting to the endpoint eps[i], nullptr if the socket open failed.
+		std::vector<std::unique_ptr<AsyncStream>> attempts;
+
+		std::size_t                               pending  = 0;
+		std::size_t                               winner   = (std::numeric_limits<std::size_t>::max)();
+		bool                                      notified = false;
+
+		asio::error_code                          last_error{};
+	};
+
+	struct async_race_connect_op
+	{
+		// the callback is taken by value, it is called after the suspensions, when a reference to
+		// the argument of the initiating function would be dangling already.
+		template<typename AsyncStream, typename SetOptionCallback>
+		auto operator()(
+			auto state, std::reference_wrapper<AsyncStream> sock_ref,
+			std::vector<asio::ip::tcp::endpoint> eps, SetOptionCallback cb_set_option) -> void
+		{
+			state.reset_cancellation_state(asio::enable_terminal_cancellation());
+
+			auto& sock = sock_ref.get();
+
+			constexpr std::size_t npos = (std::numeric_limits<std::size_t>::max)();
+
+			if (eps.empty())
+				co_return{ asio::error::host_unreachable, asio::ip::tcp::endpoint{} };
+
+			auto sp = std::make_shared<race_connect_state<AsyncStream>>(sock.get_executor());
+
+			sp->attempts.reserve(eps.size());
+
+			asio::error_code ec{};
+
+			bool start_next = true;
+
+			for (;;)
+			{
+				if (start_next && sp->attempts.size() < eps.size())
+				{
+					std::size_t i = sp->attempts.size();
+
+					auto& attempt = sp->attempts.emplace_back(std::make_unique<AsyncStream>(sock.get_executor()));
+
+					attempt->open(eps[i].protocol(), ec);
+
+					if (ec)
+					{
+						sp->last_error = ec;
+						attempt.reset();
+						continue;
+					}
+
+					attempt->set_option(asio::socket_base::reuse_address(true), ec);
+					attempt->set_option(asio::socket_base::keep_alive(true), ec);
+					attempt->set_option(asio::ip::tcp::no_delay(true), ec);
+
+					cb_set_option(*attempt);
+
+					++sp->pending;
+
+					attempt->async_connect(eps[i], [sp, i](const asio::error_code& e) mutable
+					{
+						--sp->pending;
+
+						if (e)
+							sp->last_error = e;
+						else if (sp->winner == npos)
+							sp->winner = i;
+
+						sp->notified = true;
+
+						detail::cancel_timer(sp->notifier);
+					});
+				}
+
+				start_next = false;
+
+				if (sp->winner != npos)
+					break;
+
+				if (sp->pending == 0)
+				{
+					// all attempts failed.
+					if (sp->attempts.size() == eps.size())
+						break;
+
+					// the running attempts failed, start the next attempt immediately.
+					start_next = true;
+					continue;
+				}
+
+				if (!sp->notified)
+				{
+					if (sp->attempts.size() < eps.size())
+						sp->notifier.expires_after(std::chrono::milliseconds(tcp_connection_attempt_delay));
+					else
+						sp->notifier.expires_at((std::chrono::steady_clock::time_point::max)());
+
+					auto [e1] = co_await sp->notifier.async_wait(use_nothrow_deferred);
+
+					if (!!state.cancelled())
+						break;
+
+					// the attempt delay is elapsed, start the next attempt.
+					if (!e1)
+						start_next = true;
+				}
+
+				if (sp->notified)
+				{
+					sp->notified = false;
+
+					// an attempt failed, start the next attempt without waiting the delay, but not
+					// when the notification is of a success, the loop ends at the winner check.
+					if (sp->winner == npos)
+						start_next = true;
+				}
+			}
+
+			for (std::size_t i = 0; i < sp->attempts.size(); ++i)
+			{
+				if (i != sp->winner && sp->attempts[i])
+					sp->attempts[i]->close(ec);
+			}
+
+			if (!!state.cancelled())
+				co_return{ asio::error::operation_aborted, asio::ip::tcp::endpoint{} };
+
+			if (sp->winner == npos)
+				co_return{ sp->last_error ? sp->last_error : asio::error::connection_refused, asio::ip::tcp::endpoint{} };
+
+			sock = std::move(*(sp->attempts[sp->winner]));
+
+			co_return{ asio::error_code{}, eps[sp->winner] };
+		}
+	};
+}
+
+namespace asio
+{
+	/**
+	 * @brief Asynchronously establishes a socket connection by racing the endpoints (RFC 8305 Happy Eyeballs).
+	 * The address families are interleaved, a new connection attempt is started every 250 milliseconds
+	 * or as soon as the previous attempt fails, the first successful attempt wins and the others are closed.
+	 * @param sock - The socket reference to be connected, the winning socket will be moved into it.
+	 * @param endpoints - The endpoints, can be a resolver results or a range of asio::ip::tcp::endpoint.
+	 * @param cb_set_option - The callback to set the socket options of each attempt.
+	 * @param token - The completion handler to invoke when the operation completes. 
+	 *	  The equivalent function signature of the handler must be:
+     *    @code
+     *    void handler(const asio::error_code& ec, asio::ip::tcp::endpoint ep);
+	 */
+	template<
+		typename AsyncStream,
+		typename Endpoints,
+		typename SetOptionCallback = detail::default_set_option_callback,
+		ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, asio::ip::tcp::endpoint)) ConnectToken
+		ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(typename AsyncStream::executor_type)>
+	requires std::ranges::range<Endpoints>
+	ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(ConnectToken, void(asio::error_code, asio::ip::tcp::endpoint))
+	async_race_connect(
+		AsyncStream& sock, const Endpoints& endpoints,
+		SetOptionCallback&& cb_set_option = detail::default_set_option_callback{},
+		ConnectToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(typename AsyncStream::executor_type))
+	{
+		return asio::async_initiate<ConnectToken, void(asio::error_code, asio::ip::tcp::endpoint)>(
+			asio::detail::recycled_co_composed<void(asio::error_code, asio::ip::tcp::endpoint)>(
+				detail::async_race_connect_op{}, sock),
+			token, std::ref(sock), detail::interleave_address_families(endpoints),
+			std::forward<SetOptionCallback>(cb_set_option));
+	}
+}
+
+namespace asio::detail
+{
 	struct async_connect_op
 	{
 		template<typename AsyncStream, typename String, typename StrOrInt, typename SetOptionCallback>
 		auto operator()(
 			auto state, std::reference_wrapper<AsyncStream> sock_ref,
-			String&& host, StrOrInt&& port, SetOptionCallback&& cb_set_option) -> void
+			String&& host, StrOrInt&& port, SetOptionCallback cb_set_option) -> void
 		{
 			state.reset_cancellation_state(asio::enable_terminal_cancellation());
 
@@ -38,9 +262,7 @@ namespace asio::detail
 			std::string h = asio::to_string(std::forward<String>(host));
 			std::string p = asio::to_string(std::forward<StrOrInt>(port));
 
-			asio::ip::tcp::resolver resolver(sock.get_executor());
-
-			auto [e1, eps] = co_await resolver.async_resolve(h, p, use_nothrow_deferred);
+			auto [e1, eps] = co_await asio::async_cached_resolve(sock.get_executor(), h, p, use_nothrow_deferred);
 			if (e1)
 				co_return{ e1, asio::ip::tcp::endpoint{} };
 
@@ -64,30 +286,9 @@ namespace asio::detail
 			}
 			else
 			{
-				asio::error_code ec{};
-
-				for (auto&& ep : eps)
-				{
-					sock.close(ec);
-
-					sock.open(ep.endpoint().protocol(), ec);
-
-					if (ec)
-						continue;
-
-					sock.set_option(asio::socket_base::reuse_address(true), ec);
-					sock.set_option(asio::socket_base::keep_alive(true), ec);
-					sock.set_option(asio::ip::tcp::no_delay(true), ec);
-
-					cb_set_option(sock);
-
-					auto [e2] = co_await sock.async_connect(ep, use_nothrow_deferred);
-					if (!e2)
-						co_return{ e2, ep.endpoint() };
-
-					if (!!state.cancelled())
-						co_return{ asio::error::operation_aborted, asio::ip::tcp::endpoint{} };
-				}
+				auto [e2, ep] = co_await asio::async_race_connect(
+					sock, eps, std::move(cb_set_option), use_nothrow_deferred);
+				co_return{ e2, ep };
 			}
 
 			co_return{ asio::error::connection_refused, asio::ip::tcp::endpoint{} };
@@ -98,7 +299,9 @@ namespace asio::detail
 namespace asio
 {
 	/**
-	 * @brief Asynchronously establishes a socket connection by trying each endpoint in a sequence.
+	 * @brief Asynchronously establishes a socket connection.
+	 * If the socket is not opened, the resolved endpoints are raced by async_race_connect, otherwise
+	 * each endpoint is tried in a sequence with the opened socket.
 	 * @param sock - The socket reference to be connected. The type can't be asio::ip::tcp:socket
 	 * @param host - The target server host. 
 	 * @param port - The target server port. 
@@ -124,9 +327,144 @@ namespace asio
 		ConnectToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(typename AsyncStream::executor_type))
 	{
 		return asio::async_initiate<ConnectToken, void(asio::error_code, asio::ip::tcp::endpoint)>(
-			asio::experimental::co_composed<void(asio::error_code, asio::ip::tcp::endpoint)>(
+			asio::detail::recycled_co_composed<void(asio::error_code, asio::ip::tcp::endpoint)>(
 				detail::async_connect_op{}, sock),
 			token, std::ref(sock), std::forward<String>(host), std::forward<StrOrInt>(port),
 			std::forward<SetOptionCallback>(cb_set_option));
 	}
 }
+
+namespace asio::detail
+{
+	struct async_fast_open_connect_op
+	{
+		template<typename AsyncStream, typename ConstBufferSequence, typename SetOptionCallback>
+		auto operator()(
+			auto state, std::reference_wrapper<AsyncStream> sock_ref, std::string host, std::string port,
+			ConstBufferSequence data, SetOptionCallback cb_set_option) -> void
+		{
+			state.reset_cancellation_state(asio::enable_terminal_cancellation());
+
+			auto& sock = sock_ref.get();
+
+			auto [e1, eps] = co_await asio::async_cached_resolve(sock.get_executor(), host, port, use_nothrow_deferred);
+			if (e1)
+				co_return{ e1, asio::ip::tcp::endpoint{} };
+
+			if (!!state.cancelled())
+				co_return{ asio::error::operation_aborted, asio::ip::tcp::endpoint{} };
+
+			asio::error_code ec{}, last_error{};
+
+			// the endpoints are tried in sequence, the connect of a fast open socket completes
+			// immediately when the cookie is cached, so racing them is meaningless.
+			for (auto&& result : eps)
+			{
+				asio::ip::tcp::endpoint ep = result.endpoint();
+
+				sock.close(ec);
+
+				sock.open(ep.protocol(), ec);
+				if (ec)
+				{
+					last_error = ec;
+					continue;
+				}
+
+				sock.set_option(asio::socket_base::reuse_address(true), ec);
+				sock.set_option(asio::socket_base::keep_alive(true), ec);
+				sock.set_option(asio::ip::tcp::no_delay(true), ec);
+
+			#if defined(TCP_FASTOPEN_CONNECT)
+				sock.set_option(asio::tcp_fast_open_connect(true), ec);
+			#endif
+
+				cb_set_option(sock);
+
+				auto [e2] = co_await sock.async_connect(ep, use_nothrow_deferred);
+
+				if (!e2)
+				{
+					auto [e3, n3] = co_await asio::async_write(sock, data, asio::transfer_all(), use_nothrow_deferred);
+					e2 = e3;
+				}
+
+				// with fast open, the connect and the first write complete before the handshake,
+				// wait until the handshake is finished to know whether the connection is refused.
+				// the initial data is sent with the SYN already, so the wait costs nothing.
+				if (!e2)
+				{
+					auto [e4] = co_await sock.async_wait(asio::socket_base::wait_write, use_nothrow_deferred);
+					e2 = e4;
+
+					asio::detail::socket_option::integer<SOL_SOCKET, SO_ERROR> so_error{};
+					if (!e2)
+						sock.get_option(so_error, e2);
+					if (!e2 && so_error.value() != 0)
+						e2 = asio::error_code(so_error.value(), asio::error::get_system_category());
+
+					if (!e2)
+						co_return{ asio::error_code{}, ep };
+				}
+
+				last_error = e2;
+
+				if (!!state.cancelled())
+					break;
+			}
+
+			sock.close(ec);
+
+			if (!!state.cancelled())
+				co_return{ asio::error::operation_aborted, asio::ip::tcp::endpoint{} };
+
+			co_return{ last_error ? last_error : asio::error::host_unreachable, asio::ip::tcp::endpoint{} };
+		}
+	};
+}
+
+namespace asio
+{
+	/**
+	 * @brief Asynchronously establishes a socket connection by tcp fast open, and send the initial data.
+	 * If a fast open cookie of the server is cached, the initial data is sent with the SYN, otherwise
+	 * it is sent after the normal handshake and a cookie is requested for the next connection.
+	 * On the platforms without TCP_FASTOPEN_CONNECT, it is a normal connect and write.
+	 * Fast open is only used by this function. async_connect and async_race_connect never set
+	 * TCP_FASTOPEN_CONNECT, a connect of it completes before the handshake, so they can't see
+	 * whether the endpoint is refused, this function confirms the handshake after the write.
+	 * @param sock - The socket reference to be connected, it will be reopened for each endpoint.
+	 * @param host - The target server host.
+	 * @param port - The target server port.
+	 * @param data - The initial data, it must remain valid until the completion handler is called.
+	 * @param cb_set_option - The callback to set the socket options.
+	 * @param token - The completion handler to invoke when the operation completes.
+	 *	  The equivalent function signature of the handler must be:
+     *    @code
+     *    void handler(const asio::error_code& ec, asio::ip::tcp::endpoint ep);
+	 */
+	template<
+		typename AsyncStream,
+		typename String, typename StrOrInt,
+		typename ConstBufferSequence,
+		typename SetOptionCallback = detail::default_set_option_callback,
+		ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, asio::ip::tcp::endpoint)) ConnectToken
+		ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(typename AsyncStream::executor_type)>
+	requires
+		(std::constructible_from<std::string, String> &&
+		(std::constructible_from<std::string, StrOrInt> || std::integral<std::remove_cvref_t<StrOrInt>>) &&
+		is_const_buffer_sequence<ConstBufferSequence>::value)
+	ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(ConnectToken, void(asio::error_code, asio::ip::tcp::endpoint))
+	async_fast_open_connect(
+		AsyncStream& sock, String&& host, StrOrInt&& port, const ConstBufferSequence& data,
+		SetOptionCallback&& cb_set_option = detail::default_set_option_callback{},
+		ConnectToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(typename AsyncStream::executor_type))
+	{
+		return asio::async_initiate<ConnectToken, void(asio::error_code, asio::ip::tcp::endpoint)>(
+			asio::detail::recycled_co_composed<void(asio::error_code, asio::ip::tcp::endpoint)>(
+				detail::async_fast_open_connect_op{}, sock),
+			token, std::ref(sock), asio::to_string(std::forward<String>(host)),
+			asio::to_string(std::forward<StrOrInt>(port)), data,
+			std::forward<SetOptionCallback>(cb_set_option));
+	}
+}
@@ -0,0 +1,661 @@
+/*
+ * Copyright (c) 2017-2023 zhllxt
+ *
+ * author   : zhllxt
+ * email    : 37792738@qq.com
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <asio3/core/asio.hpp>
+#include <asio3/core/frame_allocator.hpp>
+#include <asio3/core/detail/netutil.hpp>
+#include <asio3/tcp/core.hpp>
+#include <asio3/tcp/tcp_client.hpp>
+
+namespace asio
+{
+	struct tcp_connection_pool_option
+	{
+		/// The maximum number of connections (idle and in use) to one key.
+		std::size_t                         max_connections_per_key = 8;
+
+		/// The maximum number of connections (idle and in use) of the whole pool.
+		std::size_t                         max_connections         = 256;
+
+		/// The idle connections which are not used for this duration are closed.
+		std::chrono::steady_clock::duration idle_timeout            = std::chrono::seconds(60);
+
+		/// The timeout of the async_acquire, include the waiting time and the connecting time.
+		std::chrono::steady_clock::duration acquire_timeout         =
+			std::chrono::milliseconds(asio::detail::tcp_connect_timeout);
+	};
+}
+
+namespace asio::detail
+{
+	struct tcp_pool_waiter
+	{
+		explicit tcp_pool_waiter(const asio::any_io_executor& ex) : notifier(ex)
+		{
+		}
+
+		/// canceled when a connection is handed over or a connection slot is granted.
+		asio::steady_timer              notifier;
+
+		/// the released connection which is handed over to this waiter directly.
+		std::optional<asio::tcp_socket> socket{};
+
+		/// a connection slot is reserved for this waiter, it should make a new connection.
+		bool                            granted = false;
+	};
+
+	/**
+	 * The connections are grouped by key, all the members are accessed in the strand only.
+	 */
+	class tcp_connection_pool_impl : public std::enable_shared_from_this<tcp_connection_pool_impl>
+	{
+	public:
+		using strand_type = asio::strand<asio::any_io_executor>;
+		using clock_type  = std::chrono::steady_clock;
+
+		struct idle_socket
+		{
+			asio::tcp_socket       socket;
+			clock_type::time_point since;
+		};
+
+		struct bucket
+		{
+			std::vector<idle_socket>     idles;
+			std::deque<tcp_pool_waiter*> waiters;
+
+			/// the number of idle and in use connections, include the connecting ones.
+			std::size_t                  total = 0;
+		};
+
+		explicit tcp_connection_pool_impl(const asio::any_io_executor& ex, tcp_connection_pool_option opt)
+			: strand_(asio::make_strand(ex)), option_(std::move(opt))
+		{
+			if (option_.max_connections_per_key == 0)
+				option_.max_connections_per_key = 1;
+
+			if (option_.max_connections == 0)
+				option_.max_connections = 1;
+		}
+
+		inline strand_type& strand() noexcept { return strand_; }
+
+		inline const tcp_connection_pool_option& option() const noexcept { return option_; }
+
+		inline bool is_closed() const noexcept { return closed_; }
+
+		/**
+		 * @brief Make the pool key of the client option.
+		 */
+		static std::string make_key(const tcp_client_option& opt)
+		{
+			std::string key = opt.server_address;
+			key += '\0';
+			key += std::to_string(opt.server_port);
+
+			if (opt.socks5_option.has_value())
+			{
+				const socks5::option& s5opt = opt.socks5_option.value();
+
+				key += '\0';
+				key += s5opt.proxy_address;
+				key += '\0';
+				key += std::to_string(s5opt.proxy_port);
+				key += '\0';
+				key += s5opt.username;
+				key += '\0';
+				key += s5opt.password;
+			}
+
+			return key;
+		}
+
+		/**
+		 * @brief Check whether the idle connection is still usable: not closed by the peer, and
+		 * there is no unexpected data which would be mixed into the next request's response.
+		 */
+		static bool is_alive(asio::tcp_socket& sock) noexcept
+		{
+			if (!sock.is_open())
+				return false;
+
+			asio::error_code ec{};
+
+			bool non_blocking = sock.non_blocking();
+
+			sock.non_blocking(true, ec);
+			if (ec)
+				return false;
+
+			char c{};
+			sock.receive(asio::buffer(&c, 1), asio::socket_base::message_peek, ec);
+
+			asio::error_code ec_ignore{};
+			sock.non_blocking(non_blocking, ec_ignore);
+
+			return ec == asio::error::would_block;
+		}
+
+		/**
+		 * @brief Pop the most recently used live idle connection of the key.
+		 */
+		std::optional<asio::tcp_socket> pop_idle(const std::string& key)
+		{
+			auto it = buckets_.find(key);
+			if (it == buckets_.end())
+				return std::nullopt;
+
+			bucket& b = it->second;
+
+			auto now = clock_type::now();
+
+			std::size_t closed = 0;
+
+			std::optional<asio::tcp_socket> result;
+
+			while (!b.idles.empty())
+			{
+				idle_socket idle = std::move(b.idles.back());
+				b.idles.pop_back();
+
+				if (idle.since + option_.idle_timeout > now && is_alive(idle.socket))
+				{
+					result.emplace(std::move(idle.socket));
+					break;
+				}
+
+				asio::error_code ec{};
+				idle.socket.close(ec);
+				++closed;
+			}
+
+			for (; closed > 0; --closed)
+				free_slot(key);
+
+			return result;
+		}
+
+		/**
+		 * @brief Reserve a connection slot for the key, an idle connection of other keys maybe
+		 * closed if the global limit is reached.
+		 */
+		bool try_reserve(const std::string& key)
+		{
+			bucket& b = buckets_[key];
+
+			if (b.total >= option_.max_connections_per_key)
+				return false;
+
+			if (total_ >= option_.max_connections && !evict_oldest_idle())
+				return false;
+
+			++b.total;
+			++total_;
+
+			return true;
+		}
+
+		/**
+		 * @brief Release the connection slot of the key, and grant it to a waiter.
+		 */
+		void free_slot(const std::string& key)
+		{
+			auto it = buckets_.find(key);
+			if (it != buckets_.end())
+			{
+				--(it->second.total);
+				--total_;
+			}
+
+			grant_waiter(key);
+
+			erase_if_unused(key);
+		}
+
+		/**
+		 * @brief Put the connection back to the pool, it is handed over to a waiter if there is one.
+		 */
+		void release(const std::string& key, asio::tcp_socket sock)
+		{
+			if (closed_ || !sock.is_open())
+			{
+				asio::error_code ec{};
+				sock.close(ec);
+
+				free_slot(key);
+				return;
+			}
+
+			bucket& b = buckets_[key];
+
+			if (!b.waiters.empty())
+			{
+				tcp_pool_waiter* w = b.waiters.front();
+				b.waiters.pop_front();
+
+				w->socket.emplace(std::move(sock));
+
+				asio::detail::cancel_timer(w->notifier);
+				return;
+			}
+
+			b.idles.emplace_back(idle_socket{ std::move(sock), clock_type::now() });
+		}
+
+		inline void add_waiter(const std::string& key, tcp_pool_waiter& w)
+		{
+			buckets_[key].waiters.emplace_back(std::addressof(w));
+		}
+
+		inline void remove_waiter(const std::string& key, tcp_pool_waiter& w)
+		{
+			auto it = buckets_.find(key);
+			if (it == buckets_.end())
+				return;
+
+			std::erase(it->second.waiters, std::addressof(w));
+
+			erase_if_unused(key);
+		}
+
+		void close()
+		{
+			closed_ = true;
+
+			for (auto& [key, b] : buckets_)
+			{
+				for (idle_socket& idle : b.idles)
+				{
+					asio::error_code ec{};
+					idle.socket.close(ec);
+
+					--b.total;
+					--total_;
+				}
+
+				b.idles.clear();
+
+				for (tcp_pool_waiter* w : b.waiters)
+					asio::detail::cancel_timer(w->notifier);
+
+				b.waiters.clear();
+			}
+		}
+
+	protected:
+		void grant_waiter(const std::string& key)
+		{
+			if (closed_)
+				return;
+
+			auto grant = [this](const std::string& k, bucket& b) mutable -> bool
+			{
+				if (b.waiters.empty() || !try_reserve(k))
+					return false;
+
+				tcp_pool_waiter* w = b.waiters.front();
+				b.waiters.pop_front();
+
+				w->granted = true;
+
+				asio::detail::cancel_timer(w->notifier);
+				return true;
+			};
+
+			if (auto it = buckets_.find(key); it != buckets_.end() && grant(key, it->second))
+				return;
+
+			// the slot maybe useful for the waiters which are blocked by the global limit.
+			for (auto& [k, b] : buckets_)
+			{
+				if (grant(k, b))
+					return;
+			}
+		}
+
+		bool evict_oldest_idle()
+		{
+			bucket* oldest_bucket = nullptr;
+
+			for (auto& [k, b] : buckets_)
+			{
+				if (b.idles.empty())
+					continue;
+
+				// idles[0] is the least recently used one of the bucket.
+				if (!oldest_bucket || b.idles.front().since < oldest_bucket->idles.front().since)
+					oldest_bucket = std::addressof(b);
+			}
+
+			if (!oldest_bucket)
+				return false;
+
+			asio::error_code ec{};
+			oldest_bucket->idles.front().socket.close(ec);
+			oldest_bucket->idles.erase(oldest_bucket->idles.begin());
+
+			// don't erase the bucket here, the caller maybe holding a reference of another bucket.
+			--(oldest_bucket->total);
+			--total_;
+
+			return true;
+		}
+
+		inline void erase_if_unused(const std::string& key)
+		{
+			auto it = buckets_.find(key);
+			if (it != buckets_.end() && it->second.total == 0 && it->second.waiters.empty())
+				buckets_.erase(it);
+		}
+
+	protected:
+		strand_type                             strand_;
+
+		tcp_connection_pool_option              option_;
+
+		std::unordered_map<std::string, bucket> buckets_;
+
+		std::size_t                             total_  = 0;
+
+		bool                                    closed_ = false;
+	};
+}
+
+namespace asio
+{
+	/**
+	 * @brief A connection leased from the tcp_connection_pool, it is returned to the pool when destroyed.
+	 * Call discard() if the connection is in an unknown state (e.g. a read or write failed).
+	 */
+	class tcp_pooled_connection
+	{
+	public:
+		tcp_pooled_connection() = default;
+
+		tcp_pooled_connection(std::shared_ptr<detail::tcp_connection_pool_impl> impl,
+			std::string key, asio::tcp_socket sock, bool reused)
+			: impl_(std::move(impl)), key_(std::move(key)), socket_(std::move(sock)), reused_(reused)
+		{
+		}
+
+		tcp_pooled_connection(tcp_pooled_connection&&) noexcept = default;
+
+		tcp_pooled_connection& operator=(tcp_pooled_connection&& other) noexcept
+		{
+			if (this != std::addressof(other))
+			{
+				release();
+
+				impl_   = std::move(other.impl_);
+				key_    = std::move(other.key_);
+				socket_ = std::move(other.socket_);
+				reused_ = other.reused_;
+			}
+
+			return *this;
+		}
+
+		~tcp_pooled_connection()
+		{
+			release();
+		}
+
+		inline explicit operator bool() const noexcept { return socket_.has_value(); }
+
+		inline asio::tcp_socket& socket() noexcept { return *socket_; }
+
+		inline asio::tcp_socket* operator->() noexcept { return std::addressof(*socket_); }
+
+		/**
+		 * @brief Whether the connection is an idle connection of the pool, or a new connection.
+		 */
+		inline bool reused() const noexcept { return reused_; }
+
+		/**
+		 * @brief Return the connection to the pool.
+		 */
+		inline void release()
+		{
+			if (!impl_ || !socket_)
+				return;
+
+			auto strand = impl_->strand();
+
+			asio::post(strand,
+			[impl = std::move(impl_), key = std::move(key_), sock = std::move(*socket_)]() mutable
+			{
+				impl->release(key, std::move(sock));
+			});
+
+			impl_.reset();
+			socket_.reset();
+		}
+
+		/**
+		 * @brief Close the connection and free its slot of the pool.
+		 */
+		inline void discard()
+		{
+			if (socket_)
+			{
+				asio::error_code ec{};
+				socket_->close(ec);
+			}
+
+			release();
+		}
+
+	protected:
+		std::shared_ptr<detail::tcp_connection_pool_impl> impl_;
+
+		std::string                                       key_;
+
+		std::optional<asio::tcp_socket>                   socket_;
+
+		bool                                              reused_ = false;
+	};
+}
+
+namespace asio::detail
+{
+	struct async_acquire_connection_op
+	{
+		auto operator()(
+			auto state, std::shared_ptr<tcp_connection_pool_impl> impl, tcp_client_option opt) -> void
+		{
+			// posted rather than dispatched, an idle connection is returned without any other
+			// suspension, and the handler must not be invoked inside the initiating function.
+			co_await asio::post(impl->strand(), use_nothrow_deferred);
+
+			state.reset_cancellation_state(asio::enable_terminal_cancellation());
+
+			std::string key = tcp_connection_pool_impl::make_key(opt);
+
+			auto deadline = std::chrono::steady_clock::now() + impl->option().acquire_timeout;
+
+			tcp_pool_waiter w(impl->strand());
+
+			for (;;)
+			{
+				if (impl->is_closed())
+					co_return{ asio::error::operation_aborted, tcp_pooled_connection{} };
+
+				if (auto sock = impl->pop_idle(key); sock.has_value())
+					co_return{ asio::error_code{}, tcp_pooled_connection(impl, key, std::move(*sock), true) };
+
+				if (impl->try_reserve(key))
+					break;
+
+				impl->add_waiter(key, w);
+
+				w.notifier.expires_at(deadline);
+
+				co_await w.notifier.async_wait(use_nothrow_deferred);
+
+				impl->remove_waiter(key, w);
+
+				// the connection is handed over, or the slot is reserved for us, they must not be lost.
+				if (w.socket.has_value())
+				{
+					if (!!state.cancelled())
+					{
+						impl->release(key, std::move(*w.socket));
+						co_return{ asio::error::operation_aborted, tcp_pooled_connection{} };
+					}
+
+					co_return{ asio::error_code{}, tcp_pooled_connection(impl, key, std::move(*w.socket), true) };
+				}
+
+				if (w.granted)
+				{
+					if (!!state.cancelled())
+					{
+						impl->free_slot(key);
+						co_return{ asio::error::operation_aborted, tcp_pooled_connection{} };
+					}
+
+					break;
+				}
+
+				if (!!state.cancelled())
+					co_return{ asio::error::operation_aborted, tcp_pooled_connection{} };
+
+				if (std::chrono::steady_clock::now() >= deadline)
+					co_return{ asio::error::timed_out, tcp_pooled_connection{} };
+			}
+
+			// the slot is reserved, make a new connection.
+			asio::tcp_socket sock(impl->strand().get_inner_executor());
+
+			asio::steady_timer timer(impl->strand());
+			timer.expires_at(deadline);
+
+			auto [order, e1, ep1, e2] = co_await asio::experimental::make_parallel_group(
+				asio::async_connect(sock, opt, asio::deferred),
+				timer.async_wait(asio::deferred))
+				.async_wait(asio::experimental::wait_for_one(), use_nothrow_deferred);
+
+			asio::detail::ignore_unused(ep1, e2);
+
+			if (order[0] != 0 || e1)
+			{
+				asio::error_code ec{};
+				sock.close(ec);
+
+				impl->free_slot(key);
+
+				if (!!state.cancelled())
+					co_return{ asio::error::operation_aborted, tcp_pooled_connection{} };
+
+				co_return{ order[0] != 0 ? asio::error::timed_out : e1, tcp_pooled_connection{} };
+			}
+
+			co_return{ asio::error_code{}, tcp_pooled_connection(impl, std::move(key), std::move(sock), false) };
+		}
+	};
+}
+
+namespace asio
+{
+	/**
+	 * @brief A connection pool which is keyed by the server address and port (and the socks5
+	 * proxy if it is set), the idle connections are kept and reused. It is thread safety.
+	 * @eg:
+	 * asio::tcp_connection_pool pool(ctx.get_executor(), { .max_connections_per_key = 16 });
+	 * auto [ec, conn] = co_await pool.async_acquire({ .server_address = "127.0.0.1", .server_port = 8080 });
+	 * co_await asio::async_write(conn.socket(), ...);
+	 */
+	class tcp_connection_pool
+	{
+	public:
+		using executor_type = asio::strand<asio::any_io_executor>;
+
+		explicit tcp_connection_pool(const asio::any_io_executor& ex, tcp_connection_pool_option opt = {})
+			: impl_(std::make_shared<detail::tcp_connection_pool_impl>(ex, std::move(opt)))
+		{
+		}
+
+		tcp_connection_pool(tcp_connection_pool&&) noexcept = default;
+		tcp_connection_pool& operator=(tcp_connection_pool&&) noexcept = default;
+
+		~tcp_connection_pool()
+		{
+			close();
+		}
+
+		/**
+		 * @brief Close all the idle connections and abort all the waiting acquires, the connections
+		 * in use are closed when they are returned.
+		 */
+		inline void close()
+		{
+			if (impl_)
+			{
+				asio::dispatch(impl_->strand(), [impl = impl_]() mutable
+				{
+					impl->close();
+				});
+			}
+		}
+
+		/**
+		 * @brief Get the executor, it is a strand.
+		 */
+		inline executor_type get_executor() noexcept
+		{
+			return impl_->strand();
+		}
+
+		/**
+		 * @brief Get the option.
+		 */
+		inline const tcp_connection_pool_option& get_option() const noexcept
+		{
+			return impl_->option();
+		}
+
+		/**
+		 * @brief Acquire a connection asynchronously. A live idle connection of the key is returned
+		 * if there is one, otherwise a new connection is made if the limits are not reached, otherwise
+		 * wait for a connection to be returned until the acquire timeout.
+		 * @param opt - The client option, the server address, port and socks5 option are the key.
+		 * @param token - The completion handler to invoke when the operation completes.
+		 *	  The equivalent function signature of the handler must be:
+		 *    @code
+		 *    void handler(const asio::error_code& ec, asio::tcp_pooled_connection conn);
+		 */
+		template<
+			ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, tcp_pooled_connection)) AcquireToken
+			ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(executor_type)>
+		ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(AcquireToken, void(asio::error_code, tcp_pooled_connection))
+		async_acquire(
+			tcp_client_option opt,
+			AcquireToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(executor_type))
+		{
+			return asio::async_initiate<AcquireToken, void(asio::error_code, tcp_pooled_connection)>(
+				asio::detail::recycled_co_composed<void(asio::error_code, tcp_pooled_connection)>(
+					detail::async_acquire_connection_op{}, impl_->strand()),
+				token, impl_, std::move(opt));
+		}
+
+	protected:
+		std::shared_ptr<detail::tcp_connection_pool_impl> impl_;
+	};
+}
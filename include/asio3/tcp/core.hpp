@@ -17,6 +17,25 @@ namespace asio
 	using tcp_acceptor = as_tuple_t<deferred_t>::as_default_on_t<ip::tcp::acceptor>;
 	using tcp_resolver = as_tuple_t<deferred_t>::as_default_on_t<ip::tcp::resolver>;
 	using tcp_socket   = as_tuple_t<deferred_t>::as_default_on_t<ip::tcp::socket>;
+
+#if defined(SO_REUSEPORT)
+	/// Socket option to allow several sockets to bind to the same address and port, the kernel
+	/// will distribute the incoming connections among them.
+	using reuse_port = asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif
+
+#if defined(TCP_FASTOPEN)
+	/// Socket option to enable tcp fast open on a listening socket, the value is the maximum
+	/// length of the pending fast open request queue.
+	using tcp_fast_open = asio::detail::socket_option::integer<IPPROTO_TCP, TCP_FASTOPEN>;
+#endif
+
+#if defined(TCP_FASTOPEN_CONNECT)
+	/// Socket option to enable tcp fast open on a connecting socket, the connect completes
+	/// immediately if a fast open cookie of the server is cached, and the first write is sent
+	/// with the SYN.
+	using tcp_fast_open_connect = asio::detail::socket_option::boolean<IPPROTO_TCP, TCP_FASTOPEN_CONNECT>;
+#endif
 }
 
 namespace asio
@@ -26,5 +45,8 @@ namespace asio
 		bool reuse_address = true;
 		bool keep_alive = true;
 		bool no_delay = true;
+
+		/// The fast open queue length of the acceptor, 0 means fast open is disabled.
+		int  fast_open_queue_length = 0;
 	};
 }
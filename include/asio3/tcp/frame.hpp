@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2017-2023 zhllxt
+ *
+ * author   : zhllxt
+ * email    : 37792738@qq.com
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <asio3/core/asio.hpp>
+#include <asio3/core/frame_allocator.hpp>
+#include <asio3/core/linear_buffer.hpp>
+#include <asio3/tcp/core.hpp>
+
+namespace asio
+{
+	/**
+	 * @brief The result of matching a frame at the front of the buffered data.
+	 */
+	struct frame_view
+	{
+		/// the total bytes of the frame, include the header or the delimiter, 0 means incomplete.
+		std::size_t      size = 0;
+
+		/// the payload of the frame.
+		std::string_view payload{};
+	};
+
+	/**
+	 * @brief Framing by a length field of a fixed size header.
+	 * +----------------------------------+----------+
+	 * |             HEADER               |          |
+	 * +--------+---------------+---------+ PAYLOAD  |
+	 * |  ...   | LENGTH (1~8)  |   ...   |          |
+	 * +--------+---------------+---------+----------+
+	 */
+	struct length_prefix_framing
+	{
+		/// the total bytes of the header.
+		std::size_t header_size            = 4;
+
+		/// the offset of the length field in the header.
+		std::size_t length_offset          = 0;
+
+		/// the bytes of the length field, 1, 2, 4 or 8.
+		std::size_t length_size            = 4;
+
+		/// the length field is big endian or little endian.
+		bool        big_endian             = true;
+
+		/// the length field is the length of the whole frame, include the header.
+		bool        length_includes_header = false;
+
+		/// the maximum bytes of a frame, a larger frame is an error of asio::error::message_size.
+		std::size_t max_frame_size         = 16 * 1024 * 1024;
+
+		inline frame_view parse(std::string_view data, asio::error_code& ec) const noexcept
+		{
+			ec = {};
+
+			if (length_offset + length_size > header_size || length_size == 0 || length_size > 8)
+			{
+				ec = asio::error::invalid_argument;
+				return {};
+			}
+
+			if (data.size() < header_size)
+				return {};
+
+			std::uint64_t length = 0;
+
+			for (std::size_t i = 0; i < length_size; ++i)
+			{
+				std::size_t k = big_endian ? i : length_size - 1 - i;
+				length = (length << 8) | std::uint8_t(data[length_offset + k]);
+			}
+
+			std::uint64_t frame_size = length_includes_header ? length : length + header_size;
+
+			if (frame_size < header_size || frame_size > max_frame_size)
+			{
+				ec = asio::error::message_size;
+				return {};
+			}
+
+			if (data.size() < frame_size)
+				return {};
+
+			return { std::size_t(frame_size), data.substr(header_size, std::size_t(frame_size) - header_size) };
+		}
+	};
+
+	/**
+	 * @brief Framing by a varint (unsigned LEB128, the protobuf encoding) length prefix.
+	 * +---------------------+----------+
+	 * | LENGTH (1~10 bytes) | PAYLOAD  |
+	 * +---------------------+----------+
+	 */
+	struct varint_framing
+	{
+		/// the maximum bytes of a frame, a larger frame is an error of asio::error::message_size.
+		std::size_t max_frame_size = 16 * 1024 * 1024;
+
+		inline frame_view parse(std::string_view data, asio::error_code& ec) const noexcept
+		{
+			ec = {};
+
+			std::uint64_t length = 0;
+
+			for (std::size_t i = 0; i < 10; ++i)
+			{
+				if (i >= data.size())
+					return {};
+
+				std::uint8_t byte = std::uint8_t(data[i]);
+
+				length |= std::uint64_t(byte & 0x7f) << (7 * i);
+
+				if ((byte & 0x80) == 0)
+				{
+					std::size_t header_size = i + 1;
+
+					if (length > max_frame_size - header_size)
+					{
+						ec = asio::error::message_size;
+						return {};
+					}
+
+					if (data.size() - header_size < length)
+						return {};
+
+					return { header_size + std::size_t(length), data.substr(header_size, std::size_t(length)) };
+				}
+			}
+
+			ec = asio::error::message_size;
+			return {};
+		}
+	};
+
+	/**
+	 * @brief Framing by a delimiter, the payload excludes the delimiter.
+	 */
+	struct delimiter_framing
+	{
+		std::string delimiter      = "\r\n";
+
+		/// the maximum bytes of a frame, a larger frame is an error of asio::error::message_size.
+		std::size_t max_frame_size = 64 * 1024;
+
+		inline frame_view parse(std::string_view data, asio::error_code& ec) const noexcept
+		{
+			ec = {};
+
+			if (delimiter.empty())
+			{
+				ec = asio::error::invalid_argument;
+				return {};
+			}
+
+			std::size_t pos = data.find(delimiter);
+			if (pos == std::string_view::npos)
+			{
+				if (data.size() >= max_frame_size)
+					ec = asio::error::message_size;
+				return {};
+			}
+
+			if (pos + delimiter.size() > max_frame_size)
+			{
+				ec = asio::error::message_size;
+				return {};
+			}
+
+			return { pos + delimiter.size(), data.substr(0, pos) };
+		}
+	};
+
+	template<typename T>
+	concept is_framing = requires(const T& f, std::string_view data, asio::error_code& ec)
+	{
+		{ f.parse(data, ec) } -> std::convertible_to<frame_view>;
+	};
+}
+
+namespace asio::detail
+{
+	/// the bytes of one read_some when no frame is complete.
+	constexpr std::size_t frame_read_size = 16 * 1024;
+
+	struct async_read_frame_op
+	{
+		template<typename AsyncReadStream, typename Container, typename Framing>
+		auto operator()(
+			auto state, std::reference_wrapper<AsyncReadStream> stream_ref,
+			std::reference_wrapper<basic_linear_buffer<Container>> buffer_ref, Framing framing) -> void
+		{
+			state.reset_cancellation_state(asio::enable_terminal_cancellation());
+
+			auto& stream = stream_ref.get();
+			auto& buffer = buffer_ref.get();
+
+			std::vector<std::string_view> frames;
+
+			bool suspended = false;
+
+			for (;;)
+			{
+				asio::const_buffer buf = buffer.data();
+
+				std::string_view data{ static_cast<const char*>(buf.data()), buf.size() };
+
+				asio::error_code ec{};
+
+				std::size_t total = 0;
+
+				for (;;)
+				{
+					frame_view frame = framing.parse(data.substr(total), ec);
+					if (ec || frame.size == 0)
+						break;
+
+					total += frame.size;
+					frames.emplace_back(frame.payload);
+				}
+
+				// the consume of the linear buffer doesn't touch the memory, even if the whole input
+				// sequence is consumed, so the views are valid until the next prepare of the buffer.
+				if (!frames.empty())
+				{
+					buffer.consume(total);
+
+					// the frames were buffered by the former call.
+					if (!suspended)
+						co_await asio::detail::async_yield(state);
+
+					co_return{ asio::error_code{}, std::move(frames) };
+				}
+
+				if (ec || buffer.size() == buffer.max_size())
+				{
+					if (!suspended)
+						co_await asio::detail::async_yield(state);
+
+					co_return{ ec ? ec : asio::error::message_size, std::move(frames) };
+				}
+
+				std::size_t space = buffer.max_size() - buffer.size();
+
+				auto [e1, n1] = co_await stream.async_read_some(
+					buffer.prepare((std::min)(space, frame_read_size)), use_nothrow_deferred);
+
+				suspended = true;
+
+				buffer.commit(n1);
+
+				if (e1)
+					co_return{ e1, std::move(frames) };
+			}
+		}
+	};
+}
+
+namespace asio
+{
+	/**
+	 * @brief Read until at least one frame is complete, then return all the complete frames in the buffer.
+	 * The returned payloads point into the buffer without copying, they are consumed from the buffer
+	 * already, and they are valid until the next read operation on the buffer.
+	 * @param s - The stream to read from.
+	 * @param buffer - The linear buffer which holds the received data between the calls.
+	 * @param framing - asio::length_prefix_framing, asio::varint_framing, asio::delimiter_framing, or a
+	 *                  user defined type with a member: frame_view parse(std::string_view, error_code&) const;
+	 * @param token - The completion handler to invoke when the operation completes.
+	 *	  The equivalent function signature of the handler must be:
+     *    @code
+     *    void handler(const asio::error_code& ec, std::vector<std::string_view> frames);
+	 */
+	template<typename AsyncReadStream, typename Container, typename Framing,
+		ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, std::vector<std::string_view>)) ReadToken
+		ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(typename AsyncReadStream::executor_type)>
+	requires is_framing<std::remove_cvref_t<Framing>>
+	ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(ReadToken, void(asio::error_code, std::vector<std::string_view>))
+	async_read_frame(
+		AsyncReadStream& s, basic_linear_buffer<Container>& buffer, Framing&& framing,
+		ReadToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(typename AsyncReadStream::executor_type))
+	{
+		return asio::async_initiate<ReadToken, void(asio::error_code, std::vector<std::string_view>)>(
+			asio::detail::recycled_co_composed<void(asio::error_code, std::vector<std::string_view>)>(
+				detail::async_read_frame_op{}, s),
+			token, std::ref(s), std::ref(buffer), std::forward<Framing>(framing));
+	}
+}
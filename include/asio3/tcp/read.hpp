@@ -11,6 +11,8 @@
 #pragma once
 
 #include <asio3/core/asio.hpp>
+#include <asio3/core/frame_allocator.hpp>
+#include <asio3/core/adaptive_buffer.hpp>
 #include <asio3/tcp/core.hpp>
 
 namespace asio
@@ -89,3 +91,115 @@ async_read_some(AsyncReadStream& s, const MutableBufferSequence& buffers,
 	return s.async_read_some(buffers, std::forward<ReadToken>(token));
 }
 }
+
+namespace asio::detail
+{
+	struct async_read_some_adaptive_op
+	{
+		template<typename AsyncReadStream>
+		auto operator()(
+			auto state, std::reference_wrapper<AsyncReadStream> stream_ref,
+			std::reference_wrapper<adaptive_read_buffer> buffer_ref) -> void
+		{
+			state.reset_cancellation_state(asio::enable_terminal_cancellation());
+
+			auto& s = stream_ref.get();
+			auto& buffer = buffer_ref.get();
+
+			if constexpr (requires(asio::error_code& ec) { s.native_non_blocking(true, ec); s.native_handle(); })
+			{
+				asio::error_code ec{};
+
+				// only the native mode is switched, which the async operations of asio use already, the
+				// user mode is untouched, so the synchronous operations of the user still block.
+				if (!s.native_non_blocking())
+				{
+					s.native_non_blocking(true, ec);
+					if (ec)
+						co_return{ ec, std::size_t(0) };
+				}
+
+				bool readable = buffer.has_storage(), suspended = false;
+
+				for (;;)
+				{
+					if (readable)
+					{
+						asio::mutable_buffer b = buffer.prepare();
+
+						asio::detail::signed_size_type r = asio::detail::socket_ops::recv1(
+							s.native_handle(), b.data(), b.size(), 0, ec);
+
+						if (ec == asio::error::interrupted)
+							continue;
+
+						std::size_t n = r > 0 ? std::size_t(r) : 0;
+
+						if (r == 0 && b.size() > 0)
+							ec = asio::error::eof;
+
+						if (ec != asio::error::would_block && ec != asio::error::try_again)
+						{
+							buffer.commit(n);
+
+							// the data was ready already, don't complete inside the initiating function,
+							// otherwise a read loop recurses and starves the other handlers.
+							if (!suspended)
+								co_await asio::detail::async_yield(state);
+
+							co_return{ ec, n };
+						}
+					}
+
+					// nothing to read, don't pin the storage while the connection is idle.
+					buffer.release();
+
+					auto [e1] = co_await s.async_wait(asio::socket_base::wait_read, use_nothrow_deferred);
+
+					suspended = true;
+
+					if (e1)
+						co_return{ e1, std::size_t(0) };
+
+					readable = true;
+				}
+			}
+			else
+			{
+				auto [e1, n1] = co_await s.async_read_some(buffer.prepare(), use_nothrow_deferred);
+
+				buffer.commit(n1);
+
+				co_return{ e1, n1 };
+			}
+		}
+	};
+}
+
+namespace asio
+{
+	/**
+	 * @brief Read some data into the adaptive read buffer, the buffer size adapts to the recent reads.
+	 * For a socket, the storage is borrowed from the pool only when the socket is readable, so an
+	 * idle connection doesn't pin a buffer. The user visible blocking mode of the socket is not changed.
+	 * @param s - The stream to read from.
+	 * @param buffer - The adaptive read buffer, the data is available by buffer.data() after the read.
+	 * @param token - The completion handler to invoke when the operation completes.
+	 *	  The equivalent function signature of the handler must be:
+     *    @code
+     *    void handler(const asio::error_code& ec, std::size_t bytes_transferred);
+	 */
+	template<typename AsyncReadStream,
+		ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, std::size_t)) ReadToken
+		ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(typename AsyncReadStream::executor_type)>
+	ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(ReadToken, void(asio::error_code, std::size_t))
+	async_read_some_adaptive(
+		AsyncReadStream& s, adaptive_read_buffer& buffer,
+		ReadToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(typename AsyncReadStream::executor_type))
+	{
+		return asio::async_initiate<ReadToken, void(asio::error_code, std::size_t)>(
+			asio::detail::recycled_co_composed<void(asio::error_code, std::size_t)>(
+				detail::async_read_some_adaptive_op{}, s),
+			token, std::ref(s), std::ref(buffer));
+	}
+}
@@ -0,0 +1,355 @@
+/*
+ * Copyright (c) 2017-2023 zhllxt
+ *
+ * author   : zhllxt
+ * email    : 37792738@qq.com
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+#include <asio3/core/asio.hpp>
+#include <asio3/core/buffer_pool.hpp>
+#include <asio3/core/registered_buffer_pool.hpp>
+#include <asio3/core/timing_wheel.hpp>
+#include <asio3/core/detail/idle_counter.hpp>
+#include <asio3/tcp/core.hpp>
+#include <asio3/tcp/splice.hpp>
+
+namespace asio
+{
+	/**
+	 * @brief The live byte counters of a relay, they can be read from any thread.
+	 */
+	struct relay_stats
+	{
+		std::atomic<std::uint64_t> a_to_b{ 0 };
+		std::atomic<std::uint64_t> b_to_a{ 0 };
+	};
+
+	struct relay_option
+	{
+		/// The buffer size of each direction when the data is relayed by copying.
+		std::size_t                         buffer_size  = detail::relay_chunk_size;
+
+		/// The pool of the buffers, nullptr means the asio::buffer_pool::shared().
+		buffer_pool*                        pool         = nullptr;
+
+		/// Borrow the buffers from the asio::registered_buffer_pool_service of the executor's context
+		/// when both streams are sockets, the reads and writes of them are the fixed buffer operations
+		/// when asio uses io_uring. The buffer_size is ignored then, and the pool is used when no
+		/// registered block is available.
+		bool                                registered   = false;
+
+		/// The relay is stopped with asio::error::timed_out when neither direction transfers
+		/// any data for this duration, zero means no idle timeout. The timeout is detected
+		/// within a quarter of it.
+		std::chrono::steady_clock::duration idle_timeout = std::chrono::minutes(10);
+
+		/// Move the data by splice when both streams are sockets, see asio::async_relay_splice.
+		bool                                splice       = true;
+
+		/// The live counters, it must outlive the relay.
+		relay_stats*                        stats        = nullptr;
+	};
+}
+
+namespace asio::detail
+{
+	template<typename T>
+	concept relay_splice_capable = requires(T& s, asio::error_code& ec)
+	{
+		s.native_handle();
+		s.native_non_blocking(true, ec);
+		s.async_wait(asio::socket_base::wait_read, use_nothrow_deferred);
+	};
+
+	inline asio::mutable_buffer relay_buffer(pooled_buffer& b, std::size_t n) noexcept
+	{
+		return asio::mutable_buffer(b.data(), n);
+	}
+
+	inline asio::mutable_registered_buffer relay_buffer(registered_block& b, std::size_t n) noexcept
+	{
+		return b.buffer(n);
+	}
+
+	template<typename AsyncStream>
+	inline void relay_cancel(AsyncStream& s)
+	{
+		asio::error_code ec{};
+
+		if constexpr (requires { s.cancel(ec); })
+			s.cancel(ec);
+		else if constexpr (requires { s.cancel(); })
+			s.cancel();
+		else
+			s.lowest_layer().cancel(ec);
+	}
+
+	template<typename AsyncStreamA, typename AsyncStreamB>
+	class relay_impl : public std::enable_shared_from_this<relay_impl<AsyncStreamA, AsyncStreamB>>
+	{
+	public:
+		using handler_type = asio::any_completion_handler<void(asio::error_code, std::size_t, std::size_t)>;
+
+		relay_impl(AsyncStreamA& a, AsyncStreamB& b, relay_option opt, handler_type handler)
+			: a_(a), b_(b), option_(std::move(opt)), handler_(std::move(handler)), ticker_(a.get_executor())
+		{
+		}
+
+		void start()
+		{
+			if (asio::cancellation_slot slot = asio::get_associated_cancellation_slot(handler_); slot.is_connected())
+			{
+				slot.assign([this](asio::cancellation_type_t)
+				{
+					this->stop(asio::error::operation_aborted);
+				});
+			}
+
+			pending_ = 2;
+
+			this->transfer<true>(a_, b_);
+			this->transfer<false>(b_, a_);
+
+			if (option_.idle_timeout > std::chrono::steady_clock::duration::zero())
+			{
+				++pending_;
+				this->tick();
+			}
+		}
+
+	protected:
+		template<bool AToB, typename From, typename To>
+		void transfer(From& from, To& to)
+		{
+			if constexpr (relay_splice_capable<From> && relay_splice_capable<To>)
+			{
+				if (option_.splice)
+				{
+					asio::async_relay_splice(from, to,
+					[this](std::size_t n) mutable
+					{
+						this->on_transfer<AToB>(n);
+					},
+					[self = this->shared_from_this(), &to](const asio::error_code& ec, std::size_t) mutable
+					{
+						self->on_direction_done(to, ec);
+					});
+					return;
+				}
+			}
+
+			// the registered buffer is only meaningful for the socket operations.
+			if constexpr (relay_splice_capable<From> && relay_splice_capable<To>)
+			{
+				if (option_.registered)
+				{
+					if (registered_block block = asio::acquire_registered_buffer(from.get_executor()))
+					{
+						this->copy<AToB>(from, to, std::make_shared<registered_block>(std::move(block)));
+						return;
+					}
+				}
+			}
+
+			buffer_pool& pool = option_.pool ? *option_.pool : buffer_pool::shared();
+
+			this->copy<AToB>(from, to, std::make_shared<pooled_buffer>(pool.acquire(option_.buffer_size)));
+		}
+
+		template<bool AToB, typename From, typename To, typename Buffer>
+		void copy(From& from, To& to, std::shared_ptr<Buffer> buf)
+		{
+			from.async_read_some(relay_buffer(*buf, buf->size()),
+			[self = this->shared_from_this(), &from, &to, buf](const asio::error_code& e1, std::size_t n1) mutable
+			{
+				if (e1)
+				{
+					self->on_direction_done(to, e1 == asio::error::eof ? asio::error_code{} : e1);
+					return;
+				}
+
+				asio::async_write(to, relay_buffer(*buf, n1),
+				[self = std::move(self), &from, &to, buf](const asio::error_code& e2, std::size_t n2) mutable
+				{
+					if (e2)
+					{
+						self->on_direction_done(to, e2);
+						return;
+					}
+
+					self->template on_transfer<AToB>(n2);
+
+					if (self->stopped_)
+						self->on_direction_done(to, asio::error::operation_aborted);
+					else
+						self->template copy<AToB>(from, to, std::move(buf));
+				});
+			});
+		}
+
+		template<bool AToB>
+		inline void on_transfer(std::size_t n) noexcept
+		{
+			idle_.touch();
+
+			if constexpr (AToB)
+			{
+				a_to_b_ += n;
+				if (option_.stats)
+					option_.stats->a_to_b.fetch_add(n, std::memory_order_relaxed);
+			}
+			else
+			{
+				b_to_a_ += n;
+				if (option_.stats)
+					option_.stats->b_to_a.fetch_add(n, std::memory_order_relaxed);
+			}
+		}
+
+		template<typename To>
+		void on_direction_done(To& to, const asio::error_code& ec)
+		{
+			if (ec)
+			{
+				this->stop(ec);
+			}
+			else
+			{
+				// the source reached eof, pass the half close on, the other direction goes on.
+				asio::error_code ec_ignore{};
+				to.lowest_layer().shutdown(asio::socket_base::shutdown_send, ec_ignore);
+			}
+
+			if (++done_ == 2)
+				ticker_.cancel();
+
+			this->release();
+		}
+
+		void tick()
+		{
+			ticker_.expires_after(detail::idle_counter::interval(option_.idle_timeout));
+			ticker_.async_wait([self = this->shared_from_this()](const asio::error_code& ec) mutable
+			{
+				if (ec || self->stopped_ || self->done_ == 2)
+				{
+					self->release();
+					return;
+				}
+
+				if (self->idle_.tick())
+				{
+					self->stop(asio::error::timed_out);
+					self->release();
+					return;
+				}
+
+				self->tick();
+			});
+		}
+
+		void stop(const asio::error_code& ec)
+		{
+			if (stopped_)
+				return;
+
+			stopped_ = true;
+			error_ = ec;
+
+			relay_cancel(a_);
+			relay_cancel(b_);
+
+			ticker_.cancel();
+		}
+
+		void release()
+		{
+			if (--pending_ > 0)
+				return;
+
+			if (asio::cancellation_slot slot = asio::get_associated_cancellation_slot(handler_); slot.is_connected())
+				slot.clear();
+
+			asio::dispatch(asio::append(std::move(handler_), error_, a_to_b_, b_to_a_));
+		}
+
+	protected:
+		AsyncStreamA&     a_;
+		AsyncStreamB&     b_;
+
+		relay_option      option_;
+
+		handler_type      handler_;
+
+		asio::deadline    ticker_;
+
+		asio::error_code  error_{};
+
+		std::size_t       a_to_b_  = 0;
+		std::size_t       b_to_a_  = 0;
+
+		int               pending_ = 0;
+		int               done_    = 0;
+
+		detail::idle_counter idle_{};
+
+		bool              stopped_ = false;
+	};
+
+	struct async_relay_initiation
+	{
+		template<typename Handler, typename AsyncStreamA, typename AsyncStreamB>
+		inline void operator()(Handler&& handler,
+			std::reference_wrapper<AsyncStreamA> a, std::reference_wrapper<AsyncStreamB> b, relay_option opt) const
+		{
+			using impl_type = relay_impl<AsyncStreamA, AsyncStreamB>;
+
+			std::make_shared<impl_type>(a.get(), b.get(), std::move(opt),
+				typename impl_type::handler_type(std::forward<Handler>(handler)))->start();
+		}
+	};
+}
+
+namespace asio
+{
+	/**
+	 * @brief Relay the data between two streams in both directions, until both of them reach
+	 * eof, or an error occurs, or the relay is idle for the idle timeout.
+	 * When one direction reaches eof, the write side of its destination is shutdown, and the
+	 * other direction goes on. When one direction fails, both directions are cancelled.
+	 * The data is moved by splice when both streams are sockets on linux, otherwise it is
+	 * copied through the pooled buffers, so any AsyncStream works, e.g. asio::rate_limited_stream.
+	 * The streams must use the same executor (strand), and they must outlive the relay.
+	 * @param a - The first stream.
+	 * @param b - The second stream.
+	 * @param opt - The relay option.
+	 * @param token - The completion handler to invoke when the operation completes.
+	 *	  The equivalent function signature of the handler must be:
+     *    @code
+     *    void handler(const asio::error_code& ec, std::size_t a_to_b, std::size_t b_to_a);
+	 *    The ec is success when both streams reached eof.
+	 * @eg:
+	 * auto [ec, up, down] = co_await asio::async_relay(front, back, { .idle_timeout = std::chrono::minutes(5) });
+	 */
+	template<typename AsyncStreamA, typename AsyncStreamB,
+		ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, std::size_t, std::size_t)) RelayToken
+		ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(typename AsyncStreamA::executor_type)>
+	ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(RelayToken, void(asio::error_code, std::size_t, std::size_t))
+	async_relay(
+		AsyncStreamA& a, AsyncStreamB& b, relay_option opt = {},
+		RelayToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(typename AsyncStreamA::executor_type))
+	{
+		return asio::async_initiate<RelayToken, void(asio::error_code, std::size_t, std::size_t)>(
+			detail::async_relay_initiation{}, token, std::ref(a), std::ref(b), std::move(opt));
+	}
+}
@@ -0,0 +1,322 @@
+/*
+ * Copyright (c) 2017-2023 zhllxt
+ *
+ * author   : zhllxt
+ * email    : 37792738@qq.com
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <asio3/core/asio.hpp>
+#include <asio3/core/frame_allocator.hpp>
+#include <asio3/core/detail/type_traits.hpp>
+#include <asio3/tcp/core.hpp>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace asio::detail
+{
+	struct default_relay_transfer_callback
+	{
+		inline void operator()(std::size_t bytes_transferred) noexcept
+		{
+			detail::ignore_unused(bytes_transferred);
+		}
+	};
+
+	/// the maximum bytes of one splice or copy.
+	constexpr std::size_t relay_chunk_size = 64 * 1024;
+
+	/// the splice relay yields to the other handlers after moving this many bytes without waiting.
+	constexpr std::size_t relay_yield_size = 16 * relay_chunk_size;
+
+#if defined(__linux__) && defined(SPLICE_F_MOVE)
+	struct splice_pipe
+	{
+		splice_pipe() noexcept
+		{
+			if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) != 0)
+			{
+				fds[0] = -1;
+				fds[1] = -1;
+			}
+		}
+
+		~splice_pipe()
+		{
+			if (fds[0] != -1)
+				::close(fds[0]);
+			if (fds[1] != -1)
+				::close(fds[1]);
+		}
+
+		splice_pipe(const splice_pipe&) = delete;
+		splice_pipe& operator=(const splice_pipe&) = delete;
+
+		inline bool is_open() const noexcept { return fds[0] != -1; }
+
+		int fds[2];
+	};
+
+	/**
+	 * @brief splice once without blocking.
+	 * @return the bytes moved, 0 means eof, -1 means failed and the ec is set.
+	 */
+	inline ::ssize_t splice_some(int fd_in, int fd_out, std::size_t len, asio::error_code& ec) noexcept
+	{
+		for (;;)
+		{
+			::ssize_t n = ::splice(fd_in, nullptr, fd_out, nullptr, len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+			if (n >= 0)
+			{
+				ec = {};
+				return n;
+			}
+
+			if (errno == EINTR)
+				continue;
+
+			ec = asio::error_code(errno, asio::error::get_system_category());
+			return -1;
+		}
+	}
+#endif
+
+	struct async_relay_copy_op
+	{
+		template<typename AsyncReadStream, typename AsyncWriteStream, typename TransferCallback>
+		auto operator()(
+			auto state, std::reference_wrapper<AsyncReadStream> from_ref,
+			std::reference_wrapper<AsyncWriteStream> to_ref, TransferCallback on_transfer) -> void
+		{
+			state.reset_cancellation_state(asio::enable_terminal_cancellation());
+
+			auto& from = from_ref.get();
+			auto& to = to_ref.get();
+
+			std::vector<char> data(relay_chunk_size);
+
+			std::size_t total = 0;
+
+			for (;;)
+			{
+				auto [e1, n1] = co_await from.async_read_some(asio::buffer(data), use_nothrow_deferred);
+				if (e1)
+					co_return{ e1 == asio::error::eof ? asio::error_code{} : e1, total };
+
+				auto [e2, n2] = co_await asio::async_write(to, asio::buffer(data.data(), n1),
+					asio::transfer_all(), use_nothrow_deferred);
+				if (e2)
+					co_return{ e2, total };
+
+				total += n2;
+
+				on_transfer(n2);
+			}
+		}
+	};
+
+	struct async_relay_splice_op
+	{
+		template<typename SourceSocket, typename DestSocket, typename TransferCallback>
+		auto operator()(
+			auto state, std::reference_wrapper<SourceSocket> from_ref,
+			std::reference_wrapper<DestSocket> to_ref, TransferCallback on_transfer) -> void
+		{
+			state.reset_cancellation_state(asio::enable_terminal_cancellation());
+
+			auto& from = from_ref.get();
+			auto& to = to_ref.get();
+
+		#if defined(__linux__) && defined(SPLICE_F_MOVE)
+			splice_pipe pipe{};
+
+			asio::error_code ec{};
+
+			if (pipe.is_open())
+			{
+				// splice never blocks on the pipe, but on the sockets only when they are nonblocking.
+				from.native_non_blocking(true, ec);
+				if (!ec)
+					to.native_non_blocking(true, ec);
+			}
+
+			if (pipe.is_open() && !ec)
+			{
+				std::size_t total = 0;
+
+				// the bytes which are moved since the last suspension.
+				std::size_t unyielded = 0;
+
+				bool first = true, suspended = false, fallback = false;
+
+				for (;;)
+				{
+					if (!!state.cancelled())
+					{
+						ec = asio::error::operation_aborted;
+						break;
+					}
+
+					// the sockets are always ready when the peers are fast, yield to the other
+					// handlers of the thread periodically.
+					if (unyielded >= relay_yield_size)
+					{
+						co_await asio::detail::async_yield(state);
+						unyielded = 0;
+						suspended = true;
+						continue;
+					}
+
+					// socket -> pipe
+					::ssize_t n = splice_some(from.native_handle(), pipe.fds[1], relay_chunk_size, ec);
+
+					if (n < 0)
+					{
+						if (ec == asio::error::would_block || ec == asio::error::try_again)
+						{
+							auto [e1] = co_await from.async_wait(asio::socket_base::wait_read, use_nothrow_deferred);
+							unyielded = 0;
+							suspended = true;
+							if (e1)
+							{
+								ec = e1;
+								break;
+							}
+							continue;
+						}
+
+						// the socket does not support splice, relay by copying.
+						fallback = first &&
+							(ec == asio::error::invalid_argument || ec == asio::error::operation_not_supported);
+
+						break;
+					}
+
+					if (n == 0)
+						break;
+
+					first = false;
+
+					// pipe -> socket
+					for (std::size_t pending = std::size_t(n); pending > 0;)
+					{
+						::ssize_t m = splice_some(pipe.fds[0], to.native_handle(), pending, ec);
+
+						if (m < 0)
+						{
+							if (ec == asio::error::would_block || ec == asio::error::try_again)
+							{
+								auto [e2] = co_await to.async_wait(asio::socket_base::wait_write, use_nothrow_deferred);
+								unyielded = 0;
+								suspended = true;
+								if (e2)
+								{
+									ec = e2;
+									break;
+								}
+								continue;
+							}
+
+							break;
+						}
+
+						pending -= std::size_t(m);
+					}
+
+					if (ec)
+						break;
+
+					total += std::size_t(n);
+					unyielded += std::size_t(n);
+
+					on_transfer(std::size_t(n));
+				}
+
+				if (!fallback)
+				{
+					if (!suspended)
+						co_await asio::detail::async_yield(state);
+
+					co_return{ ec, total };
+				}
+			}
+		#endif
+
+			auto [e3, n3] = co_await asio::async_initiate<decltype(use_nothrow_deferred),
+				void(asio::error_code, std::size_t)>(
+					asio::detail::recycled_co_composed<void(asio::error_code, std::size_t)>(
+						detail::async_relay_copy_op{}, from),
+					use_nothrow_deferred, std::ref(from), std::ref(to), std::move(on_transfer));
+
+			co_return{ e3, n3 };
+		}
+	};
+}
+
+namespace asio
+{
+	/**
+	 * @brief Relay the data from one socket to another socket until the source socket reaches eof.
+	 * On linux the data is moved by splice through a pipe, without copying to the user space,
+	 * otherwise, or if the socket does not support splice, the data is relayed by copying.
+	 * Call it twice with the sockets swapped to relay both directions.
+	 * @param from - The source socket.
+	 * @param to - The destination socket.
+	 * @param on_transfer - The callback which is called after each chunk is relayed, the
+	 *                      signature is: void(std::size_t bytes_transferred)
+	 * @param token - The completion handler to invoke when the operation completes.
+	 *	  The equivalent function signature of the handler must be:
+     *    @code
+     *    void handler(const asio::error_code& ec, std::size_t bytes_transferred);
+	 *    The ec is success when the source socket reached eof.
+	 */
+	template<typename SourceSocket, typename DestSocket, typename TransferCallback,
+		ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, std::size_t)) RelayToken
+		ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(typename SourceSocket::executor_type)>
+	requires std::invocable<TransferCallback, std::size_t>
+	ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(RelayToken, void(asio::error_code, std::size_t))
+	async_relay_splice(
+		SourceSocket& from, DestSocket& to, TransferCallback&& on_transfer,
+		RelayToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(typename SourceSocket::executor_type))
+	{
+		return asio::async_initiate<RelayToken, void(asio::error_code, std::size_t)>(
+			asio::detail::recycled_co_composed<void(asio::error_code, std::size_t)>(
+				detail::async_relay_splice_op{}, from),
+			token, std::ref(from), std::ref(to), std::forward<TransferCallback>(on_transfer));
+	}
+
+	/**
+	 * @brief Relay the data from one socket to another socket until the source socket reaches eof.
+	 * @param from - The source socket.
+	 * @param to - The destination socket.
+	 * @param token - The completion handler to invoke when the operation completes.
+	 *	  The equivalent function signature of the handler must be:
+     *    @code
+     *    void handler(const asio::error_code& ec, std::size_t bytes_transferred);
+	 *    The ec is success when the source socket reached eof.
+	 */
+	template<typename SourceSocket, typename DestSocket,
+		ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, std::size_t)) RelayToken
+		ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(typename SourceSocket::executor_type)>
+	requires (!std::invocable<RelayToken, std::size_t>)
+	ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(RelayToken, void(asio::error_code, std::size_t))
+	async_relay_splice(
+		SourceSocket& from, DestSocket& to,
+		RelayToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(typename SourceSocket::executor_type))
+	{
+		return asio::async_initiate<RelayToken, void(asio::error_code, std::size_t)>(
+			asio::detail::recycled_co_composed<void(asio::error_code, std::size_t)>(
+				detail::async_relay_splice_op{}, from),
+			token, std::ref(from), std::ref(to), detail::default_relay_transfer_callback{});
+	}
+}
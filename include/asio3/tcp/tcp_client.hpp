@@ -10,9 +10,25 @@
 
 #pragma once
 
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <random>
+
 #include <asio3/core/asio.hpp>
+#include <asio3/core/frame_allocator.hpp>
+#include <asio3/core/mpsc_queue.hpp>
+#include <asio3/core/rate_limit.hpp>
+#include <asio3/core/strutil.hpp>
+#include <asio3/core/timer.hpp>
+#include <asio3/core/with_deadline.hpp>
+#include <asio3/core/detail/netutil.hpp>
 #include <asio3/tcp/core.hpp>
+#include <asio3/tcp/connect.hpp>
+#include <asio3/tcp/read.hpp>
+#include <asio3/tcp/write.hpp>
 #include <asio3/socks5/core.hpp>
+#include <asio3/socks5/handshake.hpp>
 
 namespace asio
 {
@@ -26,26 +42,521 @@ namespace asio
 		std::optional<asio::any_io_executor>     executor{};
 
 		std::optional<socks5::option>            socks5_option{};
+
+		/// The timeout of one connection attempt, include the socks5 handshake.
+		std::chrono::steady_clock::duration      connect_timeout     =
+			std::chrono::milliseconds(asio::detail::tcp_connect_timeout);
+
+		/// Reconnect automatically when the connection is failed or lost.
+		bool                                     auto_reconnect      = true;
+
+		/// The reconnect delay is doubled after each failure, from the min delay to the max delay,
+		/// and a random jitter of up to half of the delay is subtracted.
+		std::chrono::steady_clock::duration      reconnect_min_delay = std::chrono::milliseconds(100);
+		std::chrono::steady_clock::duration      reconnect_max_delay = std::chrono::seconds(30);
+
+		/// The maximum number of queued messages which are written by one gathering write.
+		std::size_t                              max_write_batch     = 64;
+
+		/// The bytes per second of the connection, 0 means unlimited.
+		std::uint64_t                            read_rate           = 0;
+		std::uint64_t                            write_rate          = 0;
+
+		/// The shared token buckets which are charged together with the connection, e.g. the
+		/// per user and the global limits.
+		std::vector<std::shared_ptr<token_bucket>> read_buckets{};
+		std::vector<std::shared_ptr<token_bucket>> write_buckets{};
 	};
+}
 
-	class tcp_client
+namespace asio::detail
+{
+	struct tcp_socket_option_setter
 	{
-	public:
-		explicit tcp_client(tcp_client_option opt) : option_(std::move(opt))
+		inline void operator()(auto& sock) const noexcept
 		{
+			asio::error_code ec{};
+			sock.set_option(asio::socket_base::reuse_address(opt.reuse_address), ec);
+			sock.set_option(asio::socket_base::keep_alive(opt.keep_alive), ec);
+			sock.set_option(asio::ip::tcp::no_delay(opt.no_delay), ec);
+		}
+
+		tcp_socket_option opt{};
+	};
+
+	struct async_connect_with_option_op
+	{
+		template<typename AsyncStream>
+		auto operator()(
+			auto state, std::reference_wrapper<AsyncStream> sock_ref,
+			std::reference_wrapper<tcp_client_option> opt_ref) -> void
+		{
+			state.reset_cancellation_state(asio::enable_terminal_cancellation());
+
+			auto& sock = sock_ref.get();
+
+			tcp_client_option& opt = opt_ref.get();
+
+			tcp_socket_option_setter setter{ opt.socket_option };
+
+			if (!opt.socks5_option.has_value())
+			{
+				auto [e1, ep1] = co_await asio::async_connect(
+					sock, opt.server_address, opt.server_port, setter, use_nothrow_deferred);
+				co_return{ e1, ep1 };
+			}
 
+			socks5::option& s5opt = opt.socks5_option.value();
+
+			if (s5opt.dest_address.empty())
+			{
+				s5opt.dest_address = opt.server_address;
+				s5opt.dest_port = opt.server_port;
+			}
+
+			if (s5opt.cmd == socks5::command{})
+				s5opt.cmd = socks5::command::connect;
+
+			auto [e1, ep1] = co_await asio::async_connect(
+				sock, s5opt.proxy_address, s5opt.proxy_port, setter, use_nothrow_deferred);
+			if (e1)
+				co_return{ e1, ep1 };
+
+			auto [e2] = co_await socks5::async_handshake(sock, s5opt, use_nothrow_deferred);
+			co_return{ e2, ep1 };
 		}
+	};
+}
+
+namespace asio
+{
+	/**
+	 * @brief Asynchronously connect to the server of the client option, the socket_option is applied
+	 * to the socket, and the socks5 handshake is performed if the socks5_option is set.
+	 * @param sock - The socket reference to be connected.
+	 * @param opt - The client option reference, the bound address of the socks5 option is filled.
+	 * @param token - The completion handler to invoke when the operation completes.
+	 *	  The equivalent function signature of the handler must be:
+     *    @code
+     *    void handler(const asio::error_code& ec, asio::ip::tcp::endpoint ep); // ep is the connected endpoint
+	 */
+	template<
+		typename AsyncStream,
+		ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, asio::ip::tcp::endpoint)) ConnectToken
+		ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(typename AsyncStream::executor_type)>
+	ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(ConnectToken, void(asio::error_code, asio::ip::tcp::endpoint))
+	async_connect(
+		AsyncStream& sock, tcp_client_option& opt,
+		ConnectToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(typename AsyncStream::executor_type))
+	{
+		return asio::async_initiate<ConnectToken, void(asio::error_code, asio::ip::tcp::endpoint)>(
+			asio::detail::recycled_co_composed<void(asio::error_code, asio::ip::tcp::endpoint)>(
+				detail::async_connect_with_option_op{}, sock),
+			token, std::ref(sock), std::ref(opt));
+	}
+
+}
+
+namespace asio::detail
+{
+	class tcp_client_impl : public std::enable_shared_from_this<tcp_client_impl>
+	{
+	public:
+		using strand_type = asio::strand<asio::any_io_executor>;
+
+		explicit tcp_client_impl(const asio::any_io_executor& ex, tcp_client_option opt)
+			: strand_(asio::make_strand(ex))
+			, option_(std::move(opt))
+			, notifier_(strand_)
+			, rng_(std::random_device{}())
+		{
+			if (option_.max_write_batch == 0)
+				option_.max_write_batch = 1;
+		}
+
+		inline strand_type& strand() noexcept { return strand_; }
+
+		inline bool is_started() const noexcept { return started_.load(std::memory_order_acquire); }
+
+		inline bool is_connected() const noexcept { return connected_.load(std::memory_order_acquire); }
 
 		bool start()
 		{
+			if (started_.exchange(true, std::memory_order_acq_rel))
+				return false;
+
+			stopped_.store(false, std::memory_order_release);
+
+			asio::dispatch(strand_, [self = shared_from_this()]() mutable
+			{
+				self->stop_signal_.emplace();
+
+				asio::co_spawn(self->strand_, self->run_loop(),
+					asio::bind_cancellation_slot(self->stop_signal_->slot(),
+					[self](std::exception_ptr) mutable
+					{
+						self->stop_signal_.reset();
+						self->started_.store(false, std::memory_order_release);
+					}));
+			});
+
 			return true;
 		}
 
-		void run()
+		void stop()
 		{
+			stopped_.store(true, std::memory_order_release);
+
+			asio::dispatch(strand_, [self = shared_from_this()]() mutable
+			{
+				if (self->stop_signal_)
+					self->stop_signal_->emit(asio::cancellation_type::terminal);
+			});
 		}
 
+		bool send(std::string data)
+		{
+			if (stopped_.load(std::memory_order_acquire))
+				return false;
+
+			queue_.push(std::move(data));
+
+			// pairs with the fence of the writer, either the writer sees the pushed message, or
+			// this sees the sleeping flag, a release and acquire pair can't forbid both misses.
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			// wake up the writer if it is waiting.
+			if (writer_sleeping_.exchange(false, std::memory_order_seq_cst))
+			{
+				asio::post(strand_, [self = shared_from_this()]() mutable
+				{
+					asio::detail::cancel_timer(self->notifier_);
+				});
+			}
+
+			return true;
+		}
+
+		/// the callbacks are invoked in the strand.
+		std::function<void(const asio::error_code&)> on_connect_{};
+		std::function<void(const asio::error_code&)> on_disconnect_{};
+		std::function<void(std::string_view)>        on_recv_{};
+
 	protected:
-		tcp_client_option option_{};
+		std::chrono::steady_clock::duration next_reconnect_delay(std::size_t failures)
+		{
+			using duration = std::chrono::steady_clock::duration;
+
+			duration delay = option_.reconnect_min_delay;
+
+			for (std::size_t i = 0; i < failures && delay < option_.reconnect_max_delay; ++i)
+				delay *= 2;
+
+			delay = (std::min)(delay, option_.reconnect_max_delay);
+
+			// jitter, avoid all the clients reconnecting at the same time.
+			std::uniform_int_distribution<duration::rep> dist(0, delay.count() / 2);
+
+			return delay - duration(dist(rng_));
+		}
+
+		asio::awaitable<void> run_loop()
+		{
+			std::size_t failures = 0;
+
+			while (!stopped_.load(std::memory_order_acquire))
+			{
+				asio::tcp_socket sock(strand_);
+
+				auto [ec, ep] = co_await asio::async_connect(sock, option_,
+					asio::with_deadline(asio::use_nothrow_awaitable, option_.connect_timeout));
+
+				if (on_connect_)
+					on_connect_(ec);
+
+				if (!ec)
+				{
+					failures = 0;
+
+					connected_.store(true, std::memory_order_release);
+
+					ec = co_await transfer(sock);
+
+					connected_.store(false, std::memory_order_release);
+
+					asio::error_code ec_ignore{};
+					sock.shutdown(asio::socket_base::shutdown_both, ec_ignore);
+					sock.close(ec_ignore);
+
+					if (on_disconnect_)
+						on_disconnect_(ec);
+				}
+				else
+				{
+					++failures;
+				}
+
+				if (stopped_.load(std::memory_order_acquire) || !option_.auto_reconnect)
+					break;
+
+				co_await asio::delay(next_reconnect_delay(failures));
+			}
+		}
+
+		asio::awaitable<asio::error_code> transfer(asio::tcp_socket& sock)
+		{
+			asio::error_code ec{};
+
+			if (option_.read_rate || option_.write_rate ||
+				!option_.read_buckets.empty() || !option_.write_buckets.empty())
+			{
+				asio::rate_limited_stream<asio::tcp_socket&> stream(sock);
+
+				stream.read_limit().bucket().set_rate(option_.read_rate);
+				stream.write_limit().bucket().set_rate(option_.write_rate);
+
+				for (auto& bucket : option_.read_buckets)
+					stream.read_limit().add(bucket);
+				for (auto& bucket : option_.write_buckets)
+					stream.write_limit().add(bucket);
+
+				auto result = co_await(read_loop(stream) || write_loop(stream));
+
+				std::visit([&ec](auto& e) mutable { ec = e; }, result);
+			}
+			else
+			{
+				auto result = co_await(read_loop(sock) || write_loop(sock));
+
+				std::visit([&ec](auto& e) mutable { ec = e; }, result);
+			}
+
+			co_return ec;
+		}
+
+		template<typename AsyncStream>
+		asio::awaitable<asio::error_code> read_loop(AsyncStream& sock)
+		{
+			asio::adaptive_read_buffer buf{};
+
+			for (;;)
+			{
+				auto [e1, n1] = co_await asio::async_read_some_adaptive(sock, buf, asio::use_nothrow_awaitable);
+				if (e1)
+					co_return e1;
+
+				if (on_recv_)
+					on_recv_(buf.data());
+			}
+		}
+
+		template<typename AsyncStream>
+		asio::awaitable<asio::error_code> write_loop(AsyncStream& sock)
+		{
+			std::vector<std::string> batch;
+			std::vector<asio::const_buffer> buffers;
+
+			batch.reserve(option_.max_write_batch);
+			buffers.reserve(option_.max_write_batch);
+
+			for (;;)
+			{
+				batch.clear();
+				buffers.clear();
+
+				while (batch.size() < option_.max_write_batch)
+				{
+					std::optional<std::string> data = queue_.pop();
+					if (!data.has_value())
+						break;
+
+					if (data->empty())
+						continue;
+
+					batch.emplace_back(std::move(*data));
+					buffers.emplace_back(asio::buffer(batch.back()));
+				}
+
+				if (batch.empty())
+				{
+					writer_sleeping_.store(true, std::memory_order_seq_cst);
+
+					// a message maybe pushed before the flag is set, check again. the fence keeps the
+					// store above from being reordered after the load of the queue.
+					std::atomic_thread_fence(std::memory_order_seq_cst);
+
+					if (!queue_.empty())
+					{
+						writer_sleeping_.store(false, std::memory_order_release);
+						continue;
+					}
+
+					notifier_.expires_at((std::chrono::steady_clock::time_point::max)());
+
+					co_await notifier_.async_wait(asio::use_nothrow_awaitable);
+
+					continue;
+				}
+
+				auto [e1, n1] = co_await asio::async_write(sock, buffers, asio::use_nothrow_awaitable);
+				if (e1)
+					co_return e1;
+			}
+		}
+
+	protected:
+		strand_type                              strand_;
+
+		tcp_client_option                        option_;
+
+		asio::steady_timer                       notifier_;
+
+		std::optional<asio::cancellation_signal> stop_signal_{};
+
+		asio::mpsc_queue<std::string>            queue_;
+
+		std::atomic<bool>                        writer_sleeping_{ false };
+
+		std::atomic<bool>                        started_{ false };
+		std::atomic<bool>                        stopped_{ false };
+		std::atomic<bool>                        connected_{ false };
+
+		std::mt19937                             rng_;
+	};
+}
+
+namespace asio
+{
+	/**
+	 * @brief A tcp client which connects to the server of the option, and reconnects automatically.
+	 * The messages are queued by the lock-free send function which can be called by any thread,
+	 * and written by a single writer coroutine with gathering writes.
+	 * If the executor of the option is not set, the client uses its own io_context, and the run
+	 * function must be called to run it.
+	 * @eg:
+	 * asio::tcp_client client({ .server_address = "127.0.0.1", .server_port = 8080, .executor = ctx.get_executor() });
+	 * client.bind_recv([](std::string_view data) {});
+	 * client.start();
+	 * client.send("hello");
+	 */
+	class tcp_client
+	{
+	public:
+		explicit tcp_client(tcp_client_option opt)
+		{
+			if (!opt.executor.has_value())
+			{
+				ioc_ = std::make_unique<asio::io_context>(1);
+				opt.executor = ioc_->get_executor();
+			}
+
+			asio::any_io_executor ex = opt.executor.value();
+
+			impl_ = std::make_shared<detail::tcp_client_impl>(ex, std::move(opt));
+		}
+
+		~tcp_client()
+		{
+			stop();
+
+			impl_.reset();
+		}
+
+		tcp_client(const tcp_client&) = delete;
+		tcp_client& operator=(const tcp_client&) = delete;
+
+		/**
+		 * @brief Set the connect callback, it is called after each connection attempt.
+		 * It must be called before start. The callback is invoked in the strand of the client.
+		 * @param fn - void(const asio::error_code& ec)
+		 */
+		template<typename Fun>
+		inline tcp_client& bind_connect(Fun&& fn)
+		{
+			impl_->on_connect_ = std::forward<Fun>(fn);
+			return *this;
+		}
+
+		/**
+		 * @brief Set the disconnect callback, it is called when an established connection is lost.
+		 * It must be called before start. The callback is invoked in the strand of the client.
+		 * @param fn - void(const asio::error_code& ec)
+		 */
+		template<typename Fun>
+		inline tcp_client& bind_disconnect(Fun&& fn)
+		{
+			impl_->on_disconnect_ = std::forward<Fun>(fn);
+			return *this;
+		}
+
+		/**
+		 * @brief Set the recv callback, it is called when data is received.
+		 * It must be called before start. The callback is invoked in the strand of the client.
+		 * @param fn - void(std::string_view data)
+		 */
+		template<typename Fun>
+		inline tcp_client& bind_recv(Fun&& fn)
+		{
+			impl_->on_recv_ = std::forward<Fun>(fn);
+			return *this;
+		}
+
+		/**
+		 * @brief Start connecting to the server, return false if it is started already.
+		 */
+		inline bool start()
+		{
+			return impl_->start();
+		}
+
+		/**
+		 * @brief Stop the client, the connection is closed and the reconnection is stopped.
+		 */
+		inline void stop()
+		{
+			if (impl_)
+				impl_->stop();
+		}
+
+		/**
+		 * @brief Run the own io_context of the client until it is stopped. Do nothing if the
+		 * executor of the option is set.
+		 */
+		inline void run()
+		{
+			if (ioc_)
+				ioc_->run();
+		}
+
+		/**
+		 * @brief Queue the data to send, it is thread safety and lock-free.
+		 * The queued data is sent after the connection is established (or reestablished).
+		 * @return false if the client is stopped.
+		 */
+		template<typename DataT>
+		inline bool send(DataT&& data)
+		{
+			return impl_->send(asio::to_string(std::forward<DataT>(data)));
+		}
+
+		inline bool is_started() const noexcept
+		{
+			return impl_->is_started();
+		}
+
+		inline bool is_connected() const noexcept
+		{
+			return impl_->is_connected();
+		}
+
+		inline asio::strand<asio::any_io_executor> get_executor() noexcept
+		{
+			return impl_->strand();
+		}
+
+	protected:
+		std::unique_ptr<asio::io_context>        ioc_;
+
+		std::shared_ptr<detail::tcp_client_impl> impl_;
 	};
 }
@@ -10,6 +10,9 @@
 
 #pragma once
 
+#include <deque>
+#include <vector>
+
 #include <asio3/core/asio.hpp>
 #include <asio3/tcp/core.hpp>
 
@@ -57,3 +60,215 @@ auto async_write(AsyncWriteStream& s, basic_streambuf<Allocator>& b, detail::tra
 		::asio::default_completion_token<typename AsyncWriteStream::executor_type>::type());
 }
 }
+
+namespace asio
+{
+	/**
+	 * @brief A coalescing write queue of a stream. While a write is in flight, the newly queued
+	 * buffers are accumulated, and the next write sends all of them with one gathering write.
+	 * The queue must be used in the executor (strand) of the stream, and it must outlive all
+	 * the queued writes.
+	 * @eg:
+	 * asio::write_queue<asio::tcp_socket> queue(sock);
+	 * auto [ec, n] = co_await asio::async_write_queued(queue, asio::buffer(msg));
+	 */
+	template<typename AsyncWriteStream>
+	class write_queue
+	{
+	public:
+		using stream_type   = AsyncWriteStream;
+		using executor_type = typename AsyncWriteStream::executor_type;
+		using handler_type  = asio::any_completion_handler<void(asio::error_code, std::size_t)>;
+
+		/// the maximum number of buffers which asio writes by one writev call.
+		static constexpr std::size_t default_max_buffers =
+			std::size_t(asio::detail::buffer_sequence_adapter_base::max_buffers);
+
+		/// the maximum bytes of one gathering write.
+		static constexpr std::size_t default_max_bytes = 1024 * 1024;
+
+		/**
+		 * @param s - The stream, it must outlive the queue.
+		 * @param max_buffers - The maximum number of buffers of one gathering write.
+		 * @param max_bytes - The maximum bytes of one gathering write, a single larger message
+		 *                    is still written as a whole.
+		 */
+		explicit write_queue(AsyncWriteStream& s,
+			std::size_t max_buffers = default_max_buffers, std::size_t max_bytes = default_max_bytes)
+			: stream_(s), max_buffers_(max_buffers == 0 ? 1 : max_buffers), max_bytes_(max_bytes)
+		{
+		}
+
+		write_queue(const write_queue&) = delete;
+		write_queue& operator=(const write_queue&) = delete;
+
+		inline AsyncWriteStream& stream() noexcept { return stream_; }
+
+		inline executor_type get_executor() noexcept { return stream_.get_executor(); }
+
+		/**
+		 * @brief The number of queued writes which are not completed, include the in flight ones.
+		 */
+		inline std::size_t size() const noexcept { return pending_.size() + writing_.size(); }
+
+		/**
+		 * @brief Queue the buffers, start a gathering write if no write is in flight.
+		 */
+		template<typename ConstBufferSequence>
+		void enqueue(const ConstBufferSequence& buffers, handler_type handler)
+		{
+			entry e{ {}, 0, std::move(handler) };
+
+			for (auto it = asio::buffer_sequence_begin(buffers); it != asio::buffer_sequence_end(buffers); ++it)
+			{
+				asio::const_buffer b(*it);
+				if (b.size() == 0)
+					continue;
+				e.bytes += b.size();
+				e.buffers.emplace_back(b);
+			}
+
+			pending_.emplace_back(std::move(e));
+
+			if (writing_.empty())
+				write_next();
+		}
+
+	protected:
+		struct entry
+		{
+			std::vector<asio::const_buffer> buffers;
+			std::size_t                     bytes;
+			handler_type                    handler;
+		};
+
+		void write_next()
+		{
+			buffers_.clear();
+
+			std::size_t bytes = 0;
+
+			// at least one entry is written, even if it exceeds the budget.
+			while (!pending_.empty())
+			{
+				entry& e = pending_.front();
+
+				if (!writing_.empty() && (buffers_.size() + e.buffers.size() > max_buffers_ || bytes + e.bytes > max_bytes_))
+					break;
+
+				bytes += e.bytes;
+				buffers_.insert(buffers_.end(), e.buffers.begin(), e.buffers.end());
+
+				writing_.emplace_back(std::move(e));
+				pending_.pop_front();
+			}
+
+			if (writing_.empty())
+				return;
+
+			write_some();
+		}
+
+		// asio::async_write gathers at most 16 buffers per call, so drive the write_some
+		// directly to let one writev carry the whole batch.
+		void write_some()
+		{
+			stream_.async_write_some(buffers_,
+			[this](const asio::error_code& ec, std::size_t n) mutable
+			{
+				if (!ec)
+				{
+					auto it = buffers_.begin();
+					for (; it != buffers_.end() && n >= it->size(); ++it)
+						n -= it->size();
+					if (it != buffers_.end())
+						*it += n;
+					buffers_.erase(buffers_.begin(), it);
+
+					if (!buffers_.empty())
+					{
+						write_some();
+						return;
+					}
+				}
+
+				std::vector<entry> done;
+				done.swap(writing_);
+
+				// the stream is broken, fail all the queued writes too.
+				if (ec)
+				{
+					for (entry& e : pending_)
+						done.emplace_back(std::move(e));
+					pending_.clear();
+				}
+				else
+				{
+					write_next();
+				}
+
+				for (entry& e : done)
+				{
+					asio::dispatch(asio::append(std::move(e.handler), ec, ec ? std::size_t(0) : e.bytes));
+				}
+			});
+		}
+
+	protected:
+		AsyncWriteStream&               stream_;
+
+		std::size_t                     max_buffers_;
+		std::size_t                     max_bytes_;
+
+		std::deque<entry>               pending_;
+		std::vector<entry>              writing_;
+
+		std::vector<asio::const_buffer> buffers_;
+	};
+}
+
+namespace asio::detail
+{
+	struct async_write_queued_initiation
+	{
+		template<typename Handler, typename AsyncWriteStream, typename ConstBufferSequence>
+		inline void operator()(Handler&& handler,
+			std::reference_wrapper<write_queue<AsyncWriteStream>> queue_ref, ConstBufferSequence buffers) const
+		{
+			auto& queue = queue_ref.get();
+
+			asio::dispatch(queue.get_executor(),
+			[&queue, buffers = std::move(buffers),
+				handler = typename write_queue<AsyncWriteStream>::handler_type(std::forward<Handler>(handler))]
+			() mutable
+			{
+				queue.enqueue(buffers, std::move(handler));
+			});
+		}
+	};
+}
+
+namespace asio
+{
+	/**
+	 * @brief Queue a write to the write queue, the queued writes are coalesced into gathering writes.
+	 * The buffers must remain valid until the completion handler is called.
+	 * @param queue - The write queue of the stream.
+	 * @param buffers - One or more buffers to be written.
+	 * @param token - The completion handler to invoke when the operation completes.
+	 *	  The equivalent function signature of the handler must be:
+     *    @code
+     *    void handler(const asio::error_code& ec, std::size_t bytes_transferred);
+	 */
+	template<typename AsyncWriteStream, typename ConstBufferSequence,
+		ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, std::size_t)) WriteToken
+		ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(typename AsyncWriteStream::executor_type)>
+	ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(WriteToken, void(asio::error_code, std::size_t))
+	async_write_queued(
+		write_queue<AsyncWriteStream>& queue, const ConstBufferSequence& buffers,
+		WriteToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(typename AsyncWriteStream::executor_type))
+	{
+		return asio::async_initiate<WriteToken, void(asio::error_code, std::size_t)>(
+			detail::async_write_queued_initiation{}, token, std::ref(queue), buffers);
+	}
+}
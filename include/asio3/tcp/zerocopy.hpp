@@ -0,0 +1,283 @@
+/*
+ * Copyright (c) 2017-2023 zhllxt
+ *
+ * author   : zhllxt
+ * email    : 37792738@qq.com
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include <asio3/core/asio.hpp>
+#include <asio3/core/frame_allocator.hpp>
+#include <asio3/core/detail/type_traits.hpp>
+#include <asio3/tcp/core.hpp>
+
+#if defined(__linux__) && __has_include(<linux/errqueue.h>)
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#endif
+
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+#define ASIO3_HAS_MSG_ZEROCOPY 1
+#endif
+
+namespace asio
+{
+	/// writes smaller than this are sent by the normal copying send, the page pinning and the
+	/// completion notification of zerocopy cost more than the copy.
+	constexpr std::size_t zerocopy_min_bytes = 10 * 1024;
+}
+
+namespace asio::detail
+{
+#if defined(ASIO3_HAS_MSG_ZEROCOPY)
+	/**
+	 * @brief Read all the zerocopy completion notifications from the socket error queue.
+	 * @return the number of the completed zerocopy sends.
+	 */
+	inline std::size_t drain_zerocopy_notifications(int fd) noexcept
+	{
+		std::size_t completed = 0;
+
+		for (;;)
+		{
+			alignas(::cmsghdr) char control[CMSG_SPACE(sizeof(::sock_extended_err)) + 64];
+
+			::msghdr msg{};
+			msg.msg_control = control;
+			msg.msg_controllen = sizeof(control);
+
+			if (::recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				break;
+			}
+
+			for (::cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm))
+			{
+				if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+					(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)))
+					continue;
+
+				const ::sock_extended_err* serr = reinterpret_cast<const ::sock_extended_err*>(CMSG_DATA(cm));
+
+				// ee_info to ee_data is the inclusive range of the completed send sequence numbers.
+				if (serr->ee_origin == SO_EE_ORIGIN_ZEROCOPY && serr->ee_errno == 0)
+					completed += std::size_t(serr->ee_data - serr->ee_info) + 1;
+			}
+		}
+
+		return completed;
+	}
+
+	/**
+	 * @brief Enable SO_ZEROCOPY of the socket. It is set on every zerocopy write instead of being
+	 * cached, the option is idempotent and the syscall is cheap next to a write of at least
+	 * zerocopy_min_bytes, while a cache can't tell a socket which is reopened or moved.
+	 */
+	template<typename Socket>
+	inline bool enable_zerocopy(Socket& sock, asio::error_code& ec)
+	{
+		ec.clear();
+
+		int enable = 1;
+		if (::setsockopt(sock.native_handle(), SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(enable)) != 0)
+		{
+			ec = asio::error_code(errno, asio::error::get_system_category());
+			return false;
+		}
+
+		if (!sock.native_non_blocking())
+		{
+			sock.native_non_blocking(true, ec);
+			if (ec)
+				return false;
+		}
+
+		return true;
+	}
+#endif
+
+	struct async_write_zerocopy_op
+	{
+		template<typename AsyncWriteStream, typename ConstBufferSequence>
+		auto operator()(
+			auto state, std::reference_wrapper<AsyncWriteStream> sock_ref, ConstBufferSequence buffers) -> void
+		{
+			state.reset_cancellation_state(asio::enable_terminal_cancellation());
+
+			auto& sock = sock_ref.get();
+
+			std::size_t total = asio::buffer_size(buffers);
+
+		#if defined(ASIO3_HAS_MSG_ZEROCOPY)
+			asio::error_code ec{};
+
+			if (total >= zerocopy_min_bytes && sock.is_open())
+				enable_zerocopy(sock, ec);
+
+			if (total >= zerocopy_min_bytes && sock.is_open() && !ec)
+			{
+				// a cancellation must not complete the operation while the kernel still holds the
+				// pages of the buffers, the sending stops, but the notifications are still waited.
+				state.complete_if_cancelled(false);
+
+				std::vector<asio::const_buffer> bufs;
+				for (auto it = asio::buffer_sequence_begin(buffers); it != asio::buffer_sequence_end(buffers); ++it)
+				{
+					if (asio::const_buffer b(*it); b.size() > 0)
+						bufs.emplace_back(b);
+				}
+
+				std::size_t sent = 0, issued = 0, completed = 0;
+
+				asio::steady_timer timer(sock.get_executor());
+
+				while (!bufs.empty())
+				{
+					if (!!state.cancelled())
+					{
+						ec = asio::error::operation_aborted;
+						break;
+					}
+
+					std::size_t remain = total - sent;
+
+					::iovec iov[asio::detail::buffer_sequence_adapter_base::max_buffers];
+
+					std::size_t count = 0;
+					for (; count < bufs.size() && count < std::size(iov); ++count)
+					{
+						iov[count].iov_base = const_cast<void*>(bufs[count].data());
+						iov[count].iov_len = bufs[count].size();
+					}
+
+					::msghdr msg{};
+					msg.msg_iov = iov;
+					msg.msg_iovlen = count;
+
+					// the tail which is smaller than the threshold is sent by copying.
+					int flags = MSG_NOSIGNAL | (remain >= zerocopy_min_bytes ? MSG_ZEROCOPY : 0);
+
+					::ssize_t n = ::sendmsg(sock.native_handle(), &msg, flags);
+
+					if (n < 0)
+					{
+						if (errno == EINTR)
+							continue;
+
+						ec = asio::error_code(errno, asio::error::get_system_category());
+
+						if (ec == asio::error::would_block || ec == asio::error::try_again)
+						{
+							auto [e1] = co_await sock.async_wait(asio::socket_base::wait_write, use_nothrow_deferred);
+							ec = e1;
+							if (!ec)
+								continue;
+						}
+						// the optmem limit is reached, wait for the kernel to release some pages.
+						else if (ec == asio::error::no_buffer_space && issued > completed)
+						{
+							completed += drain_zerocopy_notifications(sock.native_handle());
+
+							timer.expires_after(std::chrono::milliseconds(1));
+
+							auto [e2] = co_await timer.async_wait(use_nothrow_deferred);
+							ec = e2;
+							if (!ec)
+								continue;
+						}
+
+						break;
+					}
+
+					if ((flags & MSG_ZEROCOPY) && n > 0)
+						++issued;
+
+					sent += std::size_t(n);
+
+					std::size_t m = std::size_t(n);
+					auto it = bufs.begin();
+					for (; it != bufs.end() && m >= it->size(); ++it)
+						m -= it->size();
+					if (it != bufs.end())
+						*it += m;
+					bufs.erase(bufs.begin(), it);
+
+					completed += drain_zerocopy_notifications(sock.native_handle());
+				}
+
+				// the caller's buffers can't be released until the kernel has finished with the pages,
+				// it is waited even if the operation is cancelled.
+				while (completed < issued && sock.is_open())
+				{
+					completed += drain_zerocopy_notifications(sock.native_handle());
+					if (completed >= issued)
+						break;
+
+					// the error queue readiness is edge triggered, so poll it with a short timer too.
+					timer.expires_after(std::chrono::milliseconds(5));
+
+					auto [order, e3, e4] = co_await asio::experimental::make_parallel_group(
+						sock.async_wait(asio::socket_base::wait_error, asio::deferred),
+						timer.async_wait(asio::deferred)
+					).async_wait(asio::experimental::wait_for_one(), use_nothrow_deferred);
+
+					detail::ignore_unused(order, e3, e4);
+				}
+
+				if (!!state.cancelled())
+					ec = asio::error::operation_aborted;
+
+				co_return{ ec, sent };
+			}
+		#endif
+
+			auto [e5, n5] = co_await asio::async_write(sock, buffers, asio::transfer_all(), use_nothrow_deferred);
+
+			co_return{ e5, n5 };
+		}
+	};
+}
+
+namespace asio
+{
+	/**
+	 * @brief Write all of the supplied data to a tcp socket, the large writes are sent with
+	 * MSG_ZEROCOPY on linux, so the kernel reads the pages of the buffers directly instead of
+	 * copying them. The operation completes after the kernel has released the pages, so the
+	 * buffers can be reused or released in the completion handler, even if the operation is
+	 * cancelled, the operation_aborted is reported after the pages are released. The writes which
+	 * are smaller than asio::zerocopy_min_bytes, or on the platforms without MSG_ZEROCOPY, are
+	 * sent normally.
+	 * @param s - The tcp socket.
+	 * @param buffers - One or more buffers to be written.
+	 * @param token - The completion handler to invoke when the operation completes.
+	 *	  The equivalent function signature of the handler must be:
+     *    @code
+     *    void handler(const asio::error_code& ec, std::size_t bytes_transferred);
+	 */
+	template<typename AsyncWriteStream, typename ConstBufferSequence,
+		ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, std::size_t)) WriteToken
+		ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(typename AsyncWriteStream::executor_type)>
+	requires is_const_buffer_sequence<ConstBufferSequence>::value
+	ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(WriteToken, void(asio::error_code, std::size_t))
+	async_write_zerocopy(
+		AsyncWriteStream& s, const ConstBufferSequence& buffers,
+		WriteToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(typename AsyncWriteStream::executor_type))
+	{
+		return asio::async_initiate<WriteToken, void(asio::error_code, std::size_t)>(
+			asio::detail::recycled_co_composed<void(asio::error_code, std::size_t)>(
+				detail::async_write_zerocopy_op{}, s),
+			token, std::ref(s), buffers);
+	}
+}
@@ -12,8 +12,31 @@
 
 #include <asio3/core/asio.hpp>
 
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <netinet/udp.h>
+#endif
+
+#if defined(__linux__) && defined(MSG_WAITFORONE)
+#define ASIO3_HAS_MMSG 1
+#endif
+
+#if defined(__linux__) && defined(SOL_UDP) && defined(UDP_SEGMENT)
+#define ASIO3_HAS_UDP_GSO 1
+#endif
+
+#if defined(__linux__) && defined(SOL_UDP) && defined(UDP_GRO)
+#define ASIO3_HAS_UDP_GRO 1
+#endif
+
 namespace asio
 {
 	using udp_resolver = as_tuple_t<deferred_t>::as_default_on_t<ip::udp::resolver>;
 	using udp_socket   = as_tuple_t<deferred_t>::as_default_on_t<ip::udp::socket>;
+
+	/// the maximum datagrams of one recvmmsg or sendmmsg call.
+	constexpr std::size_t udp_max_batch = 64;
+
+	/// the maximum payload bytes of one segmentation offload send, below the 64KiB limit of an ip packet.
+	constexpr std::size_t udp_max_offload_size = 65000;
 }
@@ -0,0 +1,330 @@
+/*
+ * Copyright (c) 2017-2023 zhllxt
+ *
+ * author   : zhllxt
+ * email    : 37792738@qq.com
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+#include <asio3/core/asio.hpp>
+#include <asio3/core/detail/thread_cache.hpp>
+
+namespace asio::detail
+{
+	/**
+	 * The header of a datagram block, the bytes follow it. The blocks are allocated one by one,
+	 * so a block can be released in any thread, and it is cached by the releasing thread.
+	 */
+	struct alignas(16) datagram_block
+	{
+		std::atomic<std::uint32_t> refs;
+		std::uint32_t              size_class;
+		datagram_block*            next;
+
+		inline char* bytes() noexcept
+		{
+			return reinterpret_cast<char*>(this) + sizeof(datagram_block);
+		}
+	};
+}
+
+namespace asio
+{
+	class datagram_pool;
+
+	/**
+	 * @brief A reference counted handle of a pooled datagram block, the block is returned to the
+	 * pool when the last handle is destroyed. The copies share the bytes, but each copy has its
+	 * own view, so a copy can consume a header without affecting the others.
+	 * The view starts after a headroom, so a protocol header can be prepended in place. The
+	 * prepend writes the shared bytes, so it is only allowed when the handle is the only one of
+	 * the block, i.e. use_count() == 1.
+	 */
+	class datagram_buffer
+	{
+	public:
+		datagram_buffer() noexcept = default;
+
+		~datagram_buffer()
+		{
+			reset();
+		}
+
+		datagram_buffer(const datagram_buffer& other) noexcept
+			: block_(other.block_), offset_(other.offset_), size_(other.size_), limit_(other.limit_)
+		{
+			if (block_)
+				block_->refs.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		datagram_buffer& operator=(const datagram_buffer& other) noexcept
+		{
+			if (this != std::addressof(other))
+			{
+				datagram_buffer tmp(other);
+				*this = std::move(tmp);
+			}
+			return *this;
+		}
+
+		datagram_buffer(datagram_buffer&& other) noexcept
+			: block_ (std::exchange(other.block_, nullptr))
+			, offset_(std::exchange(other.offset_, 0))
+			, size_  (std::exchange(other.size_, 0))
+			, limit_ (std::exchange(other.limit_, 0))
+		{
+		}
+
+		datagram_buffer& operator=(datagram_buffer&& other) noexcept
+		{
+			if (this != std::addressof(other))
+			{
+				reset();
+
+				block_  = std::exchange(other.block_, nullptr);
+				offset_ = std::exchange(other.offset_, 0);
+				size_   = std::exchange(other.size_, 0);
+				limit_  = std::exchange(other.limit_, 0);
+			}
+			return *this;
+		}
+
+		inline char* data() noexcept { return block_ ? block_->bytes() + offset_ : nullptr; }
+		inline const char* data() const noexcept { return block_ ? block_->bytes() + offset_ : nullptr; }
+
+		/// The bytes of the view.
+		inline std::size_t size() const noexcept { return size_; }
+
+		inline bool empty() const noexcept { return size_ == 0; }
+
+		inline explicit operator bool() const noexcept { return block_ != nullptr; }
+
+		/// The bytes which can be prepended before the view.
+		inline std::size_t headroom() const noexcept { return offset_; }
+
+		/// The maximum size of the view from the current start.
+		inline std::size_t capacity() const noexcept { return limit_ - offset_; }
+
+		/// The count of the handles which share the block.
+		inline std::uint32_t use_count() const noexcept
+		{
+			return block_ ? block_->refs.load(std::memory_order_relaxed) : 0;
+		}
+
+		/**
+		 * @brief Reset the view to the whole payload area after the headroom and return it,
+		 * receive a datagram into it, then commit the received bytes.
+		 * @eg:
+		 * auto [ec, n] = co_await sock.async_receive_from(d.prepare(), sender);
+		 * d.commit(n);
+		 */
+		inline asio::mutable_buffer prepare() noexcept;
+
+		/**
+		 * @brief Set the size of the view, it is clamped to the capacity.
+		 */
+		inline void commit(std::size_t n) noexcept
+		{
+			size_ = (std::min)(n, capacity());
+		}
+
+		/**
+		 * @brief Remove n bytes from the front of the view, e.g. a header which is parsed already.
+		 */
+		inline void consume(std::size_t n) noexcept
+		{
+			n = (std::min)(n, size_);
+			offset_ += n;
+			size_ -= n;
+		}
+
+		/**
+		 * @brief Grow the view backward by n bytes and return the start of it, the caller writes
+		 * the header there. The header is written into the bytes of the block, which the other
+		 * copies would see, so the handle must not be shared.
+		 * @throws std::length_error if n is larger than the headroom.
+		 * @throws std::logic_error if the block is shared by other handles, i.e. use_count() > 1.
+		 */
+		inline char* prepend(std::size_t n)
+		{
+			if (n > offset_)
+				asio::detail::throw_exception(std::length_error{ "datagram_buffer headroom overflow" });
+
+			if (use_count() > 1)
+				asio::detail::throw_exception(std::logic_error{ "datagram_buffer prepend on a shared block" });
+
+			offset_ -= n;
+			size_ += n;
+
+			return data();
+		}
+
+		/**
+		 * @brief Release the block, the handle becomes empty.
+		 */
+		inline void reset() noexcept;
+
+	protected:
+		friend class datagram_pool;
+
+		datagram_buffer(detail::datagram_block* block, std::size_t offset, std::size_t limit) noexcept
+			: block_(block), offset_(offset), size_(limit - offset), limit_(limit)
+		{
+		}
+
+	protected:
+		detail::datagram_block* block_  = nullptr;
+		std::size_t             offset_ = 0;
+		std::size_t             size_   = 0;
+		std::size_t             limit_  = 0;
+	};
+
+	/**
+	 * @brief A per thread pool of the datagram blocks of two fixed sizes, the mtu size and the
+	 * jumbo size, so the receive and the forward of the datagrams don't allocate in the steady
+	 * state. The blocks are cached by the thread which releases them, up to a limit per size.
+	 * @eg:
+	 * asio::datagram_buffer d = asio::datagram_pool::acquire();
+	 * auto [ec, n] = co_await sock.async_receive_from(d.prepare(), sender);
+	 * d.commit(n);
+	 */
+	class datagram_pool
+	{
+	public:
+		/// The bytes before the payload, a protocol header up to this size can be prepended in place.
+		static constexpr std::size_t headroom   = 128;
+
+		/// The payload capacity of the mtu blocks, an ethernet frame with the vlan tags fits.
+		static constexpr std::size_t mtu_size   = 2048;
+
+		/// The payload capacity of the jumbo blocks, the largest udp datagram fits.
+		static constexpr std::size_t jumbo_size = 65536;
+
+		/// The maximum count of the cached free blocks of each size per thread.
+		static constexpr std::array<std::size_t, 2> max_cached_blocks{ 1024, 32 };
+
+		/**
+		 * @brief Borrow a block whose payload capacity is at least size, at most jumbo_size.
+		 * The view of the returned buffer is the whole payload area.
+		 */
+		static inline datagram_buffer acquire(std::size_t size = mtu_size)
+		{
+			std::uint32_t index = size <= mtu_size ? 0 : 1;
+
+			detail::datagram_block* block = nullptr;
+
+			if (cache_type* cache = cache_type::current())
+				block = cache->pop(index);
+
+			if (!block)
+			{
+				block = ::new (::operator new(sizeof(detail::datagram_block) + headroom + payload_size(index)))
+					detail::datagram_block{};
+				block->size_class = index;
+			}
+
+			block->refs.store(1, std::memory_order_relaxed);
+			block->next = nullptr;
+
+			return datagram_buffer(block, headroom, headroom + payload_size(index));
+		}
+
+		/**
+		 * @brief Free the cached blocks of the current thread.
+		 */
+		static inline void shrink() noexcept
+		{
+			if (cache_type* cache = cache_type::current())
+				cache->clear();
+		}
+
+		/**
+		 * @brief The bytes of the cached free blocks of the current thread.
+		 */
+		static inline std::size_t cached_bytes() noexcept
+		{
+			cache_type* cache = cache_type::current();
+			if (!cache)
+				return 0;
+
+			return
+				cache->count(0) * (sizeof(detail::datagram_block) + headroom + payload_size(0)) +
+				cache->count(1) * (sizeof(detail::datagram_block) + headroom + payload_size(1));
+		}
+
+		static inline std::size_t payload_size(std::uint32_t size_class) noexcept
+		{
+			return size_class == 0 ? mtu_size : jumbo_size;
+		}
+
+	protected:
+		friend class datagram_buffer;
+
+		struct block_disposer
+		{
+			inline void operator()(detail::datagram_block* p) const noexcept
+			{
+				p->~datagram_block();
+				::operator delete(p);
+			}
+		};
+
+		using cache_type = detail::thread_cache<detail::datagram_block, 2, block_disposer>;
+
+		static inline void release(detail::datagram_block* block) noexcept
+		{
+			std::uint32_t index = block->size_class;
+
+			if (cache_type* cache = cache_type::current(); cache && cache->push(index, block, max_cached_blocks[index]))
+				return;
+
+			block_disposer{}(block);
+		}
+	};
+
+	inline asio::mutable_buffer datagram_buffer::prepare() noexcept
+	{
+		if (!block_)
+			return asio::mutable_buffer{};
+
+		offset_ = datagram_pool::headroom;
+		size_ = limit_ - offset_;
+
+		return asio::mutable_buffer(data(), size_);
+	}
+
+	inline void datagram_buffer::reset() noexcept
+	{
+		if (block_ && block_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			datagram_pool::release(block_);
+
+		block_  = nullptr;
+		offset_ = 0;
+		size_   = 0;
+		limit_  = 0;
+	}
+
+	inline asio::mutable_buffer buffer(datagram_buffer& d) noexcept
+	{
+		return asio::mutable_buffer(d.data(), d.size());
+	}
+
+	inline asio::const_buffer buffer(const datagram_buffer& d) noexcept
+	{
+		return asio::const_buffer(d.data(), d.size());
+	}
+}
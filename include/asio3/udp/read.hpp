@@ -10,8 +10,271 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <span>
+#include <utility>
+
 #include <asio3/core/asio.hpp>
+#include <asio3/core/frame_allocator.hpp>
+#include <asio3/core/detail/type_traits.hpp>
 #include <asio3/udp/core.hpp>
+#include <asio3/udp/datagram_pool.hpp>
+
+namespace asio::detail
+{
+#if defined(ASIO3_HAS_MMSG)
+	/**
+	 * @brief recvmmsg once without blocking, the buffers of the received datagrams are shrunk
+	 * to the datagram sizes, and the endpoints are set to the senders.
+	 * @return the count of the received datagrams, 0 means failed and the ec is set.
+	 */
+	template<typename Endpoint>
+	inline std::size_t receive_mmsg(int fd,
+		std::span<asio::mutable_buffer> buffers, std::span<Endpoint> endpoints, asio::error_code& ec)
+	{
+		std::size_t count = (std::min)(buffers.size(), udp_max_batch);
+		if (!endpoints.empty())
+			count = (std::min)(count, endpoints.size());
+
+		::mmsghdr msgs[udp_max_batch];
+		::iovec   iovs[udp_max_batch];
+
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			iovs[i].iov_base = buffers[i].data();
+			iovs[i].iov_len = buffers[i].size();
+
+			msgs[i] = {};
+			msgs[i].msg_hdr.msg_iov = std::addressof(iovs[i]);
+			msgs[i].msg_hdr.msg_iovlen = 1;
+
+			if (!endpoints.empty())
+			{
+				msgs[i].msg_hdr.msg_name = endpoints[i].data();
+				msgs[i].msg_hdr.msg_namelen = ::socklen_t(endpoints[i].capacity());
+			}
+		}
+
+		for (;;)
+		{
+			int n = ::recvmmsg(fd, msgs, static_cast<unsigned int>(count), MSG_DONTWAIT, nullptr);
+			if (n >= 0)
+			{
+				for (int i = 0; i < n; ++i)
+				{
+					buffers[i] = asio::mutable_buffer(buffers[i].data(), msgs[i].msg_len);
+
+					if (!endpoints.empty())
+						endpoints[i].resize(msgs[i].msg_hdr.msg_namelen);
+				}
+
+				ec = {};
+				return std::size_t(n);
+			}
+
+			if (errno == EINTR)
+				continue;
+
+			ec = asio::error_code(errno, asio::error::get_system_category());
+			return 0;
+		}
+	}
+#endif
+
+	struct async_receive_batch_op
+	{
+		template<typename AsyncReadStream, typename Endpoint>
+		auto operator()(
+			auto state, std::reference_wrapper<AsyncReadStream> sock_ref,
+			std::span<asio::mutable_buffer> buffers, std::span<Endpoint> endpoints) -> void
+		{
+			state.reset_cancellation_state(asio::enable_terminal_cancellation());
+
+			auto& sock = sock_ref.get();
+
+			if (buffers.empty())
+			{
+				co_await asio::detail::async_yield(state);
+				co_return{ asio::error_code{}, 0 };
+			}
+
+		#if defined(ASIO3_HAS_MMSG)
+			// the handler is never invoked inside the initiating function, even if the datagrams
+			// are received without waiting, otherwise a receive loop would recurse without bound.
+			bool suspended = false;
+
+			for (;;)
+			{
+				asio::error_code ec{};
+
+				// try to receive first, the socket is usually readable when the previous batch was full.
+				std::size_t n = receive_mmsg(sock.native_handle(), buffers, endpoints, ec);
+
+				if (!ec || (ec != asio::error::would_block && ec != asio::error::try_again))
+				{
+					if (!suspended)
+						co_await asio::detail::async_yield(state);
+
+					co_return{ ec, ec ? 0 : n };
+				}
+
+				auto [e1] = co_await sock.async_wait(asio::socket_base::wait_read, use_nothrow_deferred);
+
+				suspended = true;
+
+				if (e1)
+					co_return{ e1, 0 };
+			}
+		#else
+			std::size_t n1 = 0;
+
+			if (endpoints.empty())
+			{
+				auto [e1, n] = co_await sock.async_receive(buffers[0], use_nothrow_deferred);
+				if (e1)
+					co_return{ e1, 0 };
+				n1 = n;
+			}
+			else
+			{
+				auto [e1, n] = co_await sock.async_receive_from(buffers[0], endpoints[0], use_nothrow_deferred);
+				if (e1)
+					co_return{ e1, 0 };
+				n1 = n;
+			}
+
+			buffers[0] = asio::mutable_buffer(buffers[0].data(), n1);
+
+			std::size_t count = (std::min)(buffers.size(), udp_max_batch);
+			if (!endpoints.empty())
+				count = (std::min)(count, endpoints.size());
+
+			// take the datagrams which are already queued without blocking.
+			std::size_t received = 1;
+
+			for (asio::error_code ec{}; received < count; ++received)
+			{
+				if (sock.available(ec) == 0 || ec)
+					break;
+
+				std::size_t n = endpoints.empty() ?
+					sock.receive(buffers[received], 0, ec) :
+					sock.receive_from(buffers[received], endpoints[received], 0, ec);
+				if (ec)
+					break;
+
+				buffers[received] = asio::mutable_buffer(buffers[received].data(), n);
+			}
+
+			co_return{ asio::error_code{}, received };
+		#endif
+		}
+	};
+
+#if defined(ASIO3_HAS_UDP_GRO)
+	/**
+	 * @brief recvmsg once without blocking, and get the segment size of the coalesced datagrams
+	 * from the UDP_GRO control message.
+	 * @return the bytes received and the segment size, the ec is set when failed.
+	 */
+	template<typename Endpoint>
+	inline std::pair<std::size_t, std::size_t> receive_gro(int fd,
+		asio::mutable_buffer buffer, Endpoint& sender, asio::error_code& ec)
+	{
+		::iovec iov{};
+		iov.iov_base = buffer.data();
+		iov.iov_len = buffer.size();
+
+		alignas(::cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+
+		::msghdr msg{};
+		msg.msg_name = sender.data();
+		msg.msg_namelen = ::socklen_t(sender.capacity());
+		msg.msg_iov = std::addressof(iov);
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		for (;;)
+		{
+			::ssize_t n = ::recvmsg(fd, &msg, MSG_DONTWAIT);
+			if (n < 0)
+			{
+				if (errno == EINTR)
+					continue;
+
+				ec = asio::error_code(errno, asio::error::get_system_category());
+				return { 0, 0 };
+			}
+
+			sender.resize(msg.msg_namelen);
+
+			// no control message means a single datagram.
+			std::size_t segment_size = std::size_t(n);
+
+			for (::cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm))
+			{
+				if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO)
+				{
+					int gso_size = 0;
+					std::memcpy(std::addressof(gso_size), CMSG_DATA(cm), sizeof(gso_size));
+					if (gso_size > 0)
+						segment_size = std::size_t(gso_size);
+				}
+			}
+
+			ec = {};
+			return { std::size_t(n), segment_size };
+		}
+	}
+#endif
+
+	struct async_receive_coalesced_op
+	{
+		template<typename AsyncReadStream, typename Endpoint>
+		auto operator()(
+			auto state, std::reference_wrapper<AsyncReadStream> sock_ref,
+			asio::mutable_buffer buffer, std::reference_wrapper<Endpoint> sender_ref) -> void
+		{
+			state.reset_cancellation_state(asio::enable_terminal_cancellation());
+
+			auto& sock = sock_ref.get();
+			auto& sender = sender_ref.get();
+
+		#if defined(ASIO3_HAS_UDP_GRO)
+			bool suspended = false;
+
+			for (;;)
+			{
+				asio::error_code ec{};
+
+				auto [n, segment_size] = receive_gro(sock.native_handle(), buffer, sender, ec);
+
+				if (!ec || (ec != asio::error::would_block && ec != asio::error::try_again))
+				{
+					// never complete inside the initiating function, see async_receive_batch_op.
+					if (!suspended)
+						co_await asio::detail::async_yield(state);
+
+					co_return{ ec, ec ? 0 : n, ec ? 0 : segment_size };
+				}
+
+				auto [e1] = co_await sock.async_wait(asio::socket_base::wait_read, use_nothrow_deferred);
+
+				suspended = true;
+
+				if (e1)
+					co_return{ e1, 0, 0 };
+			}
+		#else
+			auto [e1, n1] = co_await sock.async_receive_from(buffer, sender, use_nothrow_deferred);
+			co_return{ e1, n1, n1 };
+		#endif
+		}
+	};
+}
 
 namespace asio
 {
@@ -53,4 +316,171 @@ ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(ReadToken,
 {
 	return s.async_receive_from(buffers, sender_endpoint, std::forward<ReadToken>(token));
 }
+
+/**
+ * @brief Start an asynchronous receive of a batch of datagrams.
+ * It waits until the socket is readable, then receives as many queued datagrams as the
+ * buffers can hold with one recvmmsg call on linux, so the cost of the syscall and of the
+ * coroutine resume is shared by the whole batch. On the other platforms the first datagram
+ * is received asynchronously and the already queued ones are received synchronously.
+ * @param s - The udp socket.
+ * @param buffers - One buffer for each datagram. When the operation completes, the first
+ *   count buffers are shrunk to the sizes of the received datagrams, so they must be reset
+ *   before the next receive.
+ * @param endpoints - The sender endpoint of each datagram, it can be empty for a connected
+ *   socket. The caller must keep the buffers and the endpoints valid until the completion.
+ * @param token - The completion handler to invoke when the operation completes.
+ *	  The equivalent function signature of the handler must be:
+ *    @code
+ *    void handler(const asio::error_code& ec, std::size_t count);
+ *    The count is the number of the received datagrams, at most asio::udp_max_batch.
+ * @eg:
+ * std::array<asio::mutable_buffer, 16> bufs;
+ * std::array<asio::ip::udp::endpoint, 16> senders;
+ * auto [ec, count] = co_await asio::async_receive_batch(sock, bufs, senders);
+ */
+template <typename AsyncReadStream,
+	ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, std::size_t)) ReadToken
+	ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(typename AsyncReadStream::executor_type)>
+ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(ReadToken, void(asio::error_code, std::size_t))
+async_receive_batch(AsyncReadStream& s, std::span<asio::mutable_buffer> buffers,
+	std::span<typename AsyncReadStream::endpoint_type> endpoints,
+	ReadToken&& token
+	ASIO_DEFAULT_COMPLETION_TOKEN(typename AsyncReadStream::executor_type))
+{
+	return asio::async_initiate<ReadToken, void(asio::error_code, std::size_t)>(
+		asio::detail::recycled_co_composed<void(asio::error_code, std::size_t)>(
+			detail::async_receive_batch_op{}, s),
+		token, std::ref(s), buffers, endpoints);
+}
+
+}
+
+namespace asio::detail
+{
+	struct async_receive_datagram_batch_op
+	{
+		template<typename AsyncReadStream, typename Endpoint>
+		auto operator()(
+			auto state, std::reference_wrapper<AsyncReadStream> sock_ref,
+			std::span<asio::datagram_buffer> datagrams, std::span<Endpoint> endpoints) -> void
+		{
+			state.reset_cancellation_state(asio::enable_terminal_cancellation());
+
+			auto& sock = sock_ref.get();
+
+			std::array<asio::mutable_buffer, udp_max_batch> buffers;
+
+			std::size_t count = (std::min)(datagrams.size(), udp_max_batch);
+
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				if (!datagrams[i])
+					datagrams[i] = asio::datagram_pool::acquire();
+
+				buffers[i] = datagrams[i].prepare();
+			}
+
+			auto [e1, n1] = co_await asio::async_receive_batch(
+				sock, std::span(buffers.data(), count), endpoints, use_nothrow_deferred);
+
+			for (std::size_t i = 0; i < n1; ++i)
+				datagrams[i].commit(buffers[i].size());
+
+			co_return{ e1, n1 };
+		}
+	};
+}
+
+namespace asio
+{
+/**
+ * @brief Start an asynchronous receive of a batch of datagrams into the pooled datagram buffers,
+ * see asio::datagram_pool. The received datagrams can be forwarded without copying, e.g. by
+ * moving or copying the handles, and a header can be consumed or prepended in place.
+ * @param s - The udp socket.
+ * @param datagrams - One buffer for each datagram, the empty ones are acquired from the pool of
+ *   the current thread. When the operation completes, the views of the first count buffers are
+ *   the received datagrams. A datagram which is larger than the capacity is truncated.
+ * @param endpoints - The sender endpoint of each datagram, it can be empty for a connected socket.
+ * @param token - The completion handler to invoke when the operation completes.
+ *	  The equivalent function signature of the handler must be:
+ *    @code
+ *    void handler(const asio::error_code& ec, std::size_t count);
+ * @eg:
+ * std::array<asio::datagram_buffer, 16> datagrams;
+ * std::array<asio::ip::udp::endpoint, 16> senders;
+ * auto [ec, count] = co_await asio::async_receive_batch(sock, datagrams, senders);
+ */
+template <typename AsyncReadStream,
+	ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, std::size_t)) ReadToken
+	ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(typename AsyncReadStream::executor_type)>
+ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(ReadToken, void(asio::error_code, std::size_t))
+async_receive_batch(AsyncReadStream& s, std::span<asio::datagram_buffer> datagrams,
+	std::span<typename AsyncReadStream::endpoint_type> endpoints,
+	ReadToken&& token
+	ASIO_DEFAULT_COMPLETION_TOKEN(typename AsyncReadStream::executor_type))
+{
+	return asio::async_initiate<ReadToken, void(asio::error_code, std::size_t)>(
+		asio::detail::recycled_co_composed<void(asio::error_code, std::size_t)>(
+			detail::async_receive_datagram_batch_op{}, s),
+		token, std::ref(s), datagrams, endpoints);
+}
+
+/**
+ * @brief Enable or disable the udp generic receive offload (UDP_GRO) of a socket, then the
+ * kernel may coalesce the consecutive datagrams of the same flow into one receive, see
+ * asio::async_receive_coalesced.
+ * @return operation_not_supported on the platforms without UDP_GRO.
+ */
+template<typename Socket>
+inline asio::error_code set_udp_gro(Socket& sock, bool onoff = true) noexcept
+{
+#if defined(ASIO3_HAS_UDP_GRO)
+	int value = onoff ? 1 : 0;
+
+	if (::setsockopt(sock.native_handle(), SOL_UDP, UDP_GRO, std::addressof(value), sizeof(value)) != 0)
+		return asio::error_code(errno, asio::error::get_system_category());
+
+	return asio::error_code{};
+#else
+	detail::ignore_unused(sock, onoff);
+
+	return asio::error::operation_not_supported;
+#endif
+}
+
+/**
+ * @brief Start an asynchronous receive of coalesced datagrams.
+ * When the udp generic receive offload is enabled by asio::set_udp_gro, the kernel may deliver
+ * several datagrams of the same sender and size in one receive, they are laid one after another
+ * in the buffer, each is segment_size bytes except the last one which may be shorter. Otherwise,
+ * or on the platforms without UDP_GRO, one datagram is received and the segment_size is its size.
+ * @param s - The udp socket.
+ * @param buffer - The buffer, it should be at least 64KiB, otherwise the coalesced datagrams are
+ *   truncated. The caller must keep it valid until the completion.
+ * @param sender_endpoint - The endpoint of the sender of the datagrams.
+ * @param token - The completion handler to invoke when the operation completes.
+ *	  The equivalent function signature of the handler must be:
+ *    @code
+ *    void handler(const asio::error_code& ec, std::size_t bytes_received, std::size_t segment_size);
+ * @eg:
+ * asio::set_udp_gro(sock);
+ * std::vector<char> buf(65536);
+ * auto [ec, n, segment_size] = co_await asio::async_receive_coalesced(sock, asio::buffer(buf), sender);
+ */
+template <typename AsyncReadStream,
+	ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, std::size_t, std::size_t)) ReadToken
+	ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(typename AsyncReadStream::executor_type)>
+ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(ReadToken, void(asio::error_code, std::size_t, std::size_t))
+async_receive_coalesced(AsyncReadStream& s, asio::mutable_buffer buffer,
+	typename AsyncReadStream::endpoint_type& sender_endpoint,
+	ReadToken&& token
+	ASIO_DEFAULT_COMPLETION_TOKEN(typename AsyncReadStream::executor_type))
+{
+	return asio::async_initiate<ReadToken, void(asio::error_code, std::size_t, std::size_t)>(
+		asio::detail::recycled_co_composed<void(asio::error_code, std::size_t, std::size_t)>(
+			detail::async_receive_coalesced_op{}, s),
+		token, std::ref(s), buffer, std::ref(sender_endpoint));
+}
 }
@@ -0,0 +1,688 @@
+/*
+ * Copyright (c) 2017-2023 zhllxt
+ *
+ * author   : zhllxt
+ * email    : 37792738@qq.com
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <asio3/core/asio.hpp>
+#include <asio3/core/frame_allocator.hpp>
+#include <asio3/core/timing_wheel.hpp>
+#include <asio3/core/detail/hash.hpp>
+#include <asio3/core/detail/idle_counter.hpp>
+#include <asio3/core/detail/netutil.hpp>
+#include <asio3/core/detail/open_addressing_map.hpp>
+#include <asio3/udp/core.hpp>
+#include <asio3/udp/read.hpp>
+
+namespace asio
+{
+	struct udp_sessions_option
+	{
+		/// The datagrams which are larger than this are dropped.
+		std::size_t                         max_datagram_size = 1500;
+
+		/// The maximum queued datagrams of each session, the new datagrams are dropped when it is full.
+		std::size_t                         queue_size        = 64;
+
+		/// The maximum number of the sessions, the datagrams of the new peers are dropped when it is reached.
+		std::size_t                         max_sessions      = 4096;
+
+		/// The maximum number of the new sessions which are not accepted yet.
+		std::size_t                         accept_backlog    = 128;
+
+		/// The maximum datagrams received per readiness event, see asio::async_receive_batch.
+		std::size_t                         receive_batch     = 16;
+
+		/// The session is closed with asio::error::timed_out when it neither receives nor sends
+		/// any datagram for this duration, zero means no idle timeout. The timeout is detected
+		/// within a quarter of it.
+		std::chrono::steady_clock::duration idle_timeout      = std::chrono::seconds(60);
+	};
+
+	class udp_session;
+}
+
+namespace asio::detail
+{
+	class udp_sessions_impl;
+
+	struct async_udp_session_receive_op
+	{
+		template<typename Session>
+		auto operator()(auto state, std::shared_ptr<Session> session, asio::mutable_buffer buffer) -> void
+		{
+			state.reset_cancellation_state(asio::enable_terminal_cancellation());
+
+			Session& s = *session;
+
+			bool suspended = false;
+
+			for (;;)
+			{
+				if (s.count_ > 0)
+				{
+					// a queued datagram is ready already, don't complete inside the initiating function.
+					if (!suspended)
+					{
+						co_await asio::detail::async_yield(state);
+
+						suspended = true;
+
+						continue;
+					}
+
+					co_return{ asio::error_code{}, s.pop(buffer) };
+				}
+
+				if (s.closed_)
+				{
+					if (!suspended)
+						co_await asio::detail::async_yield(state);
+
+					co_return{ s.reason_, 0 };
+				}
+
+				s.waiting_ = true;
+
+				s.notifier_.expires_at((asio::steady_timer::time_point::max)());
+
+				co_await s.notifier_.async_wait(use_nothrow_deferred);
+
+				s.waiting_ = false;
+
+				suspended = true;
+
+				if (!!state.cancelled())
+					co_return{ asio::error::operation_aborted, 0 };
+			}
+		}
+	};
+
+	struct async_udp_sessions_accept_op
+	{
+		template<typename Impl>
+		auto operator()(auto state, std::shared_ptr<Impl> impl) -> void
+		{
+			state.reset_cancellation_state(asio::enable_terminal_cancellation());
+
+			bool suspended = false;
+
+			for (;;)
+			{
+				if (!impl->accepts_.empty())
+				{
+					// a new session is queued already, don't complete inside the initiating function.
+					if (!suspended)
+					{
+						co_await asio::detail::async_yield(state);
+
+						suspended = true;
+
+						continue;
+					}
+
+					auto s = std::move(impl->accepts_.front());
+					impl->accepts_.pop_front();
+					co_return{ asio::error_code{}, std::move(s) };
+				}
+
+				if (impl->closed_)
+				{
+					if (!suspended)
+						co_await asio::detail::async_yield(state);
+
+					co_return{ asio::error::operation_aborted, nullptr };
+				}
+
+				impl->accept_waiting_ = true;
+
+				impl->accept_notifier_.expires_at((asio::steady_timer::time_point::max)());
+
+				co_await impl->accept_notifier_.async_wait(use_nothrow_deferred);
+
+				impl->accept_waiting_ = false;
+
+				suspended = true;
+
+				if (!!state.cancelled())
+					co_return{ asio::error::operation_aborted, nullptr };
+			}
+		}
+	};
+}
+
+namespace asio
+{
+	/**
+	 * @brief The datagrams of one remote endpoint of a udp_server_sessions, it is used like a
+	 * connected socket. All the functions must be called in the executor of the server socket.
+	 */
+	class udp_session : public std::enable_shared_from_this<udp_session>
+	{
+	public:
+		using executor_type = asio::udp_socket::executor_type;
+
+		udp_session(std::shared_ptr<detail::udp_sessions_impl> impl, asio::udp_socket& sock,
+			const asio::ip::udp::endpoint& remote, const udp_sessions_option& opt)
+			: impl_(std::move(impl))
+			, socket_(sock)
+			, remote_(remote)
+			, slot_size_(opt.max_datagram_size)
+			, capacity_((std::max)(opt.queue_size, std::size_t(1)))
+			, storage_(std::make_unique<char[]>(slot_size_ * capacity_))
+			, sizes_(std::make_unique<std::size_t[]>(capacity_))
+			, notifier_(sock.get_executor())
+		{
+		}
+
+		udp_session(const udp_session&) = delete;
+		udp_session& operator=(const udp_session&) = delete;
+
+		inline executor_type get_executor() noexcept
+		{
+			return socket_.get_executor();
+		}
+
+		inline const asio::ip::udp::endpoint& remote_endpoint() const noexcept
+		{
+			return remote_;
+		}
+
+		/**
+		 * @brief Get the server socket, it is shared by all the sessions.
+		 */
+		inline asio::udp_socket& socket() noexcept
+		{
+			return socket_;
+		}
+
+		/**
+		 * @brief Whether the session is still receiving the datagrams of the remote endpoint.
+		 */
+		inline bool is_open() const noexcept
+		{
+			return !closed_;
+		}
+
+		/**
+		 * @brief The number of the datagrams dropped because the queue was full.
+		 */
+		inline std::size_t dropped() const noexcept
+		{
+			return dropped_;
+		}
+
+		/**
+		 * @brief Stop receiving the datagrams of the remote endpoint, the pending receive completes
+		 * with asio::error::operation_aborted. A later datagram of the remote endpoint is accepted
+		 * as a new session.
+		 */
+		inline void close();
+
+		/**
+		 * @brief Receive one datagram of the remote endpoint, the queued datagrams are received
+		 * first even after the session is closed.
+		 * @param buffer - The buffer, the datagram is truncated if it is too small.
+		 * @param token - The completion handler to invoke when the operation completes.
+		 *	  The equivalent function signature of the handler must be:
+		 *    @code
+		 *    void handler(const asio::error_code& ec, std::size_t bytes_received);
+		 *    The ec is asio::error::timed_out when the session expired.
+		 */
+		template<
+			ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, std::size_t)) ReadToken
+			ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(executor_type)>
+		ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(ReadToken, void(asio::error_code, std::size_t))
+		async_receive(
+			asio::mutable_buffer buffer,
+			ReadToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(executor_type))
+		{
+			return asio::async_initiate<ReadToken, void(asio::error_code, std::size_t)>(
+				asio::detail::recycled_co_composed<void(asio::error_code, std::size_t)>(
+					detail::async_udp_session_receive_op{}, socket_),
+				token, this->shared_from_this(), buffer);
+		}
+
+		/**
+		 * @brief Send one datagram to the remote endpoint by the server socket.
+		 * @param buffers - One or more buffers to be sent as one datagram.
+		 * @param token - The completion handler to invoke when the operation completes.
+		 *	  The equivalent function signature of the handler must be:
+		 *    @code
+		 *    void handler(const asio::error_code& ec, std::size_t bytes_sent);
+		 */
+		template<typename ConstBufferSequence,
+			ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, std::size_t)) WriteToken
+			ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(executor_type)>
+		ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(WriteToken, void(asio::error_code, std::size_t))
+		async_send(
+			const ConstBufferSequence& buffers,
+			WriteToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(executor_type))
+		{
+			idle_.touch();
+
+			return socket_.async_send_to(buffers, remote_, std::forward<WriteToken>(token));
+		}
+
+	protected:
+		friend class detail::udp_sessions_impl;
+		friend struct detail::async_udp_session_receive_op;
+
+		/**
+		 * @brief Queue a datagram, it is dropped if the queue is full.
+		 */
+		inline void push(asio::const_buffer datagram) noexcept
+		{
+			idle_.touch();
+
+			if (count_ == capacity_)
+			{
+				++dropped_;
+				return;
+			}
+
+			std::size_t tail = (head_ + count_) % capacity_;
+
+			std::memcpy(storage_.get() + tail * slot_size_, datagram.data(), datagram.size());
+			sizes_[tail] = datagram.size();
+
+			++count_;
+
+			if (waiting_)
+				asio::detail::cancel_timer(notifier_);
+		}
+
+		/**
+		 * @brief Copy the oldest queued datagram to the buffer and dequeue it.
+		 */
+		inline std::size_t pop(asio::mutable_buffer buffer) noexcept
+		{
+			std::size_t n = (std::min)(sizes_[head_], buffer.size());
+
+			std::memcpy(buffer.data(), storage_.get() + head_ * slot_size_, n);
+
+			head_ = (head_ + 1) % capacity_;
+
+			--count_;
+
+			return n;
+		}
+
+		inline void shutdown(const asio::error_code& reason) noexcept
+		{
+			if (closed_)
+				return;
+
+			closed_ = true;
+			reason_ = reason;
+
+			if (waiting_)
+				asio::detail::cancel_timer(notifier_);
+		}
+
+	protected:
+		std::shared_ptr<detail::udp_sessions_impl> impl_;
+
+		asio::udp_socket&                          socket_;
+
+		asio::ip::udp::endpoint                    remote_;
+
+		/// the queue is a ring of fixed size slots, it is allocated once when the session is created.
+		std::size_t                                slot_size_;
+		std::size_t                                capacity_;
+		std::unique_ptr<char[]>                    storage_;
+		std::unique_ptr<std::size_t[]>             sizes_;
+		std::size_t                                head_    = 0;
+		std::size_t                                count_   = 0;
+
+		/// canceled when a datagram is queued or the session is closed.
+		asio::steady_timer                         notifier_;
+
+		asio::error_code                           reason_{};
+
+		std::size_t                                dropped_ = 0;
+
+		detail::idle_counter                       idle_{};
+
+		bool                                       waiting_ = false;
+		bool                                       closed_  = false;
+	};
+}
+
+namespace asio::detail
+{
+	/**
+	 * The sessions are keyed by the remote endpoint, all the members are accessed in the
+	 * executor of the socket only.
+	 */
+	class udp_sessions_impl : public std::enable_shared_from_this<udp_sessions_impl>
+	{
+	public:
+		udp_sessions_impl(asio::udp_socket sock, udp_sessions_option opt)
+			: socket_(std::move(sock))
+			, option_(std::move(opt))
+			, accept_notifier_(socket_.get_executor())
+			, ticker_(socket_.get_executor())
+		{
+			if (option_.max_datagram_size == 0)
+				option_.max_datagram_size = udp_frame_size;
+
+			option_.receive_batch = (std::clamp)(option_.receive_batch, std::size_t(1), udp_max_batch);
+
+			// one more byte to find out the datagrams which are larger than the max size.
+			std::size_t slot = option_.max_datagram_size + 1;
+
+			receive_storage_.resize(slot * option_.receive_batch);
+			receive_buffers_.resize(option_.receive_batch);
+			receive_endpoints_.resize(option_.receive_batch);
+		}
+
+		inline asio::udp_socket& socket() noexcept { return socket_; }
+
+		inline const udp_sessions_option& option() const noexcept { return option_; }
+
+		inline bool is_closed() const noexcept { return closed_; }
+
+		inline std::size_t size() const noexcept { return sessions_.size(); }
+
+		inline std::size_t dropped() const noexcept { return dropped_; }
+
+		void start()
+		{
+			this->receive();
+
+			if (option_.idle_timeout > std::chrono::steady_clock::duration::zero())
+				this->tick();
+		}
+
+		void close()
+		{
+			if (closed_)
+				return;
+
+			closed_ = true;
+
+			asio::error_code ec{};
+			socket_.close(ec);
+
+			ticker_.cancel();
+
+			sessions_.for_each([](const asio::ip::udp::endpoint&, std::shared_ptr<udp_session>& s)
+			{
+				s->shutdown(asio::error::operation_aborted);
+			});
+
+			sessions_.clear();
+
+			accepts_.clear();
+
+			if (accept_waiting_)
+				asio::detail::cancel_timer(accept_notifier_);
+		}
+
+		/**
+		 * @brief Remove the session from the table, if the endpoint is not taken by a new session.
+		 */
+		void erase(udp_session& s)
+		{
+			if (std::shared_ptr<udp_session>* p = sessions_.find(s.remote_); p && p->get() == std::addressof(s))
+				sessions_.erase(s.remote_);
+		}
+
+	protected:
+		friend struct async_udp_sessions_accept_op;
+
+		void receive()
+		{
+			std::size_t slot = option_.max_datagram_size + 1;
+
+			for (std::size_t i = 0; i < receive_buffers_.size(); ++i)
+				receive_buffers_[i] = asio::buffer(receive_storage_.data() + i * slot, slot);
+
+			asio::async_receive_batch(socket_, receive_buffers_, receive_endpoints_,
+			[self = this->shared_from_this()](const asio::error_code& ec, std::size_t count) mutable
+			{
+				self->on_receive(ec, count);
+			});
+		}
+
+		void on_receive(const asio::error_code& ec, std::size_t count)
+		{
+			if (closed_ || ec == asio::error::operation_aborted || ec == asio::error::bad_descriptor)
+				return;
+
+			// other errors, e.g. connection_refused caused by an icmp port unreachable, are ignored.
+			for (std::size_t i = 0; !ec && i < count; ++i)
+				this->dispatch(receive_endpoints_[i], receive_buffers_[i]);
+
+			this->receive();
+		}
+
+		void dispatch(const asio::ip::udp::endpoint& remote, asio::const_buffer datagram)
+		{
+			if (datagram.size() > option_.max_datagram_size)
+			{
+				++dropped_;
+				return;
+			}
+
+			if (std::shared_ptr<udp_session>* p = sessions_.find(remote))
+			{
+				(*p)->push(datagram);
+				return;
+			}
+
+			if (sessions_.size() >= option_.max_sessions || accepts_.size() >= option_.accept_backlog)
+			{
+				++dropped_;
+				return;
+			}
+
+			std::shared_ptr<udp_session> s = std::make_shared<udp_session>(
+				this->shared_from_this(), socket_, remote, option_);
+
+			s->push(datagram);
+
+			sessions_.insert(remote, s);
+
+			accepts_.emplace_back(std::move(s));
+
+			if (accept_waiting_)
+				asio::detail::cancel_timer(accept_notifier_);
+		}
+
+		void tick()
+		{
+			ticker_.expires_after(detail::idle_counter::interval(option_.idle_timeout));
+			ticker_.async_wait([self = this->shared_from_this()](const asio::error_code& ec) mutable
+			{
+				if (ec || self->closed_)
+					return;
+
+				self->sweep();
+				self->tick();
+			});
+		}
+
+		void sweep()
+		{
+			sessions_.for_each([this](const asio::ip::udp::endpoint&, std::shared_ptr<udp_session>& s)
+			{
+				if (s->idle_.tick())
+				{
+					expired_.emplace_back(s);
+				}
+			});
+
+			for (std::shared_ptr<udp_session>& s : expired_)
+			{
+				sessions_.erase(s->remote_);
+
+				s->shutdown(asio::error::timed_out);
+			}
+
+			expired_.clear();
+		}
+
+	protected:
+		asio::udp_socket                                                        socket_;
+
+		udp_sessions_option                                                     option_;
+
+		open_addressing_map<asio::ip::udp::endpoint, std::shared_ptr<udp_session>> sessions_;
+
+		/// the new sessions which are not accepted yet.
+		std::deque<std::shared_ptr<udp_session>>                                accepts_;
+
+		/// canceled when a new session is queued or the server is closed.
+		asio::steady_timer                                                      accept_notifier_;
+
+		bool                                                                    accept_waiting_ = false;
+
+		std::vector<char>                                                       receive_storage_;
+		std::vector<asio::mutable_buffer>                                       receive_buffers_;
+		std::vector<asio::ip::udp::endpoint>                                    receive_endpoints_;
+
+		asio::deadline                                                          ticker_;
+
+		std::vector<std::shared_ptr<udp_session>>                               expired_;
+
+		std::size_t                                                             dropped_ = 0;
+
+		bool                                                                    closed_  = false;
+	};
+}
+
+namespace asio
+{
+	inline void udp_session::close()
+	{
+		if (closed_)
+			return;
+
+		impl_->erase(*this);
+
+		this->shutdown(asio::error::operation_aborted);
+	}
+
+	/**
+	 * @brief A udp server which demultiplexes the datagrams of the socket by the remote endpoint,
+	 * the first datagram of a new remote endpoint creates a udp_session, which is accepted like a
+	 * tcp connection, and the later datagrams of it are queued to the session. The lookup of the
+	 * session is one probe of an open addressing table, it does not allocate.
+	 * The executor of the socket must be a strand or a single threaded io_context, and the
+	 * sessions must be used in it.
+	 * @eg:
+	 * asio::udp_server_sessions server(asio::udp_socket(ctx, asio::ip::udp::endpoint(asio::ip::udp::v4(), 8035)));
+	 * auto [ec, session] = co_await server.async_accept();
+	 * auto [e1, n1] = co_await session->async_receive(asio::buffer(buf));
+	 * auto [e2, n2] = co_await session->async_send(asio::buffer(buf.data(), n1));
+	 */
+	class udp_server_sessions
+	{
+	public:
+		using executor_type = asio::udp_socket::executor_type;
+
+		explicit udp_server_sessions(asio::udp_socket sock, udp_sessions_option opt = {})
+			: impl_(std::make_shared<detail::udp_sessions_impl>(std::move(sock), std::move(opt)))
+		{
+			asio::dispatch(impl_->socket().get_executor(), [impl = impl_]() mutable
+			{
+				impl->start();
+			});
+		}
+
+		udp_server_sessions(udp_server_sessions&&) noexcept = default;
+		udp_server_sessions& operator=(udp_server_sessions&&) noexcept = default;
+
+		~udp_server_sessions()
+		{
+			close();
+		}
+
+		/**
+		 * @brief Close the socket and all the sessions, and abort the pending accept.
+		 */
+		inline void close()
+		{
+			if (impl_)
+			{
+				asio::dispatch(impl_->socket().get_executor(), [impl = impl_]() mutable
+				{
+					impl->close();
+				});
+			}
+		}
+
+		inline executor_type get_executor() noexcept
+		{
+			return impl_->socket().get_executor();
+		}
+
+		/**
+		 * @brief Get the socket, it must be used in the executor of it.
+		 */
+		inline asio::udp_socket& socket() noexcept
+		{
+			return impl_->socket();
+		}
+
+		inline const udp_sessions_option& get_option() const noexcept
+		{
+			return impl_->option();
+		}
+
+		/**
+		 * @brief The number of the sessions, include the ones which are not accepted yet.
+		 */
+		inline std::size_t size() const noexcept
+		{
+			return impl_->size();
+		}
+
+		/**
+		 * @brief The number of the datagrams dropped because they were too large, or the limit of
+		 * the sessions or the accept backlog was reached.
+		 */
+		inline std::size_t dropped() const noexcept
+		{
+			return impl_->dropped();
+		}
+
+		/**
+		 * @brief Accept a new session asynchronously, it completes when a datagram is received from
+		 * a new remote endpoint.
+		 * @param token - The completion handler to invoke when the operation completes.
+		 *	  The equivalent function signature of the handler must be:
+		 *    @code
+		 *    void handler(const asio::error_code& ec, std::shared_ptr<asio::udp_session> session);
+		 */
+		template<
+			ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, std::shared_ptr<udp_session>)) AcceptToken
+			ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(executor_type)>
+		ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(AcceptToken, void(asio::error_code, std::shared_ptr<udp_session>))
+		async_accept(AcceptToken&& token ASIO_DEFAULT_COMPLETION_TOKEN(executor_type))
+		{
+			return asio::async_initiate<AcceptToken, void(asio::error_code, std::shared_ptr<udp_session>)>(
+				asio::detail::recycled_co_composed<void(asio::error_code, std::shared_ptr<udp_session>)>(
+					detail::async_udp_sessions_accept_op{}, impl_->socket()),
+				token, impl_);
+		}
+
+	protected:
+		std::shared_ptr<detail::udp_sessions_impl> impl_;
+	};
+}
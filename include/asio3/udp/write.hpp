@@ -10,7 +10,15 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
 #include <asio3/core/asio.hpp>
+#include <asio3/core/frame_allocator.hpp>
+#include <asio3/core/resolve_cache.hpp>
 #include <asio3/udp/core.hpp>
 
 namespace asio::detail
@@ -29,9 +37,7 @@ namespace asio::detail
 			std::string h = asio::to_string(std::forward<String>(host));
 			std::string p = asio::to_string(std::forward<StrOrInt>(port));
 
-			asio::ip::udp::resolver resolver(sock.get_executor());
-
-			auto [e1, eps] = co_await resolver.async_resolve(h, p, use_nothrow_deferred);
+			auto [e1, eps] = co_await asio::async_cached_resolve(sock.get_executor(), h, p, use_nothrow_deferred);
 			if (e1)
 				co_return{ e1, 0 };
 
@@ -41,10 +47,366 @@ namespace asio::detail
 			if (eps.empty())
 				co_return{ asio::error::host_unreachable, 0 };
 
-			auto [e2, n2] = co_await sock.async_send_to(buffers, (*eps).endpoint(), use_nothrow_deferred);
+			asio::ip::udp::endpoint dest((*eps).endpoint().address(), (*eps).endpoint().port());
+
+			auto [e2, n2] = co_await sock.async_send_to(buffers, dest, use_nothrow_deferred);
 			co_return{ e2, n2 };
 		}
 	};
+
+#if defined(ASIO3_HAS_MMSG)
+	/**
+	 * @brief sendmmsg once without blocking. The endpoints can be empty for a connected
+	 * socket, or one endpoint for all the datagrams, or one endpoint for each datagram.
+	 * @return the count of the sent datagrams, 0 means failed and the ec is set.
+	 */
+	template<typename Endpoint>
+	inline std::size_t send_mmsg(int fd,
+		std::span<const asio::const_buffer> buffers, std::span<const Endpoint> endpoints, asio::error_code& ec)
+	{
+		std::size_t count = (std::min)(buffers.size(), udp_max_batch);
+		if (endpoints.size() > 1)
+			count = (std::min)(count, endpoints.size());
+
+		::mmsghdr msgs[udp_max_batch];
+		::iovec   iovs[udp_max_batch];
+
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			iovs[i].iov_base = const_cast<void*>(buffers[i].data());
+			iovs[i].iov_len = buffers[i].size();
+
+			msgs[i] = {};
+			msgs[i].msg_hdr.msg_iov = std::addressof(iovs[i]);
+			msgs[i].msg_hdr.msg_iovlen = 1;
+
+			if (!endpoints.empty())
+			{
+				const Endpoint& ep = endpoints.size() > 1 ? endpoints[i] : endpoints[0];
+
+				msgs[i].msg_hdr.msg_name = const_cast<void*>(static_cast<const void*>(ep.data()));
+				msgs[i].msg_hdr.msg_namelen = ::socklen_t(ep.size());
+			}
+		}
+
+		for (;;)
+		{
+			int n = ::sendmmsg(fd, msgs, static_cast<unsigned int>(count), MSG_DONTWAIT | MSG_NOSIGNAL);
+			if (n >= 0)
+			{
+				ec = {};
+				return std::size_t(n);
+			}
+
+			if (errno == EINTR)
+				continue;
+
+			ec = asio::error_code(errno, asio::error::get_system_category());
+			return 0;
+		}
+	}
+#endif
+
+	/**
+	 * @brief Send a batch of datagrams without blocking, stop at the first datagram which can't
+	 * be sent now. The endpoints are the same as asio::async_send_batch.
+	 * @return the count of the sent datagrams, the ec is set when it is less than the buffers size.
+	 */
+	template<typename DatagramSocket, typename Endpoint>
+	std::size_t send_batch_nonblocking(DatagramSocket& sock,
+		std::span<const asio::const_buffer> buffers, std::span<const Endpoint> endpoints, asio::error_code& ec)
+	{
+		std::size_t total = buffers.size();
+		if (endpoints.size() > 1)
+			total = (std::min)(total, endpoints.size());
+
+		std::size_t sent = 0;
+
+		ec = {};
+
+	#if defined(ASIO3_HAS_MMSG)
+		while (sent < total)
+		{
+			std::size_t n = send_mmsg(sock.native_handle(), buffers.subspan(sent, total - sent),
+				endpoints.size() > 1 ? endpoints.subspan(sent) : endpoints, ec);
+			if (ec)
+				break;
+
+			sent += n;
+		}
+	#else
+		// the async operations still work when the socket is in the user non blocking mode.
+		if (!sock.non_blocking())
+			sock.non_blocking(true, ec);
+
+		for (; !ec && sent < total; ++sent)
+		{
+			if (endpoints.empty())
+				sock.send(buffers[sent], 0, ec);
+			else
+				sock.send_to(buffers[sent], endpoints.size() > 1 ? endpoints[sent] : endpoints[0], 0, ec);
+
+			if (ec)
+				break;
+		}
+	#endif
+
+		return sent;
+	}
+
+	struct async_send_batch_op
+	{
+		template<typename AsyncWriteStream, typename Endpoint>
+		auto operator()(
+			auto state, std::reference_wrapper<AsyncWriteStream> sock_ref,
+			std::span<const asio::const_buffer> buffers, std::span<const Endpoint> endpoints) -> void
+		{
+			state.reset_cancellation_state(asio::enable_terminal_cancellation());
+
+			auto& sock = sock_ref.get();
+
+			std::size_t total = buffers.size();
+			if (endpoints.size() > 1)
+				total = (std::min)(total, endpoints.size());
+
+			std::size_t sent = 0;
+
+			asio::error_code ec{};
+
+			// the handler is never invoked inside the initiating function, even if the whole batch
+			// is sent without waiting, otherwise a send loop would recurse without bound.
+			bool suspended = false;
+
+			while (sent < total)
+			{
+				std::span<const Endpoint> eps = endpoints.size() > 1 ? endpoints.subspan(sent) : endpoints;
+
+			#if defined(ASIO3_HAS_MMSG)
+				std::size_t n = send_mmsg(sock.native_handle(), buffers.subspan(sent, total - sent), eps, ec);
+				if (!ec)
+				{
+					sent += n;
+					continue;
+				}
+
+				if (ec != asio::error::would_block && ec != asio::error::try_again)
+					break;
+
+				auto [e1] = co_await sock.async_wait(asio::socket_base::wait_write, use_nothrow_deferred);
+
+				suspended = true;
+
+				if (e1)
+					co_return{ e1, sent };
+
+				ec = {};
+			#else
+				if (eps.empty())
+				{
+					auto [e1, n1] = co_await sock.async_send(buffers[sent], use_nothrow_deferred);
+					if (e1)
+						co_return{ e1, sent };
+				}
+				else
+				{
+					auto [e1, n1] = co_await sock.async_send_to(buffers[sent], eps[0], use_nothrow_deferred);
+					if (e1)
+						co_return{ e1, sent };
+				}
+
+				suspended = true;
+
+				++sent;
+			#endif
+			}
+
+			if (!suspended)
+				co_await asio::detail::async_yield(state);
+
+			co_return{ ec, sent };
+		}
+	};
+
+#if defined(ASIO3_HAS_UDP_GSO)
+	/// cleared when the kernel does not know UDP_SEGMENT, then only the software fallback is used.
+	inline std::atomic<bool>& udp_gso_supported() noexcept
+	{
+		static std::atomic<bool> supported{ true };
+		return supported;
+	}
+
+	/**
+	 * @brief sendmsg a chunk of the data once without blocking, the kernel splits it into
+	 * the datagrams of segment_size bytes.
+	 * @return the bytes sent, 0 means failed and the ec is set.
+	 */
+	template<typename Endpoint>
+	inline std::size_t send_gso(int fd,
+		asio::const_buffer data, std::size_t segment_size, const Endpoint& dest, asio::error_code& ec) noexcept
+	{
+		std::size_t segments = (std::min)(udp_max_batch, udp_max_offload_size / segment_size);
+
+		::iovec iov{};
+		iov.iov_base = const_cast<void*>(data.data());
+		iov.iov_len = (std::min)(data.size(), segments * segment_size);
+
+		alignas(::cmsghdr) char control[CMSG_SPACE(sizeof(std::uint16_t))]{};
+
+		::msghdr msg{};
+		msg.msg_name = const_cast<void*>(static_cast<const void*>(dest.data()));
+		msg.msg_namelen = ::socklen_t(dest.size());
+		msg.msg_iov = std::addressof(iov);
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		::cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+		cm->cmsg_level = SOL_UDP;
+		cm->cmsg_type = UDP_SEGMENT;
+		cm->cmsg_len = CMSG_LEN(sizeof(std::uint16_t));
+
+		std::uint16_t gso_size = std::uint16_t(segment_size);
+		std::memcpy(CMSG_DATA(cm), std::addressof(gso_size), sizeof(gso_size));
+
+		for (;;)
+		{
+			::ssize_t n = ::sendmsg(fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+			if (n >= 0)
+			{
+				ec = {};
+				return std::size_t(n);
+			}
+
+			if (errno == EINTR)
+				continue;
+
+			ec = asio::error_code(errno, asio::error::get_system_category());
+			return 0;
+		}
+	}
+#endif
+
+#if defined(ASIO3_HAS_MMSG)
+	/**
+	 * @brief Split the data into the datagrams of segment_size bytes, and send a batch of
+	 * them once without blocking.
+	 * @return the bytes sent, 0 means failed and the ec is set.
+	 */
+	template<typename Endpoint>
+	inline std::size_t send_segments_mmsg(int fd,
+		asio::const_buffer data, std::size_t segment_size, const Endpoint& dest, asio::error_code& ec)
+	{
+		asio::const_buffer segments[udp_max_batch];
+
+		std::size_t count = 0;
+		for (; count < udp_max_batch && data.size() > 0; ++count)
+		{
+			segments[count] = asio::buffer(data, segment_size);
+			data += segments[count].size();
+		}
+
+		std::size_t n = send_mmsg(fd, std::span<const asio::const_buffer>(segments, count),
+			std::span<const Endpoint>(std::addressof(dest), 1), ec);
+
+		std::size_t bytes = 0;
+		for (std::size_t i = 0; i < n; ++i)
+			bytes += segments[i].size();
+
+		return bytes;
+	}
+#endif
+
+	struct async_send_segments_op
+	{
+		template<typename AsyncWriteStream, typename Endpoint>
+		auto operator()(
+			auto state, std::reference_wrapper<AsyncWriteStream> sock_ref,
+			asio::const_buffer data, std::size_t segment_size, Endpoint dest) -> void
+		{
+			state.reset_cancellation_state(asio::enable_terminal_cancellation());
+
+			auto& sock = sock_ref.get();
+
+			if (segment_size == 0)
+			{
+				co_await asio::detail::async_yield(state);
+				co_return{ asio::error::invalid_argument, 0 };
+			}
+
+			std::size_t sent = 0;
+
+			asio::error_code ec{};
+
+			// never complete inside the initiating function, see async_send_batch_op.
+			bool suspended = false;
+
+			while (sent < data.size())
+			{
+				asio::const_buffer rest = data + sent;
+
+				std::size_t n = 0;
+
+				bool offloaded = false;
+
+			#if defined(ASIO3_HAS_UDP_GSO)
+				if (rest.size() > segment_size && segment_size * 2 <= udp_max_offload_size &&
+					udp_gso_supported().load(std::memory_order_relaxed))
+				{
+					n = send_gso(sock.native_handle(), rest, segment_size, dest, ec);
+
+					offloaded = true;
+
+					// EIO means the route has no checksum offload, EINVAL means the segment is larger
+					// than the mtu, they are sent by the software fallback.
+					if (ec == asio::error::no_protocol_option || ec == asio::error::operation_not_supported)
+					{
+						udp_gso_supported().store(false, std::memory_order_relaxed);
+						offloaded = false;
+					}
+					else if (ec == asio::error::invalid_argument || ec.value() == EIO)
+					{
+						offloaded = false;
+					}
+				}
+			#endif
+
+				if (!offloaded)
+				{
+				#if defined(ASIO3_HAS_MMSG)
+					n = send_segments_mmsg(sock.native_handle(), rest, segment_size, dest, ec);
+				#else
+					auto [e1, n1] = co_await sock.async_send_to(asio::buffer(rest, segment_size), dest, use_nothrow_deferred);
+					ec = e1;
+					n = n1;
+					suspended = true;
+				#endif
+				}
+
+				if (!ec)
+				{
+					sent += n;
+					continue;
+				}
+
+				if (ec != asio::error::would_block && ec != asio::error::try_again)
+					break;
+
+				auto [e2] = co_await sock.async_wait(asio::socket_base::wait_write, use_nothrow_deferred);
+
+				suspended = true;
+
+				if (e2)
+					co_return{ e2, sent };
+
+				ec = {};
+			}
+
+			if (!suspended)
+				co_await asio::detail::async_yield(state);
+
+			co_return{ ec, sent };
+		}
+	};
 }
 
 namespace asio
@@ -123,8 +485,77 @@ async_send_to(AsyncWriteStream& s, const ConstBufferSequence& buffers,
 	ASIO_DEFAULT_COMPLETION_TOKEN(typename AsyncWriteStream::executor_type))
 {
 	return asio::async_initiate<WriteToken, void(asio::error_code, std::size_t)>(
-		asio::experimental::co_composed<void(asio::error_code, std::size_t)>(
+		asio::detail::recycled_co_composed<void(asio::error_code, std::size_t)>(
 			detail::async_send_to_op{}, s),
 		token, std::ref(s), buffers, std::forward<String>(host), std::forward<StrOrInt>(port));
 }
+
+/**
+ * @brief Start an asynchronous send of a batch of datagrams.
+ * Each buffer is sent as one datagram, up to asio::udp_max_batch datagrams are sent with one
+ * sendmmsg call on linux, on the other platforms they are sent one by one.
+ * @param s - The udp socket.
+ * @param buffers - One buffer for each datagram.
+ * @param endpoints - The destinations, it can be empty for a connected socket, or one
+ *   endpoint for all the datagrams, or one endpoint for each datagram. The caller must keep
+ *   the buffers and the endpoints valid until the completion.
+ * @param token - The completion handler to invoke when the operation completes.
+ *	  The equivalent function signature of the handler must be:
+ *    @code
+ *    void handler(const asio::error_code& ec, std::size_t count);
+ *    The count is the number of the sent datagrams, it is less than the buffers size only
+ *    when the ec is set.
+ * @eg:
+ * std::array<asio::const_buffer, 2> bufs{ asio::buffer("hello"), asio::buffer("world") };
+ * asio::ip::udp::endpoint dest(asio::ip::make_address("127.0.0.1"), 8035);
+ * auto [ec, count] = co_await asio::async_send_batch(sock, bufs, std::span(&dest, 1));
+ */
+template <typename AsyncWriteStream,
+	ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, std::size_t)) WriteToken
+	ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(typename AsyncWriteStream::executor_type)>
+ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(WriteToken, void(asio::error_code, std::size_t))
+async_send_batch(AsyncWriteStream& s, std::span<const asio::const_buffer> buffers,
+	std::span<const typename AsyncWriteStream::endpoint_type> endpoints,
+	WriteToken&& token
+	ASIO_DEFAULT_COMPLETION_TOKEN(typename AsyncWriteStream::executor_type))
+{
+	return asio::async_initiate<WriteToken, void(asio::error_code, std::size_t)>(
+		asio::detail::recycled_co_composed<void(asio::error_code, std::size_t)>(
+			detail::async_send_batch_op{}, s),
+		token, std::ref(s), buffers, endpoints);
+}
+
+/**
+ * @brief Start an asynchronous send of a large buffer as a sequence of datagrams.
+ * The data is split into the datagrams of segment_size bytes, the last datagram may be
+ * shorter. On linux the kernel splits it with the udp segmentation offload (UDP_SEGMENT),
+ * so up to asio::udp_max_offload_size bytes cost one syscall and one pass of the network
+ * stack. When the kernel or the route does not support it, the datagrams are split in
+ * software and sent by sendmmsg, or one by one on the other platforms.
+ * @param s - The udp socket.
+ * @param data - The data to be sent, the caller must keep it valid until the completion.
+ * @param segment_size - The payload bytes of each datagram, usually the path mtu minus the
+ *   ip and udp headers, e.g. 1472 for ipv4 on ethernet.
+ * @param destination - The remote endpoint to which the datagrams will be sent.
+ * @param token - The completion handler to invoke when the operation completes.
+ *	  The equivalent function signature of the handler must be:
+ *    @code
+ *    void handler(const asio::error_code& ec, std::size_t bytes_sent);
+ * @eg:
+ * auto [ec, n] = co_await asio::async_send_segments(sock, asio::buffer(data), 1472, dest);
+ */
+template <typename AsyncWriteStream,
+	ASIO_COMPLETION_TOKEN_FOR(void(asio::error_code, std::size_t)) WriteToken
+	ASIO_DEFAULT_COMPLETION_TOKEN_TYPE(typename AsyncWriteStream::executor_type)>
+ASIO_INITFN_AUTO_RESULT_TYPE_PREFIX(WriteToken, void(asio::error_code, std::size_t))
+async_send_segments(AsyncWriteStream& s, asio::const_buffer data, std::size_t segment_size,
+	const typename AsyncWriteStream::endpoint_type& destination,
+	WriteToken&& token
+	ASIO_DEFAULT_COMPLETION_TOKEN(typename AsyncWriteStream::executor_type))
+{
+	return asio::async_initiate<WriteToken, void(asio::error_code, std::size_t)>(
+		asio::detail::recycled_co_composed<void(asio::error_code, std::size_t)>(
+			detail::async_send_segments_op{}, s),
+		token, std::ref(s), data, segment_size, destination);
+}
 }